@@ -0,0 +1,264 @@
+#include "Benchmark.hpp"
+#include "ConnectCheck.hpp"
+
+#include "Utopia/Core/Log.hpp"
+#include "Utopia/Networking/NetworkConditions.hpp"
+#include "Utopia/Networking/NetworkingRuntime.hpp"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string_view>
+
+namespace {
+
+    void PrintUsage()
+    {
+        std::cerr <<
+            "Usage: Utopia-Networking-Bench [options]\n"
+            "  --scenarios <list>     echo,broadcast (default: both)\n"
+            "  --sizes <list>         Message sizes in bytes (default: 32,256,1024,4096)\n"
+            "  --clients <list>       Client counts (default: 1,8,32)\n"
+            "  --reliability <mode>   reliable, unreliable or both (default: both)\n"
+            "  --network <list>       Simulated profiles: none,lan,wifi,4g,transatlantic (default: none)\n"
+            "  --duration <ms>        Measured time per run (default: 3000)\n"
+            "  --warmup <ms>          Unmeasured time before each run (default: 500)\n"
+            "  --window <n>           Messages in flight per sender (default: 64)\n"
+            "  --workers <n>          Server network workers (default: 1)\n"
+            "  --wait-policy <name>   blocking, adaptive or busypoll (default: blocking)\n"
+            "  --port <n>             Loopback port (default: 27020)\n"
+            "  --output <path>        Write JSON here instead of stdout\n"
+            "  --check <name>         Run a regression check instead of benchmarking: connect\n";
+    }
+
+    bool ParseNumber(std::string_view text, uint32_t& outValue)
+    {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), outValue);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    bool ParseNumberList(std::string_view text, std::vector<uint32_t>& outValues)
+    {
+        outValues.clear();
+        while (!text.empty())
+        {
+            const size_t comma = text.find(',');
+            uint32_t value = 0;
+            if (!ParseNumber(text.substr(0, comma), value) || value == 0)
+                return false;
+
+            outValues.push_back(value);
+            text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+        }
+        return !outValues.empty();
+    }
+
+    bool ParseScenarios(std::string_view text, std::vector<Utopia::Bench::Scenario>& outScenarios)
+    {
+        outScenarios.clear();
+        while (!text.empty())
+        {
+            const size_t comma = text.find(',');
+            const std::string_view name = text.substr(0, comma);
+            if (name == "echo")
+                outScenarios.push_back(Utopia::Bench::Scenario::Echo);
+            else if (name == "broadcast")
+                outScenarios.push_back(Utopia::Bench::Scenario::Broadcast);
+            else
+                return false;
+
+            text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+        }
+        return !outScenarios.empty();
+    }
+
+    bool ParseNetworkProfiles(std::string_view text, std::vector<Utopia::NetworkConditionProfile>& outProfiles)
+    {
+        outProfiles.clear();
+        while (!text.empty())
+        {
+            const size_t comma = text.find(',');
+            const std::optional<Utopia::NetworkConditionProfile> profile = Utopia::NetworkConditionProfile::FromName(text.substr(0, comma));
+            if (!profile)
+                return false;
+
+            outProfiles.push_back(*profile);
+            text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+        }
+        return !outProfiles.empty();
+    }
+
+    bool ParseArguments(int argc, char** argv, Utopia::Bench::BenchConfig& config, std::string& outputPath, std::string& check)
+    {
+        using namespace Utopia;
+
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string_view option = argv[i];
+            if (option == "--help" || option == "-h" || i + 1 >= argc)
+                return false;
+
+            const std::string_view value = argv[++i];
+            uint32_t number = 0;
+
+            if (option == "--scenarios")
+            {
+                if (!ParseScenarios(value, config.Scenarios))
+                    return false;
+            }
+            else if (option == "--sizes")
+            {
+                if (!ParseNumberList(value, config.MessageSizes))
+                    return false;
+            }
+            else if (option == "--clients")
+            {
+                if (!ParseNumberList(value, config.ClientCounts))
+                    return false;
+            }
+            else if (option == "--reliability")
+            {
+                if (value == "reliable")
+                    config.Reliability = { true };
+                else if (value == "unreliable")
+                    config.Reliability = { false };
+                else if (value == "both")
+                    config.Reliability = { true, false };
+                else
+                    return false;
+            }
+            else if (option == "--network")
+            {
+                if (!ParseNetworkProfiles(value, config.NetworkProfiles))
+                    return false;
+            }
+            else if (option == "--wait-policy")
+            {
+                if (value == "blocking")
+                    config.ThreadConfig.Policy = WaitPolicy::Blocking;
+                else if (value == "adaptive")
+                    config.ThreadConfig.Policy = WaitPolicy::Adaptive;
+                else if (value == "busypoll")
+                    config.ThreadConfig.Policy = WaitPolicy::BusyPoll;
+                else
+                    return false;
+            }
+            else if (option == "--output")
+            {
+                outputPath = value;
+            }
+            else if (option == "--check")
+            {
+                if (value != "connect")
+                    return false;
+                check = value;
+            }
+            else if (!ParseNumber(value, number))
+            {
+                return false;
+            }
+            else if (option == "--duration" && number > 0)
+                config.Duration = std::chrono::milliseconds(number);
+            else if (option == "--warmup")
+                config.Warmup = std::chrono::milliseconds(number);
+            else if (option == "--window" && number > 0)
+                config.Window = number;
+            else if (option == "--workers" && number > 0)
+                config.ServerWorkers = number;
+            else if (option == "--port" && number > 0 && number <= 65535)
+                config.Port = static_cast<uint16_t>(number);
+            else
+                return false;
+        }
+
+        return true;
+    }
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    using namespace Utopia;
+
+    Bench::BenchConfig config;
+    std::string outputPath;
+    std::string check;
+    if (!ParseArguments(argc, argv, config, outputPath, check))
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    Log::Init();
+
+    // Keep the library initialized across runs instead of paying for it per server
+    std::string errorMessage;
+    if (!NetworkingRuntime::Acquire(errorMessage))
+    {
+        std::cerr << errorMessage << std::endl;
+        Log::Shutdown();
+        return 1;
+    }
+
+    if (!check.empty())
+    {
+        const std::string error = Bench::RunConnectChecks(config.Port);
+        std::cerr << "[check] " << check << ": " << (error.empty() ? "passed" : "failed: " + error) << "\n";
+
+        NetworkingRuntime::Release();
+        Log::Shutdown();
+        return error.empty() ? 0 : 1;
+    }
+
+    std::vector<Bench::BenchResult> results;
+    for (const NetworkConditionProfile& network : config.NetworkProfiles)
+    {
+        for (Bench::Scenario scenario : config.Scenarios)
+        {
+            for (uint32_t clientCount : config.ClientCounts)
+            {
+                for (uint32_t messageSize : config.MessageSizes)
+                {
+                    for (bool reliable : config.Reliability)
+                    {
+                        std::cerr << "[" << network.Name << "] " << Bench::ScenarioToString(scenario) << ": " << clientCount << " client(s), "
+                            << messageSize << " bytes, " << (reliable ? "reliable" : "unreliable") << "... " << std::flush;
+
+                        const Bench::BenchResult& result = results.emplace_back(
+                            Bench::RunBenchmark(config, scenario, messageSize, clientCount, reliable, network)
+                        );
+
+                        if (result.Error.empty())
+                            std::cerr << static_cast<uint64_t>(result.MessagesPerSecond) << " msg/s, p99 " << result.Latency.P99 << " us\n";
+                        else
+                            std::cerr << "failed: " << result.Error << "\n";
+                    }
+                }
+            }
+        }
+    }
+
+    NetworkConditions::Clear();
+    NetworkingRuntime::Release();
+
+    const std::string json = Bench::ResultsToJson(config, results);
+    if (outputPath.empty())
+    {
+        std::cout << json;
+    }
+    else
+    {
+        std::ofstream file(outputPath);
+        if (!file)
+        {
+            std::cerr << "Could not open " << outputPath << " for writing\n";
+            Log::Shutdown();
+            return 1;
+        }
+        file << json;
+    }
+
+    Log::Shutdown();
+    return 0;
+}
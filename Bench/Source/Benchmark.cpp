@@ -0,0 +1,390 @@
+#include "Benchmark.hpp"
+
+#include "Utopia/Networking/Client.hpp"
+#include "Utopia/Networking/Server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace Utopia::Bench {
+
+    namespace {
+
+        // Stamped at the front of every payload; messages smaller than this are padded up to it
+        struct MessageHeader
+        {
+            int64_t SendTimeNs;
+            uint32_t Sequence;
+            uint32_t Padding;
+        };
+
+        int64_t NowNs()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()
+            ).count();
+        }
+
+        // Written by the client's network thread; Sent and WrittenOff by the bench thread only
+        struct ClientState
+        {
+            std::atomic<uint64_t> Received{ 0 };
+            std::atomic<int64_t> LastReceiveNs{ 0 };
+            uint64_t Sent = 0;
+            uint64_t WrittenOff = 0;
+
+            uint64_t MeasuredMessages = 0;
+            std::vector<double> LatencySamples;
+        };
+
+        struct MeasureWindow
+        {
+            std::atomic<int64_t> StartNs{ INT64_MAX };
+            std::atomic<int64_t> EndNs{ INT64_MAX };
+        };
+
+        void OnBenchMessage(ClientState& state, const MeasureWindow& window, const Buffer& payload)
+        {
+            const int64_t nowNs = NowNs();
+            state.LastReceiveNs.store(nowNs, std::memory_order_relaxed);
+
+            if (payload.Size >= sizeof(MessageHeader))
+            {
+                MessageHeader header;
+                std::memcpy(&header, payload.Data, sizeof(header));
+
+                // Only messages sent inside the window count, so warmup and drain do not skew the numbers
+                if (header.SendTimeNs >= window.StartNs.load(std::memory_order_relaxed) &&
+                    header.SendTimeNs < window.EndNs.load(std::memory_order_relaxed))
+                {
+                    state.MeasuredMessages++;
+                    state.LatencySamples.push_back(static_cast<double>(nowNs - header.SendTimeNs) / 1000.0);
+                }
+            }
+
+            state.Received.fetch_add(1, std::memory_order_release);
+        }
+
+        // Messages the sender may still put on the wire before its window is full
+        uint64_t GetWindowCredit(ClientState& state, uint64_t sent, const BenchConfig& config, int64_t lossTimeoutNs, int64_t nowNs)
+        {
+            const uint64_t completed = state.Received.load(std::memory_order_acquire) + state.WrittenOff;
+            const uint64_t inFlight = sent > completed ? sent - completed : 0;
+            if (inFlight < config.Window)
+                return config.Window - inFlight;
+
+            // Unreliable sends can be dropped even on loopback; give up on them rather than stalling
+            if (nowNs - state.LastReceiveNs.load(std::memory_order_relaxed) > lossTimeoutNs)
+            {
+                state.WrittenOff += inFlight;
+                state.LastReceiveNs.store(nowNs, std::memory_order_relaxed);
+                return config.Window;
+            }
+
+            return 0;
+        }
+
+        std::string WaitForConnections(Server& server, std::vector<std::unique_ptr<Client>>& clients)
+        {
+            using namespace std::chrono_literals;
+
+            const auto deadline = std::chrono::steady_clock::now() + 5s;
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                bool allConnected = true;
+                for (const auto& client : clients)
+                {
+                    const Client::ConnectionStatus status = client->GetConnectionStatus();
+                    if (status == Client::ConnectionStatus::FailedToConnect)
+                        return "Client failed to connect: " + client->GetConnectionDebugMessage();
+                    allConnected &= status == Client::ConnectionStatus::Connected;
+                }
+
+                if (allConnected && server.GetConnectedClients()->size() == clients.size())
+                    return {};
+
+                std::this_thread::sleep_for(1ms);
+            }
+
+            return "Timed out waiting for clients to connect";
+        }
+
+    } // anonymous namespace
+
+    const char* ScenarioToString(Scenario scenario)
+    {
+        switch (scenario)
+        {
+        case Scenario::Echo:      return "echo";
+        case Scenario::Broadcast: return "broadcast";
+        }
+        return "unknown";
+    }
+
+    BenchResult RunBenchmark(const BenchConfig& config, Scenario scenario, uint32_t messageSize, uint32_t clientCount, bool reliable,
+        const NetworkConditionProfile& network)
+    {
+        using namespace std::chrono_literals;
+
+        BenchResult result;
+        result.Kind = scenario;
+        result.MessageSize = std::max<uint32_t>(messageSize, sizeof(MessageHeader));
+        result.ClientCount = clientCount;
+        result.Reliable = reliable;
+        result.Network = network.Name;
+
+        // Both legs of a round trip pass through the simulation
+        const std::chrono::milliseconds lossTimeout = config.LossTimeout + 2 * network.GetMaxDelay();
+        const int64_t lossTimeoutNs = std::chrono::duration_cast<std::chrono::nanoseconds>(lossTimeout).count();
+
+        MeasureWindow window;
+        std::vector<std::unique_ptr<ClientState>> states;
+        for (uint32_t i = 0; i < clientCount; i++)
+        {
+            states.push_back(std::make_unique<ClientState>());
+            states.back()->LatencySamples.reserve(1 << 16);
+        }
+
+        Server server(config.Port);
+        server.SetNetworkThreadConfig(config.ThreadConfig);
+
+        ServerWorkerConfig workerConfig;
+        workerConfig.WorkerCount = config.ServerWorkers;
+        server.SetWorkerConfig(workerConfig);
+
+        // Server and clients share the process, so shaping sends alone covers every direction once
+        server.SetNetworkConditions(network);
+
+        if (scenario == Scenario::Echo)
+        {
+            server.SetDataReceivedCallback([&server, reliable](const ClientInfo& client, const Buffer payload)
+                {
+                    server.SendBufferToClient(client.ID, payload, reliable);
+                });
+        }
+
+        server.Start();
+        if (!server.IsRunning())
+        {
+            result.Error = "Server failed to listen on port " + std::to_string(config.Port);
+            return result;
+        }
+
+        std::vector<std::unique_ptr<Client>> clients;
+        const std::string serverAddress = "127.0.0.1:" + std::to_string(config.Port);
+        for (uint32_t i = 0; i < clientCount; i++)
+        {
+            auto client = std::make_unique<Client>();
+            client->SetNetworkThreadConfig(config.ThreadConfig);
+
+            ClientState& state = *states[i];
+            client->SetDataReceivedCallback([&state, &window](const Buffer payload)
+                {
+                    OnBenchMessage(state, window, payload);
+                });
+
+            client->ConnectToServer(serverAddress);
+            clients.push_back(std::move(client));
+        }
+
+        result.Error = WaitForConnections(server, clients);
+        if (result.Error.empty())
+        {
+            std::vector<uint8_t> payload(result.MessageSize, 0);
+            MessageHeader header{};
+
+            const int64_t startNs = NowNs();
+            const int64_t warmupEndNs = startNs + std::chrono::duration_cast<std::chrono::nanoseconds>(config.Warmup).count();
+            const int64_t endNs = warmupEndNs + std::chrono::duration_cast<std::chrono::nanoseconds>(config.Duration).count();
+            window.StartNs.store(warmupEndNs);
+            window.EndNs.store(endNs);
+
+            for (const auto& state : states)
+                state->LastReceiveNs.store(startNs);
+
+            uint64_t broadcastsSent = 0;
+            int64_t nowNs = startNs;
+            while (nowNs < endNs)
+            {
+                bool sentAny = false;
+
+                if (scenario == Scenario::Echo)
+                {
+                    for (uint32_t i = 0; i < clientCount; i++)
+                    {
+                        ClientState& state = *states[i];
+                        for (uint64_t credit = GetWindowCredit(state, state.Sent, config, lossTimeoutNs, nowNs); credit > 0; credit--)
+                        {
+                            header.SendTimeNs = NowNs();
+                            header.Sequence = static_cast<uint32_t>(state.Sent++);
+                            std::memcpy(payload.data(), &header, sizeof(header));
+                            clients[i]->SendBuffer(Buffer(payload.data(), payload.size()), reliable);
+                            sentAny = true;
+                        }
+                    }
+                }
+                else
+                {
+                    // The slowest client paces the broadcast
+                    uint64_t credit = config.Window;
+                    for (const auto& state : states)
+                        credit = std::min(credit, GetWindowCredit(*state, broadcastsSent, config, lossTimeoutNs, nowNs));
+
+                    for (; credit > 0; credit--)
+                    {
+                        header.SendTimeNs = NowNs();
+                        header.Sequence = static_cast<uint32_t>(broadcastsSent++);
+                        std::memcpy(payload.data(), &header, sizeof(header));
+                        server.SendBufferToAllClients(Buffer(payload.data(), payload.size()), 0, reliable);
+                        sentAny = true;
+                    }
+                }
+
+                if (!sentAny)
+                    std::this_thread::yield();
+
+                nowNs = NowNs();
+            }
+
+            // Give the last measured messages a moment to land
+            std::this_thread::sleep_for(lossTimeout);
+            result.Seconds = static_cast<double>(endNs - warmupEndNs) / 1e9;
+        }
+
+        // Joining the client threads makes their states safe to read
+        for (const auto& client : clients)
+            client->Disconnect();
+        server.Stop();
+
+        if (!result.Error.empty())
+            return result;
+
+        std::vector<double> samples;
+        for (const auto& state : states)
+        {
+            result.Messages += state->MeasuredMessages;
+            samples.insert(samples.end(), state->LatencySamples.begin(), state->LatencySamples.end());
+        }
+
+        result.Bytes = result.Messages * result.MessageSize;
+        result.MessagesPerSecond = static_cast<double>(result.Messages) / result.Seconds;
+        result.BytesPerSecond = static_cast<double>(result.Bytes) / result.Seconds;
+        result.Latency = SummarizeLatency(samples);
+        return result;
+    }
+
+    LatencySummary SummarizeLatency(std::vector<double>& samples)
+    {
+        LatencySummary summary;
+        summary.Samples = samples.size();
+        if (samples.empty())
+            return summary;
+
+        std::sort(samples.begin(), samples.end());
+
+        // Nearest-rank percentile
+        auto percentile = [&samples](double p)
+            {
+                const size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())));
+                return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+            };
+
+        summary.P50 = percentile(0.50);
+        summary.P90 = percentile(0.90);
+        summary.P99 = percentile(0.99);
+        summary.P999 = percentile(0.999);
+        summary.Max = samples.back();
+        return summary;
+    }
+
+    std::string ResultsToJson(const BenchConfig& config, const std::vector<BenchResult>& results)
+    {
+        auto waitPolicyToString = [](WaitPolicy policy)
+            {
+                switch (policy)
+                {
+                case WaitPolicy::Blocking: return "blocking";
+                case WaitPolicy::Adaptive: return "adaptive";
+                case WaitPolicy::BusyPoll: return "busypoll";
+                }
+                return "unknown";
+            };
+
+        // Error strings come from the library's debug messages, which may contain quotes
+        auto escape = [](const std::string& string)
+            {
+                std::string escaped;
+                for (char c : string)
+                {
+                    if (c == '"' || c == '\\')
+                        escaped.push_back('\\');
+                    if (static_cast<unsigned char>(c) >= 0x20)
+                        escaped.push_back(c);
+                }
+                return escaped;
+            };
+
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(3);
+
+        json << "{\n";
+        json << "  \"benchmark\": \"Utopia-Networking\",\n";
+        json << "  \"config\": {\n";
+        json << "    \"duration_ms\": " << config.Duration.count() << ",\n";
+        json << "    \"warmup_ms\": " << config.Warmup.count() << ",\n";
+        json << "    \"window\": " << config.Window << ",\n";
+        json << "    \"loss_timeout_ms\": " << config.LossTimeout.count() << ",\n";
+        json << "    \"server_workers\": " << config.ServerWorkers << ",\n";
+        json << "    \"wait_policy\": \"" << waitPolicyToString(config.ThreadConfig.Policy) << "\",\n";
+        json << "    \"max_wait_us\": " << config.ThreadConfig.MaxWait.count() << "\n";
+        json << "  },\n";
+        json << "  \"results\": [";
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult& result = results[i];
+
+            json << (i == 0 ? "\n" : ",\n");
+            json << "    {\n";
+            json << "      \"scenario\": \"" << ScenarioToString(result.Kind) << "\",\n";
+            json << "      \"message_size\": " << result.MessageSize << ",\n";
+            json << "      \"clients\": " << result.ClientCount << ",\n";
+            json << "      \"reliable\": " << (result.Reliable ? "true" : "false") << ",\n";
+            json << "      \"network\": \"" << escape(result.Network) << "\",\n";
+            if (!result.Error.empty())
+            {
+                json << "      \"error\": \"" << escape(result.Error) << "\"\n";
+                json << "    }";
+                continue;
+            }
+
+            json << "      \"seconds\": " << result.Seconds << ",\n";
+            json << "      \"messages\": " << result.Messages << ",\n";
+            json << "      \"bytes\": " << result.Bytes << ",\n";
+            json << "      \"messages_per_sec\": " << result.MessagesPerSecond << ",\n";
+            json << "      \"bytes_per_sec\": " << result.BytesPerSecond << ",\n";
+            json << "      \"latency_kind\": \"" << (result.Kind == Scenario::Echo ? "rtt" : "one_way") << "\",\n";
+            json << "      \"latency_us\": {\n";
+            json << "        \"samples\": " << result.Latency.Samples << ",\n";
+            json << "        \"p50\": " << result.Latency.P50 << ",\n";
+            json << "        \"p90\": " << result.Latency.P90 << ",\n";
+            json << "        \"p99\": " << result.Latency.P99 << ",\n";
+            json << "        \"p999\": " << result.Latency.P999 << ",\n";
+            json << "        \"max\": " << result.Latency.Max << "\n";
+            json << "      }\n";
+            json << "    }";
+        }
+
+        json << "\n  ]\n";
+        json << "}\n";
+        return json.str();
+    }
+
+} // namespace Utopia::Bench
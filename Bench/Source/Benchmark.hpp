@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Utopia/Networking/NetworkConditions.hpp"
+#include "Utopia/Networking/NetworkWaiter.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Utopia::Bench {
+
+    enum class Scenario
+    {
+        // Every client sends to the server, which echoes back to the sender
+        Echo = 0,
+        // The server broadcasts to every client; latency is one-way, since both ends share a clock
+        Broadcast
+    };
+
+    struct BenchConfig
+    {
+        std::vector<Scenario> Scenarios = { Scenario::Echo, Scenario::Broadcast };
+        std::vector<uint32_t> MessageSizes = { 32, 256, 1024, 4096 };
+        std::vector<uint32_t> ClientCounts = { 1, 8, 32 };
+        std::vector<bool> Reliability = { true, false };
+        // Every run is repeated under each simulated profile
+        std::vector<NetworkConditionProfile> NetworkProfiles = { NetworkConditionProfile::None() };
+
+        std::chrono::milliseconds Duration{ 3000 };
+        std::chrono::milliseconds Warmup{ 500 };
+
+        // Messages each sender keeps in flight. Unreliable losses are written off after LossTimeout, plus the
+        // simulated profile's worst-case round trip.
+        uint32_t Window = 64;
+        std::chrono::milliseconds LossTimeout{ 100 };
+
+        uint16_t Port = 27020;
+        uint32_t ServerWorkers = 1;
+        NetworkThreadConfig ThreadConfig;
+    };
+
+    struct LatencySummary
+    {
+        uint64_t Samples = 0;
+        double P50 = 0.0;
+        double P90 = 0.0;
+        double P99 = 0.0;
+        double P999 = 0.0;
+        double Max = 0.0;
+    };
+
+    struct BenchResult
+    {
+        Scenario Kind = Scenario::Echo;
+        uint32_t MessageSize = 0;
+        uint32_t ClientCount = 0;
+        bool Reliable = true;
+        std::string Network = "none";
+
+        double Seconds = 0.0;
+        uint64_t Messages = 0;
+        uint64_t Bytes = 0;
+        double MessagesPerSecond = 0.0;
+        double BytesPerSecond = 0.0;
+
+        // Microseconds. Round trip for Echo, one way for Broadcast.
+        LatencySummary Latency;
+
+        // Set when the run could not start, e.g. clients failed to connect
+        std::string Error;
+    };
+
+    const char* ScenarioToString(Scenario scenario);
+
+    // Runs one configuration against a fresh server and clients on 127.0.0.1, with network simulated for the
+    // whole process
+    BenchResult RunBenchmark(const BenchConfig& config, Scenario scenario, uint32_t messageSize, uint32_t clientCount, bool reliable,
+        const NetworkConditionProfile& network = NetworkConditionProfile::None());
+
+    // Microsecond samples are sorted in place
+    LatencySummary SummarizeLatency(std::vector<double>& samples);
+
+    std::string ResultsToJson(const BenchConfig& config, const std::vector<BenchResult>& results);
+
+} // namespace Utopia::Bench
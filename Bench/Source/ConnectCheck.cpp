@@ -0,0 +1,131 @@
+#include "ConnectCheck.hpp"
+
+#include "Utopia/Networking/AsyncClient.hpp"
+#include "Utopia/Networking/Client.hpp"
+#include "Utopia/Networking/Server.hpp"
+#include "Utopia/Networking/Task.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace Utopia::Bench {
+
+    namespace {
+
+        enum class Outcome
+        {
+            Pending = 0,
+            Connected,
+            Failed
+        };
+
+        // The inline executor resumes coroutines on the client's network thread
+        Task<> ConnectOnce(AsyncClient& client, std::string address, std::atomic<Outcome>& outOutcome)
+        {
+            const bool connected = co_await client.ConnectAsync(std::move(address));
+            outOutcome.store(connected ? Outcome::Connected : Outcome::Failed);
+        }
+
+        Task<> ConnectAgainAfterDisconnect(AsyncClient& client, std::string address, std::atomic<Outcome>& outFirst,
+            std::atomic<Outcome>& outSecond, std::atomic<bool>& outResumedOnCaller)
+        {
+            const std::thread::id caller = std::this_thread::get_id();
+            const bool connected = co_await client.ConnectAsync(address);
+            outFirst.store(connected ? Outcome::Connected : Outcome::Failed);
+            if (!connected)
+                co_return;
+
+            // Empty once the server kicks us, resumed from the network thread's disconnect
+            co_await client.Receive();
+            outResumedOnCaller.store(std::this_thread::get_id() == caller);
+
+            const bool reconnected = co_await client.ConnectAsync(std::move(address));
+            outSecond.store(reconnected ? Outcome::Connected : Outcome::Failed);
+        }
+
+        bool WaitFor(const std::atomic<Outcome>& outcome)
+        {
+            using namespace std::chrono_literals;
+
+            const auto deadline = std::chrono::steady_clock::now() + 5s;
+            while (outcome.load() == Outcome::Pending && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(1ms);
+            return outcome.load() == Outcome::Connected;
+        }
+
+        std::string CheckBackToBack(const std::string& address)
+        {
+            Client client;
+            AsyncClient asyncClient(client, InlineExecutor::Get());
+
+            std::atomic<Outcome> first{ Outcome::Pending };
+            std::atomic<Outcome> second{ Outcome::Pending };
+            Spawn(InlineExecutor::Get(), ConnectOnce(asyncClient, address, first));
+            Spawn(InlineExecutor::Get(), ConnectOnce(asyncClient, address, second));
+
+            const bool connected = WaitFor(first) && WaitFor(second);
+            client.Disconnect();
+            if (!connected)
+                return "Back-to-back ConnectAsync() calls did not both connect";
+
+            // Stopping while the network thread is still setting up must neither hang nor leave it running
+            client.ConnectToServer(address);
+            client.Disconnect();
+            if (client.IsRunning())
+                return "Disconnect() during setup left the client running";
+            return {};
+        }
+
+        std::string CheckReconnectFromDisconnect(Server& server, const std::string& address)
+        {
+            using namespace std::chrono_literals;
+
+            Client client;
+            AsyncClient asyncClient(client, InlineExecutor::Get());
+
+            std::atomic<Outcome> first{ Outcome::Pending };
+            std::atomic<Outcome> second{ Outcome::Pending };
+            std::atomic<bool> resumedOnCaller{ true };
+            Spawn(InlineExecutor::Get(), ConnectAgainAfterDisconnect(asyncClient, address, first, second, resumedOnCaller));
+
+            if (!WaitFor(first))
+            {
+                client.Disconnect();
+                return "ConnectAsync() before the kick did not connect";
+            }
+
+            const auto deadline = std::chrono::steady_clock::now() + 5s;
+            while (server.GetConnectedClients()->empty() && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(1ms);
+            for (const ClientInfo& info : *server.GetConnectedClients())
+                server.KickClient(info.ID);
+
+            const bool reconnected = WaitFor(second);
+            client.Disconnect();
+            if (resumedOnCaller.load())
+                return "The disconnect did not resume the coroutine on the network thread";
+            if (!reconnected)
+                return "ConnectAsync() from the network thread did not reconnect";
+            return {};
+        }
+
+    } // anonymous namespace
+
+    std::string RunConnectChecks(uint16_t port)
+    {
+        Server server(port);
+        server.Start();
+        if (!server.IsRunning())
+            return "Server failed to listen on port " + std::to_string(port);
+
+        const std::string address = "127.0.0.1:" + std::to_string(port);
+        std::string error = CheckBackToBack(address);
+        if (error.empty())
+            error = CheckReconnectFromDisconnect(server, address);
+
+        server.Stop();
+        return error;
+    }
+
+} // namespace Utopia::Bench
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace Utopia::Bench {
+
+    // Regression checks for starting connections through AsyncClient against a server on 127.0.0.1:
+    // two ConnectAsync() calls back to back, a Disconnect() while the network thread is still setting up,
+    // and a ConnectAsync() from a coroutine resumed inline on the network thread by the disconnect.
+    // Returns an empty string on success, otherwise what failed.
+    std::string RunConnectChecks(uint16_t port);
+
+} // namespace Utopia::Bench
@@ -71,3 +71,88 @@ project "Utopia-Networking"
       runtime "Release"
       optimize "On"
       symbols "Off"
+
+project "Utopia-Networking-Bench"
+   kind "ConsoleApp"
+   language "C++"
+   cppdialect "C++20"
+   staticruntime "off"
+
+   files { "Bench/Source/**.h", "Bench/Source/**.hpp", "Bench/Source/**.cpp" }
+
+   includedirs
+   {
+      "Bench/Source",
+      "Source",
+
+      "vendor/GameNetworkingSockets/include",
+
+      --------------------------------------------------------
+      -- Utopia includes
+      -- Assumes we are in Utopia-Modules/Utopia-Networking
+      "../../Utopia/Source",
+
+      "../../vendor/imgui",
+      "../../vendor/glfw/include",
+      "../../vendor/glm",
+      "../../vendor/spdlog/include",
+      --------------------------------------------------------
+   }
+
+   links
+   {
+      "Utopia-Networking",
+      "Utopia",
+   }
+
+   targetdir ("../../bin/" .. outputdir .. "/%{prj.name}")
+   objdir ("../../bin-int/" .. outputdir .. "/%{prj.name}")
+
+   filter "system:windows"
+      systemversion "latest"
+      defines { "UT_PLATFORM_WINDOWS" }
+      links { "Ws2_32.lib" }
+      buildoptions { "/utf-8" }
+
+   filter "system:linux"
+      defines { "UT_PLATFORM_LINUX" }
+      libdirs { "vendor/GameNetworkingSockets/bin/Linux" }
+      links { "GameNetworkingSockets", "pthread" }
+      runpathdirs { "vendor/GameNetworkingSockets/bin/Linux" }
+
+   filter { "system:windows", "configurations:Debug" }
+      links
+      {
+          "vendor/GameNetworkingSockets/bin/Windows/Debug/GameNetworkingSockets.lib"
+      }
+      postbuildcommands
+      {
+          '{COPYFILE} "%{prj.location}/vendor/GameNetworkingSockets/bin/Windows/Debug/*.dll" "%{cfg.targetdir}"'
+      }
+
+   filter { "system:windows", "configurations:Release or configurations:Dist" }
+      links
+      {
+          "vendor/GameNetworkingSockets/bin/Windows/Release/GameNetworkingSockets.lib"
+      }
+      postbuildcommands
+      {
+          '{COPYFILE} "%{prj.location}/vendor/GameNetworkingSockets/bin/Windows/Release/*.dll" "%{cfg.targetdir}"'
+      }
+
+   filter "configurations:Debug"
+      defines { "UT_DEBUG" }
+      runtime "Debug"
+      symbols "On"
+
+   filter "configurations:Release"
+      defines { "UT_RELEASE" }
+      runtime "Release"
+      optimize "On"
+      symbols "On"
+
+   filter "configurations:Dist"
+      defines { "UT_DIST" }
+      runtime "Release"
+      optimize "On"
+      symbols "Off"
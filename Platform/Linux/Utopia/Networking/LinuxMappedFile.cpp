@@ -0,0 +1,134 @@
+#include "Utopia/Networking/MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace Utopia {
+
+	namespace {
+
+		std::string DescribeError(const char* operation, const std::string& path)
+		{
+			return std::string(operation) + " " + path + ": " + std::strerror(errno);
+		}
+
+	} // anonymous namespace
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool MappedFile::Create(const std::string& path, size_t size, std::string& outError)
+	{
+		Close();
+
+		const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (fd < 0)
+		{
+			outError = DescribeError("Could not create", path);
+			return false;
+		}
+
+		m_File = fd;
+		m_Writable = true;
+		if (!Resize(size, outError))
+		{
+			Close(0);
+			return false;
+		}
+		return true;
+	}
+
+	bool MappedFile::OpenRead(const std::string& path, std::string& outError)
+	{
+		Close();
+
+		const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			outError = DescribeError("Could not open", path);
+			return false;
+		}
+
+		struct stat status{};
+		if (::fstat(fd, &status) != 0)
+		{
+			outError = DescribeError("Could not stat", path);
+			::close(fd);
+			return false;
+		}
+
+		m_File = fd;
+		m_Writable = false;
+		m_Size = static_cast<size_t>(status.st_size);
+		if (m_Size == 0)
+			return true;
+
+		void* data = ::mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			outError = DescribeError("Could not map", path);
+			Close();
+			return false;
+		}
+
+		// Replay reads front to back
+		::madvise(data, m_Size, MADV_SEQUENTIAL);
+		m_Data = static_cast<std::byte*>(data);
+		return true;
+	}
+
+	bool MappedFile::Resize(size_t size, std::string& outError)
+	{
+		if (!m_Writable || size == 0)
+		{
+			outError = "Only open writable files can be resized, and not to zero";
+			return false;
+		}
+
+		const int fd = static_cast<int>(m_File);
+		if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+		{
+			outError = std::string("Could not resize mapped file: ") + std::strerror(errno);
+			return false;
+		}
+
+		void* data = m_Data
+			? ::mremap(m_Data, m_Size, size, MREMAP_MAYMOVE)
+			: ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			outError = std::string("Could not map file: ") + std::strerror(errno);
+			return false;
+		}
+
+		m_Data = static_cast<std::byte*>(data);
+		m_Size = size;
+		return true;
+	}
+
+	void MappedFile::Close(size_t finalSize)
+	{
+		if (m_Data)
+			::munmap(m_Data, m_Size);
+
+		if (m_File != k_InvalidHandle)
+		{
+			if (m_Writable)
+				(void)::ftruncate(static_cast<int>(m_File), static_cast<off_t>(finalSize < m_Size ? finalSize : m_Size));
+			::close(static_cast<int>(m_File));
+		}
+
+		m_Data = nullptr;
+		m_Size = 0;
+		m_Writable = false;
+		m_File = k_InvalidHandle;
+	}
+
+}
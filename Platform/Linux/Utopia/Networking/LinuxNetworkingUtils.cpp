@@ -1,11 +1,92 @@
 #include "Utopia/Networking/NetworkingUtils.hpp"
 
+#include <steam/isteamnetworkingutils.h>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+
 namespace Utopia::Utils {
 
-	std::string ResolveDomainName(std::string_view name)
+	[[nodiscard]] bool ResolveHostAddresses(std::string_view name, std::vector<SteamNetworkingIPAddr>& outAddresses, std::string& outError) noexcept
+	{
+		outAddresses.clear();
+
+		// getaddrinfo needs a terminated string
+		const std::string host(name);
+
+		addrinfo hints{};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+		// Skip families this machine has no address for
+		hints.ai_flags = AI_ADDRCONFIG;
+
+		addrinfo* addressResult = nullptr;
+		const int retval = ::getaddrinfo(host.c_str(), nullptr, &hints, &addressResult);
+		if (retval != 0)
+		{
+			outError = ::gai_strerror(retval);
+			return false;
+		}
+
+		for (const addrinfo* ptr = addressResult; ptr != nullptr; ptr = ptr->ai_next)
+		{
+			SteamNetworkingIPAddr address;
+			if (ptr->ai_family == AF_INET)
+			{
+				const auto* sockaddrIPv4 = reinterpret_cast<const sockaddr_in*>(ptr->ai_addr);
+				address.SetIPv4(ntohl(sockaddrIPv4->sin_addr.s_addr), 0);
+			}
+			else if (ptr->ai_family == AF_INET6)
+			{
+				const auto* sockaddrIPv6 = reinterpret_cast<const sockaddr_in6*>(ptr->ai_addr);
+				address.SetIPv6(sockaddrIPv6->sin6_addr.s6_addr, 0);
+			}
+			else
+			{
+				continue;
+			}
+
+			if (std::find(outAddresses.begin(), outAddresses.end(), address) == outAddresses.end())
+				outAddresses.push_back(address);
+		}
+
+		::freeaddrinfo(addressResult);
+
+		if (outAddresses.empty())
+		{
+			outError = "No IPv4 or IPv6 addresses";
+			return false;
+		}
+		return true;
+	}
+
+	[[nodiscard]] std::optional<std::string> ResolveDomainName(std::string_view name) noexcept
 	{
-        // TODO: implement this
-        return {};
+		std::vector<SteamNetworkingIPAddr> addresses;
+		std::string error;
+		if (!ResolveHostAddresses(name, addresses, error))
+			return std::nullopt;
+
+		char ipAddress[SteamNetworkingIPAddr::k_cchMaxString];
+		addresses.front().ToString(ipAddress, sizeof(ipAddress), false);
+		return std::string(ipAddress);
+	}
+
+	bool SetCurrentThreadAffinity(int core) noexcept
+	{
+		if (core < 0 || core >= CPU_SETSIZE)
+			return false;
+
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(core, &cpuSet);
+		return ::pthread_setaffinity_np(::pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
 	}
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,179 @@
+#include "Utopia/Networking/MappedFile.hpp"
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+
+#include <format>
+
+namespace Utopia {
+
+    namespace {
+
+        std::string DescribeError(const char* operation, const std::string& path)
+        {
+            return std::format("{} {}: error {}", operation, path, ::GetLastError());
+        }
+
+        HANDLE ToHandle(intptr_t handle)
+        {
+            return reinterpret_cast<HANDLE>(handle);
+        }
+
+        bool SetFileSize(HANDLE file, size_t size)
+        {
+            LARGE_INTEGER position{};
+            position.QuadPart = static_cast<LONGLONG>(size);
+            return ::SetFilePointerEx(file, position, nullptr, FILE_BEGIN) && ::SetEndOfFile(file);
+        }
+
+        // Maps the first size bytes of file read-write
+        bool MapReadWrite(HANDLE file, size_t size, intptr_t& outMapping, std::byte*& outData)
+        {
+            const DWORD sizeHigh = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+            const DWORD sizeLow = static_cast<DWORD>(static_cast<uint64_t>(size) & 0xFFFFFFFF);
+            const HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READWRITE, sizeHigh, sizeLow, nullptr);
+            void* data = mapping ? ::MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : nullptr;
+            if (!data)
+            {
+                if (mapping)
+                    ::CloseHandle(mapping);
+                return false;
+            }
+
+            outMapping = reinterpret_cast<intptr_t>(mapping);
+            outData = static_cast<std::byte*>(data);
+            return true;
+        }
+
+    } // anonymous namespace
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    bool MappedFile::Create(const std::string& path, size_t size, std::string& outError)
+    {
+        Close();
+
+        const HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            outError = DescribeError("Could not create", path);
+            return false;
+        }
+
+        m_File = reinterpret_cast<intptr_t>(file);
+        m_Writable = true;
+        if (!Resize(size, outError))
+        {
+            Close(0);
+            return false;
+        }
+        return true;
+    }
+
+    bool MappedFile::OpenRead(const std::string& path, std::string& outError)
+    {
+        Close();
+
+        const HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            outError = DescribeError("Could not open", path);
+            return false;
+        }
+
+        LARGE_INTEGER fileSize{};
+        if (!::GetFileSizeEx(file, &fileSize))
+        {
+            outError = DescribeError("Could not get the size of", path);
+            ::CloseHandle(file);
+            return false;
+        }
+
+        m_File = reinterpret_cast<intptr_t>(file);
+        m_Writable = false;
+        m_Size = static_cast<size_t>(fileSize.QuadPart);
+        if (m_Size == 0)
+            return true;
+
+        const HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* data = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!data)
+        {
+            outError = DescribeError("Could not map", path);
+            if (mapping)
+                ::CloseHandle(mapping);
+            Close();
+            return false;
+        }
+
+        m_Mapping = reinterpret_cast<intptr_t>(mapping);
+        m_Data = static_cast<std::byte*>(data);
+        return true;
+    }
+
+    bool MappedFile::Resize(size_t size, std::string& outError)
+    {
+        if (!m_Writable || size == 0)
+        {
+            outError = "Only open writable files can be resized, and not to zero";
+            return false;
+        }
+
+        // A view pins the file's size, so it has to go before the file can change
+        const size_t previousSize = m_Size;
+        if (m_Data)
+            ::UnmapViewOfFile(m_Data);
+        if (m_Mapping)
+            ::CloseHandle(ToHandle(m_Mapping));
+        m_Data = nullptr;
+        m_Mapping = 0;
+
+        const HANDLE file = ToHandle(m_File);
+        if (!SetFileSize(file, size))
+            outError = std::format("Could not resize mapped file: error {}", ::GetLastError());
+        else if (!MapReadWrite(file, size, m_Mapping, m_Data))
+            outError = std::format("Could not map file: error {}", ::GetLastError());
+        else
+        {
+            m_Size = size;
+            return true;
+        }
+
+        // Leave the file as it was, like a failed mremap does. Even if the old view cannot be restored,
+        // m_Size keeps Close() from cutting the file below what was written to it.
+        if (previousSize > 0)
+            MapReadWrite(file, previousSize, m_Mapping, m_Data);
+        return false;
+    }
+
+    void MappedFile::Close(size_t finalSize)
+    {
+        const size_t mappedSize = m_Size;
+
+        if (m_Data)
+            ::UnmapViewOfFile(m_Data);
+        if (m_Mapping)
+            ::CloseHandle(ToHandle(m_Mapping));
+
+        if (m_File != k_InvalidHandle)
+        {
+            if (m_Writable)
+                SetFileSize(ToHandle(m_File), finalSize < mappedSize ? finalSize : mappedSize);
+            ::CloseHandle(ToHandle(m_File));
+        }
+
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Writable = false;
+        m_File = k_InvalidHandle;
+        m_Mapping = 0;
+    }
+
+}
@@ -2,8 +2,10 @@
 
 #include <WinSock2.h>
 #include <ws2tcpip.h>
+#include <algorithm>
 #include <optional>
 #include <string>
+#include <vector>
 #include <cassert>
 #include "Utopia/Core/Log.hpp"
 
@@ -123,4 +125,68 @@ namespace Utopia::Utils {
         return std::nullopt;
     }
 
+    [[nodiscard]] bool ResolveHostAddresses(std::string_view name, std::vector<SteamNetworkingIPAddr>& outAddresses, std::string& outError) noexcept
+    {
+        outAddresses.clear();
+
+        WinsockInit wsa;
+
+        // getaddrinfo needs a terminated string
+        const std::string host(name);
+
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        // Skip families this machine has no address for
+        hints.ai_flags = AI_ADDRCONFIG;
+
+        addrinfo* addressResult = nullptr;
+        const int retval = ::getaddrinfo(host.c_str(), nullptr, &hints, &addressResult);
+        if (retval != 0)
+        {
+            outError = "getaddrinfo failed with error " + std::to_string(retval);
+            return false;
+        }
+
+        for (const addrinfo* ptr = addressResult; ptr != nullptr; ptr = ptr->ai_next)
+        {
+            SteamNetworkingIPAddr address;
+            if (ptr->ai_family == AF_INET)
+            {
+                const auto* sockaddrIPv4 = reinterpret_cast<const sockaddr_in*>(ptr->ai_addr);
+                address.SetIPv4(::ntohl(sockaddrIPv4->sin_addr.s_addr), 0);
+            }
+            else if (ptr->ai_family == AF_INET6)
+            {
+                const auto* sockaddrIPv6 = reinterpret_cast<const sockaddr_in6*>(ptr->ai_addr);
+                address.SetIPv6(sockaddrIPv6->sin6_addr.s6_addr, 0);
+            }
+            else
+            {
+                continue;
+            }
+
+            if (std::find(outAddresses.begin(), outAddresses.end(), address) == outAddresses.end())
+                outAddresses.push_back(address);
+        }
+
+        ::freeaddrinfo(addressResult);
+
+        if (outAddresses.empty())
+        {
+            outError = "No IPv4 or IPv6 addresses";
+            return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] bool SetCurrentThreadAffinity(int core) noexcept
+    {
+        if (core < 0 || core >= static_cast<int>(sizeof(DWORD_PTR) * 8))
+            return false;
+
+        const DWORD_PTR mask = static_cast<DWORD_PTR>(1) << core;
+        return ::SetThreadAffinityMask(::GetCurrentThread(), mask) != 0;
+    }
+
 } // namespace Utopia::Utils
@@ -0,0 +1,328 @@
+#include "AsyncClient.hpp"
+
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace Utopia {
+
+    namespace {
+
+        // One process-wide thread for request timeouts, so connections never need a thread of their own.
+        // Callbacks run on the timer thread without its lock held.
+        class RequestTimer
+        {
+        public:
+            using TimerID = uint64_t;
+            using Clock = std::chrono::steady_clock;
+
+            static RequestTimer& Get()
+            {
+                static RequestTimer s_Timer;
+                return s_Timer;
+            }
+
+            ~RequestTimer()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    m_Stopping = true;
+                }
+                m_Condition.notify_one();
+                m_Thread.join();
+            }
+
+            TimerID Schedule(Clock::time_point deadline, std::function<void()> function)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                const TimerID timerID = m_NextTimerID++;
+                const bool earliest = m_Timers.empty() || deadline < m_Timers.begin()->first.first;
+                m_Timers.emplace(std::make_pair(deadline, timerID), std::move(function));
+                m_Deadlines.emplace(timerID, deadline);
+
+                if (earliest)
+                    m_Condition.notify_one();
+                return timerID;
+            }
+
+            void Cancel(TimerID timerID)
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                const auto it = m_Deadlines.find(timerID);
+                if (it == m_Deadlines.end())
+                    return;
+
+                m_Timers.erase(std::make_pair(it->second, timerID));
+                m_Deadlines.erase(it);
+            }
+
+        private:
+            RequestTimer()
+                : m_Thread([this]() { ThreadFunc(); }) {}
+
+            void ThreadFunc()
+            {
+                std::vector<std::function<void()>> expired;
+
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                while (!m_Stopping)
+                {
+                    if (m_Timers.empty())
+                    {
+                        m_Condition.wait(lock);
+                        continue;
+                    }
+
+                    const Clock::time_point now = Clock::now();
+                    while (!m_Timers.empty() && m_Timers.begin()->first.first <= now)
+                    {
+                        const auto it = m_Timers.begin();
+                        m_Deadlines.erase(it->first.second);
+                        expired.push_back(std::move(it->second));
+                        m_Timers.erase(it);
+                    }
+
+                    if (expired.empty())
+                    {
+                        m_Condition.wait_until(lock, m_Timers.begin()->first.first);
+                        continue;
+                    }
+
+                    lock.unlock();
+                    for (std::function<void()>& function : expired)
+                        function();
+                    expired.clear();
+                    lock.lock();
+                }
+            }
+
+        private:
+            std::mutex m_Mutex;
+            std::condition_variable m_Condition;
+            std::map<std::pair<Clock::time_point, TimerID>, std::function<void()>> m_Timers;
+            std::unordered_map<TimerID, Clock::time_point> m_Deadlines;
+            TimerID m_NextTimerID = 1;
+            bool m_Stopping = false;
+
+            // Last, so everything above exists before the thread starts
+            std::thread m_Thread;
+        };
+
+    } // anonymous namespace
+
+    struct AsyncClient::State
+    {
+        struct PendingRequest
+        {
+            RequestOperation* Operation = nullptr;
+            RequestTimer::TimerID TimerID = 0;
+        };
+
+        explicit State(Executor& executor)
+            : Resumer(executor) {}
+
+        void Resume(std::coroutine_handle<> handle)
+        {
+            Resumer.Post([handle]() { handle.resume(); });
+        }
+
+        void OnConnected();
+        void OnDisconnected();
+        void OnMessage(MessageHandle message);
+        void CompleteRequest(uint32_t correlationID, RequestStatus status, MessageHandle response);
+
+        Executor& Resumer;
+
+        std::mutex Mutex;
+        bool Connected = false;
+        std::vector<ConnectOperation*> ConnectWaiters;
+        // Messages nobody was waiting for yet
+        std::deque<MessageHandle> Inbox;
+        std::deque<ReceiveOperation*> ReceiveWaiters;
+        uint32_t NextCorrelationID = 1;
+        std::unordered_map<uint32_t, PendingRequest> Requests;
+    };
+
+    void AsyncClient::State::OnConnected()
+    {
+        std::vector<ConnectOperation*> waiters;
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Connected = true;
+            waiters.swap(ConnectWaiters);
+        }
+
+        for (ConnectOperation* operation : waiters)
+        {
+            operation->Connected = true;
+            Resume(operation->Handle);
+        }
+    }
+
+    void AsyncClient::State::OnDisconnected()
+    {
+        std::vector<ConnectOperation*> connectWaiters;
+        std::deque<ReceiveOperation*> receiveWaiters;
+        std::unordered_map<uint32_t, PendingRequest> requests;
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Connected = false;
+            connectWaiters.swap(ConnectWaiters);
+            receiveWaiters.swap(ReceiveWaiters);
+            requests.swap(Requests);
+        }
+
+        // Waiters resume with their failure defaults
+        for (ConnectOperation* operation : connectWaiters)
+            Resume(operation->Handle);
+        for (ReceiveOperation* operation : receiveWaiters)
+            Resume(operation->Handle);
+        for (auto& [correlationID, request] : requests)
+        {
+            RequestTimer::Get().Cancel(request.TimerID);
+            request.Operation->Status = RequestStatus::Disconnected;
+            Resume(request.Operation->Handle);
+        }
+    }
+
+    void AsyncClient::State::OnMessage(MessageHandle message)
+    {
+        uint32_t correlationID;
+        Buffer reply;
+        if (RequestEnvelope::UnwrapResponse(message.GetBuffer(), correlationID, reply))
+        {
+            CompleteRequest(correlationID, RequestStatus::Ok, std::move(message));
+            return;
+        }
+
+        ReceiveOperation* operation = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            if (ReceiveWaiters.empty())
+            {
+                Inbox.push_back(std::move(message));
+                return;
+            }
+
+            operation = ReceiveWaiters.front();
+            ReceiveWaiters.pop_front();
+        }
+
+        operation->Message = std::move(message);
+        Resume(operation->Handle);
+    }
+
+    void AsyncClient::State::CompleteRequest(uint32_t correlationID, RequestStatus status, MessageHandle response)
+    {
+        PendingRequest request;
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            const auto it = Requests.find(correlationID);
+            // Already timed out, or a reply to a request made before a reconnect
+            if (it == Requests.end())
+                return;
+
+            request = it->second;
+            Requests.erase(it);
+        }
+
+        if (status != RequestStatus::TimedOut)
+            RequestTimer::Get().Cancel(request.TimerID);
+
+        request.Operation->Status = status;
+        request.Operation->Response = std::move(response);
+        Resume(request.Operation->Handle);
+    }
+
+    AsyncClient::AsyncClient(Client& client, Executor& executor)
+        : m_Client(client), m_Executor(executor), m_State(std::make_shared<State>(executor))
+    {
+        m_State->Connected = client.GetConnectionStatus() == Client::ConnectionStatus::Connected;
+
+        // The callbacks are cleared before the state goes away, so a raw pointer is enough
+        State* state = m_State.get();
+        m_Client.SetServerConnectedCallback([state]() { state->OnConnected(); });
+        m_Client.SetServerDisconnectedCallback([state]() { state->OnDisconnected(); });
+        m_Client.SetMessageReceivedCallback([state](MessageHandle message) { state->OnMessage(std::move(message)); });
+    }
+
+    AsyncClient::~AsyncClient() noexcept
+    {
+        m_Client.SetServerConnectedCallback(nullptr);
+        m_Client.SetServerDisconnectedCallback(nullptr);
+        m_Client.SetMessageReceivedCallback(nullptr);
+    }
+
+    bool AsyncClient::SuspendConnect(ConnectOperation& operation, const std::string& serverAddress)
+    {
+        // Does nothing if an attempt is already under way. Started before waiting, so the disconnect of
+        // a previous connection that is still on its way out cannot fail this one.
+        m_Client.ConnectToServer(serverAddress);
+
+        std::lock_guard<std::mutex> lock(m_State->Mutex);
+        if (m_State->Connected)
+        {
+            operation.Connected = true;
+            return false;
+        }
+        // Failed already; its disconnect may have been delivered before we got here
+        if (!m_Client.IsRunning())
+            return false;
+
+        m_State->ConnectWaiters.push_back(&operation);
+        return true;
+    }
+
+    bool AsyncClient::SuspendReceive(ReceiveOperation& operation)
+    {
+        std::lock_guard<std::mutex> lock(m_State->Mutex);
+        if (!m_State->Inbox.empty())
+        {
+            operation.Message = std::move(m_State->Inbox.front());
+            m_State->Inbox.pop_front();
+            return false;
+        }
+
+        if (!m_State->Connected)
+            return false;
+
+        m_State->ReceiveWaiters.push_back(&operation);
+        return true;
+    }
+
+    bool AsyncClient::SuspendRequest(RequestOperation& operation, OutgoingMessage message, std::chrono::milliseconds timeout, SendFlags flags, uint16_t lane)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_State->Mutex);
+            if (!m_State->Connected || !message)
+            {
+                operation.Status = RequestStatus::Disconnected;
+                return false;
+            }
+
+            uint32_t correlationID = m_State->NextCorrelationID++;
+            // 0 is never handed out, which keeps it free as a "no request" marker for servers
+            if (correlationID == 0)
+                correlationID = m_State->NextCorrelationID++;
+            std::memcpy(static_cast<std::byte*>(message.GetData()) + MessageHeader::k_Size, &correlationID, sizeof(correlationID));
+
+            // The timer only holds the state weakly, so it may safely fire after we are gone
+            const std::weak_ptr<State> weakState = m_State;
+            State::PendingRequest& request = m_State->Requests[correlationID];
+            request.Operation = &operation;
+            request.TimerID = RequestTimer::Get().Schedule(RequestTimer::Clock::now() + timeout, [weakState, correlationID]()
+                {
+                    if (const std::shared_ptr<State> state = weakState.lock())
+                        state->CompleteRequest(correlationID, RequestStatus::TimedOut, MessageHandle());
+                });
+        }
+
+        // The reply may resume the coroutine before this returns, so operation must not be touched from here on
+        m_Client.SendOutgoingMessage(std::move(message), flags, lane);
+        return true;
+    }
+
+} // namespace Utopia
@@ -0,0 +1,235 @@
+#pragma once
+
+#include "Client.hpp"
+#include "Executor.hpp"
+#include "MessageHandle.hpp"
+#include "MessageProtocol.hpp"
+#include "SendFlags.hpp"
+#include "Task.hpp"
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    enum class RequestStatus
+    {
+        Ok = 0,
+        TimedOut,
+        // The connection closed before the reply arrived
+        Disconnected,
+        // A reply arrived but did not decode as the expected type
+        Malformed
+    };
+
+    template<typename T>
+    struct RequestResult
+    {
+        RequestStatus Status = RequestStatus::Disconnected;
+        // Only set when Status is Ok
+        std::optional<T> Reply;
+
+        bool IsOk() const { return Status == RequestStatus::Ok; }
+        explicit operator bool() const { return IsOk(); }
+    };
+
+    // Awaitable front end for a Client, so a connection can be driven by a coroutine instead of
+    // callbacks and hand-written state machines:
+    //   Task<> RunBot(AsyncClient& client)
+    //   {
+    //       if (!co_await client.ConnectAsync("127.0.0.1:8192"))
+    //           co_return;
+    //
+    //       const RequestResult<JoinReply> join = co_await client.Request<JoinReply>(JoinRequest{ ... });
+    //       while (MessageHandle message = co_await client.Receive())
+    //           ...
+    //   }
+    // Suspended coroutines are resumed through the executor, so they continue on the game thread,
+    // a pool or wherever it runs work; many connections can share one thread that way.
+    //
+    // Takes over the client's message, connected and disconnected callbacks. Do not set a data batch
+    // callback on the client, since it would take precedence. Servers answer Request() through
+    // RequestEnvelope. Operations still pending when the AsyncClient is destroyed never resume.
+    class AsyncClient
+    {
+    public:
+        static constexpr std::chrono::milliseconds k_DefaultRequestTimeout{ 5000 };
+
+        class ConnectAwaiter;
+        class ReceiveAwaiter;
+        template<typename Reply>
+        class RequestAwaiter;
+
+    public:
+        AsyncClient(Client& client, Executor& executor);
+        ~AsyncClient() noexcept;
+
+        AsyncClient(const AsyncClient&) = delete;
+        AsyncClient& operator=(const AsyncClient&) = delete;
+
+        // Resumes with true once connected, false if the connection could not be established.
+        // Joins an already running connection attempt instead of starting a second one.
+        [[nodiscard]] ConnectAwaiter ConnectAsync(std::string serverAddress);
+
+        // Resumes with the next message that is not a reply to a Request(), in arrival order.
+        // An empty handle means the connection closed and nothing is left to receive.
+        [[nodiscard]] ReceiveAwaiter Receive();
+
+        // Sends request with a fresh correlation ID and resumes when the matching reply arrives,
+        // the timeout elapses or the connection closes
+        template<NetworkMessage Reply, NetworkMessage T>
+        [[nodiscard]] RequestAwaiter<Reply> Request(const T& request, std::chrono::milliseconds timeout = k_DefaultRequestTimeout,
+            SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            return RequestAwaiter<Reply>(*this, request, timeout, flags, lane);
+        }
+
+        void Disconnect() { m_Client.Disconnect(); }
+
+        Client& GetClient() { return m_Client; }
+        Executor& GetExecutor() { return m_Executor; }
+
+    private:
+        struct ConnectOperation
+        {
+            std::coroutine_handle<> Handle;
+            bool Connected = false;
+        };
+
+        struct ReceiveOperation
+        {
+            std::coroutine_handle<> Handle;
+            MessageHandle Message;
+        };
+
+        struct RequestOperation
+        {
+            std::coroutine_handle<> Handle;
+            RequestStatus Status = RequestStatus::Disconnected;
+            MessageHandle Response;
+        };
+
+        // Shared with the request timer, which may outlive the AsyncClient
+        struct State;
+
+        // Each returns false if the operation completed without suspending
+        bool SuspendConnect(ConnectOperation& operation, const std::string& serverAddress);
+        bool SuspendReceive(ReceiveOperation& operation);
+        bool SuspendRequest(RequestOperation& operation, OutgoingMessage message, std::chrono::milliseconds timeout, SendFlags flags, uint16_t lane);
+
+        // Decodes the message an envelope carries
+        template<NetworkMessage T>
+        static bool DecodeResponse(const MessageHandle& response, T& outMessage)
+        {
+            uint32_t correlationID;
+            Buffer message;
+            return RequestEnvelope::UnwrapResponse(response.GetBuffer(), correlationID, message) && DecodeMessage(message, outMessage);
+        }
+
+    private:
+        Client& m_Client;
+        Executor& m_Executor;
+        std::shared_ptr<State> m_State;
+
+    public:
+        class ConnectAwaiter
+        {
+        public:
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                m_Operation.Handle = handle;
+                return m_Owner.SuspendConnect(m_Operation, m_ServerAddress);
+            }
+            bool await_resume() const noexcept { return m_Operation.Connected; }
+
+        private:
+            friend class AsyncClient;
+            ConnectAwaiter(AsyncClient& owner, std::string serverAddress)
+                : m_Owner(owner), m_ServerAddress(std::move(serverAddress)) {}
+
+            AsyncClient& m_Owner;
+            std::string m_ServerAddress;
+            ConnectOperation m_Operation;
+        };
+
+        class ReceiveAwaiter
+        {
+        public:
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                m_Operation.Handle = handle;
+                return m_Owner.SuspendReceive(m_Operation);
+            }
+            MessageHandle await_resume() noexcept { return std::move(m_Operation.Message); }
+
+        private:
+            friend class AsyncClient;
+            explicit ReceiveAwaiter(AsyncClient& owner)
+                : m_Owner(owner) {}
+
+            AsyncClient& m_Owner;
+            ReceiveOperation m_Operation;
+        };
+
+        template<typename Reply>
+        class RequestAwaiter
+        {
+        public:
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                m_Operation.Handle = handle;
+                return m_Owner.SuspendRequest(m_Operation, std::move(m_Message), m_Timeout, m_Flags, m_Lane);
+            }
+
+            RequestResult<Reply> await_resume()
+            {
+                RequestResult<Reply> result;
+                result.Status = m_Operation.Status;
+                if (result.Status != RequestStatus::Ok)
+                    return result;
+
+                Reply reply{};
+                if (DecodeResponse(m_Operation.Response, reply))
+                    result.Reply.emplace(std::move(reply));
+                else
+                    result.Status = RequestStatus::Malformed;
+                return result;
+            }
+
+        private:
+            friend class AsyncClient;
+            template<typename T>
+            RequestAwaiter(AsyncClient& owner, const T& request, std::chrono::milliseconds timeout, SendFlags flags, uint16_t lane)
+                : m_Owner(owner), m_Message(RequestEnvelope::EncodeRequest(0, request)), m_Timeout(timeout), m_Flags(flags), m_Lane(lane) {}
+
+            AsyncClient& m_Owner;
+            // The correlation ID is filled in when the request is sent
+            OutgoingMessage m_Message;
+            std::chrono::milliseconds m_Timeout;
+            SendFlags m_Flags;
+            uint16_t m_Lane;
+            RequestOperation m_Operation;
+        };
+    };
+
+    inline AsyncClient::ConnectAwaiter AsyncClient::ConnectAsync(std::string serverAddress)
+    {
+        return ConnectAwaiter(*this, std::move(serverAddress));
+    }
+
+    inline AsyncClient::ReceiveAwaiter AsyncClient::Receive()
+    {
+        return ReceiveAwaiter(*this);
+    }
+
+} // namespace Utopia
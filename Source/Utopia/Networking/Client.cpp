@@ -3,19 +3,37 @@
 #include "Utopia/Core/Buffer.hpp"
 #include "Utopia/Core/Log.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cassert>
+#include <cstring>
 #include <format>
+#include <utility>
 
 namespace Utopia {
 
-    // Can only have one server instance per-process
-    Client* Client::s_Instance = nullptr;
+    namespace {
+
+        std::vector<std::byte> CopyPayload(const SteamNetworkingMessage_t& message)
+        {
+            const std::byte* data = static_cast<const std::byte*>(message.m_pData);
+            return std::vector<std::byte>(data, data + message.m_cbSize);
+        }
+
+        // A send the connection refused because it had just gone away still has to reach the server
+        bool ShouldReplay(int64 messageNumberOrResult)
+        {
+            return messageNumberOrResult >= 0 ||
+                messageNumberOrResult == -k_EResultNoConnection ||
+                messageNumberOrResult == -k_EResultInvalidState;
+        }
+
+    } // anonymous namespace
 
     Client::~Client() noexcept
     {
         // Ensure we aren't running. If we are, shut down gracefully.
-        if (m_Running.load())
+        if (IsRunning())
         {
             Shutdown();
         }
@@ -25,13 +43,30 @@ namespace Utopia {
         {
             m_NetworkThread.join();
         }
+
+        // Callbacks still queued on the executor refer to this client
+        std::unique_lock<std::mutex> lock(m_DispatchMutex);
+        m_DispatchCondition.wait(lock, [this]() { return m_PendingDispatches.load() == 0; });
     }
 
     void Client::ConnectToServer(const std::string& serverAddress)
     {
-        // If we're already running, bail out.
-        if (m_Running.load())
-            return;
+        {
+            std::lock_guard<std::mutex> lock(m_ConnectMutex);
+            // Already connecting or connected, or another caller is about to start
+            if (m_Running.load() || m_RestartRequested.load() || m_JoinPending)
+                return;
+
+            // A callback on the network thread cannot join it; the thread starts over once the last connection is down
+            if (std::this_thread::get_id() == m_NetworkThread.get_id())
+            {
+                m_RestartAddress = serverAddress;
+                m_RestartRequested.store(true);
+                return;
+            }
+
+            m_JoinPending = true;
+        }
 
         // If an old thread is still around, join it before starting a new one
         if (m_NetworkThread.joinable())
@@ -39,31 +74,87 @@ namespace Utopia {
             m_NetworkThread.join();
         }
 
-        m_ServerAddress = serverAddress;
+        std::lock_guard<std::mutex> lock(m_ConnectMutex);
+        m_JoinPending = false;
+        PrepareConnect(serverAddress);
         m_NetworkThread = std::thread([this]()
             {
                 NetworkThreadFunc();
             });
     }
 
+    void Client::PrepareConnect(const std::string& serverAddress)
+    {
+        m_CompressionConfig = m_PendingCompressionConfig;
+
+        // Events left over from the previous connection refer to a connection that no longer exists
+        m_TickInbox.Clear();
+        m_Dispatching = !m_TickMode && m_CallbackExecutor != &InlineExecutor::Get();
+
+        m_ServerAddress = serverAddress;
+        m_Metrics.SetLabels({ { "role", "client" }, { "server", serverAddress } });
+
+        // Set before the network thread runs, so a Disconnect() during its setup is never overwritten
+        m_ConnectionStatus.store(ConnectionStatus::Connecting);
+        m_Running.store(true);
+    }
+
     void Client::Disconnect()
     {
         // Signal the worker thread to stop
-        m_Running.store(false);
+        Shutdown();
 
-        // Join once we are done
-        if (m_NetworkThread.joinable())
+        // Join once we are done. From a callback on the network thread, it stops on its own once the callback returns.
+        if (m_NetworkThread.joinable() && std::this_thread::get_id() != m_NetworkThread.get_id())
         {
             m_NetworkThread.join();
         }
     }
 
+    void Client::SetNetworkConditions(const NetworkConditionProfile& profile, ConditionDirection direction)
+    {
+        std::lock_guard<std::mutex> lock(m_NetworkConditionsMutex);
+        m_NetworkConditions = profile;
+        m_NetworkConditionDirection = direction;
+        if (m_NetworkConditionsStarted)
+            NetworkConditions::Apply(profile, direction);
+    }
+
+    void Client::ClearNetworkConditions()
+    {
+        std::lock_guard<std::mutex> lock(m_NetworkConditionsMutex);
+        // Leave conditions another instance applied since alone
+        if (m_NetworkConditions && m_NetworkConditionsStarted && NetworkConditions::GetActive() == *m_NetworkConditions)
+            NetworkConditions::Clear();
+        m_NetworkConditions.reset();
+    }
+
+    void Client::ApplyNetworkConditions()
+    {
+        std::lock_guard<std::mutex> lock(m_NetworkConditionsMutex);
+        m_NetworkConditionsStarted = true;
+        if (m_NetworkConditions)
+            NetworkConditions::Apply(*m_NetworkConditions, m_NetworkConditionDirection);
+    }
+
     void Client::SetDataReceivedCallback(const DataReceivedCallback& function)
     {
         std::lock_guard<std::mutex> lock(m_Mutex);
         m_DataReceivedCallback = function;
     }
 
+    void Client::SetDataBatchReceivedCallback(const DataBatchReceivedCallback& function)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_DataBatchReceivedCallback = function;
+    }
+
+    void Client::SetMessageReceivedCallback(const MessageReceivedCallback& function)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_MessageReceivedCallback = function;
+    }
+
     void Client::SetServerConnectedCallback(const ServerConnectedCallback& function)
     {
         std::lock_guard<std::mutex> lock(m_Mutex);
@@ -76,120 +167,723 @@ namespace Utopia {
         m_ServerDisconnectedCallback = function;
     }
 
+    void Client::SetWritableCallback(const WritableCallback& function)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_WritableCallback = function;
+    }
+
+    void Client::SetConnectionInterruptedCallback(const ConnectionInterruptedCallback& function)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_ConnectionInterruptedCallback = function;
+    }
+
+    void Client::SetSessionResumedCallback(const SessionResumedCallback& function)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_SessionResumedCallback = function;
+    }
+
     void Client::NetworkThreadFunc()
     {
-        // Set the static instance pointer for callbacks
-        s_Instance = this;
+        while (true)
+        {
+            RunConnection();
 
-        // Reset connection status
-        m_ConnectionStatus.store(ConnectionStatus::Connecting);
+            // Picks up a ConnectToServer() made from a callback on this thread
+            std::lock_guard<std::mutex> lock(m_ConnectMutex);
+            if (!m_RestartRequested.load())
+                return;
+
+            m_RestartRequested.store(false);
+            PrepareConnect(m_RestartAddress);
+        }
+    }
+
+    void Client::RunConnection()
+    {
+        m_NetworkWaiter.Configure(m_NetworkThreadConfig);
+        m_ReceiveBuffer.assign(m_ReceiveBatchSize, nullptr);
+        m_ReceivedBatch.reserve(m_ReceiveBatchSize);
+        if (m_CompressionConfig.IsEnabled())
+            m_DecompressBuffers.resize(m_ReceiveBatchSize);
 
-        SteamDatagramErrMsg errMsg{};
-        if (!GameNetworkingSockets_Init(nullptr, errMsg))
+        std::string errorMessage;
+        m_Runtime = NetworkingRuntime::Acquire(errorMessage);
+        if (!m_Runtime)
         {
+            UT_ERROR_TAG("CLIENT", "{}", errorMessage);
             m_ConnectionDebugMessage = "Could not initialize GameNetworkingSockets";
             m_ConnectionStatus.store(ConnectionStatus::FailedToConnect);
+            m_Running.store(false);
+            NotifyDisconnected();
             return;
         }
 
-        m_Interface = SteamNetworkingSockets();
-        assert(m_Interface && "SteamNetworkingSockets() returned nullptr!");
+        m_Interface = m_Runtime->GetInterface();
+        ApplyNetworkConditions();
 
-        // Start connecting
+        // Status changes may be routed here from another instance's thread; queue them for this one
+        m_StatusListener = m_Runtime->AddListener([this](const SteamNetConnectionStatusChangedCallback_t& status)
+            {
+                m_StatusInbox.Push(status);
+                m_NetworkWaiter.Notify();
+            });
+
+        // Literal addresses connect right away; host names resolve off this thread while the loop runs
+        m_ConnectAddresses.clear();
+        m_NextConnectAddress = 0;
+        m_ConnectAttempts.clear();
         SteamNetworkingIPAddr address;
-        if (!address.ParseString(m_ServerAddress.c_str()))
+        if (address.ParseString(m_ServerAddress.c_str()))
         {
-            OnFatalError(fmt::format("Invalid IP address - could not parse {}", m_ServerAddress));
-            m_ConnectionDebugMessage = "Invalid IP address";
-            m_ConnectionStatus.store(ConnectionStatus::FailedToConnect);
-            return;
+            m_ConnectAddresses.push_back(address);
+        }
+        else
+        {
+            std::string host;
+            if (!DnsResolver::SplitHostPort(m_ServerAddress, host, m_ServerPort))
+            {
+                OnFatalError(fmt::format("Invalid server address - expected ip:port or host:port, got {}", m_ServerAddress));
+                m_ConnectionDebugMessage = "Invalid server address";
+                m_ConnectionStatus.store(ConnectionStatus::FailedToConnect);
+                ReleaseRuntime();
+                NotifyDisconnected();
+                return;
+            }
+            m_DnsQuery = DnsResolver::Get().ResolveAsync(host);
         }
 
-        SteamNetworkingConfigValue_t options;
-        options.SetPtr(
-            k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
-            (void*)ConnectionStatusChangedCallback
-        );
-
-        m_Connection = m_Interface->ConnectByIPAddress(address, 1, &options);
-        if (m_Connection == k_HSteamNetConnection_Invalid)
+        if (!m_DnsQuery && !StartConnectAttempt())
         {
             m_ConnectionDebugMessage = "Failed to create connection";
             m_ConnectionStatus.store(ConnectionStatus::FailedToConnect);
+            m_Running.store(false);
+            ReleaseRuntime();
+            NotifyDisconnected();
             return;
         }
 
-        m_Running.store(true);
+        m_LaneStats.Reset(m_LaneConfig);
+        m_LastLaneSample = std::chrono::steady_clock::now();
+        m_LastTelemetrySample = m_LastLaneSample;
+        m_LastFlowControlCheck = m_LastLaneSample;
+        m_Congested.store(false);
+        m_WritablePending.store(false);
+
+        // Sessions belong to one ConnectToServer(); a new one always starts fresh
+        m_Reconnecting = false;
+        m_ReconnectAttempt = 0;
+        m_AwaitingGrant = false;
+        {
+            std::lock_guard<std::mutex> lock(m_ReplayMutex);
+            m_Replay.Clear();
+            m_SessionToken = {};
+            m_SessionLive = false;
+            m_ReplayOverflowed = false;
+        }
 
         while (m_Running.load())
         {
-            PollIncomingMessages();
-            PollConnectionStateChanges();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // Still resolving, racing attempts or waiting to reconnect; sends stay queued until a connection wins
+            if (m_Connection == k_HSteamNetConnection_Invalid)
+            {
+                bool didWork = UpdateConnectAttempts();
+                if (m_ReconnectConfig.Enabled)
+                    didWork |= HoldSendQueue() > 0;
+                didWork |= PollConnectionStateChanges() > 0;
+                m_NetworkWaiter.Wait(didWork);
+                continue;
+            }
+
+            const auto iterationStart = std::chrono::steady_clock::now();
+            bool didWork = PollIncomingMessages() > 0;
+            // Read before draining, so every send that preceded EndFrame() is part of this flush
+            const bool endOfFrame = m_EndFrameRequested.exchange(false, std::memory_order_acquire);
+            if (!m_ReconnectConfig.Enabled || m_SessionLive)
+                didWork |= FlushSendQueue() > 0;
+            else
+                didWork |= HoldSendQueue() > 0;
+            if (m_AwaitingGrant)
+                CheckSessionGrant();
+            if (endOfFrame)
+                FlushEndOfFrame();
+            didWork |= PollConnectionStateChanges() > 0;
+            SampleConnection();
+            DispatchWritable();
+            m_Metrics.AddPollIteration(std::chrono::steady_clock::now() - iterationStart);
+            m_NetworkWaiter.Wait(didWork);
         }
 
-        // Close the connection gracefully
-        bool closeResult = m_Interface->CloseConnection(m_Connection, 0, nullptr, false);
-        if (!closeResult)
+        // Get anything queued before Disconnect() onto the wire
+        if (!m_ReconnectConfig.Enabled || m_SessionLive)
+            FlushSendQueue();
+
+        // Close the connection gracefully, unless the server already did
+        if (m_Connection != k_HSteamNetConnection_Invalid)
         {
-            UT_WARN_TAG("CLIENT", "CloseConnection returned false, indicating an error");
+            bool closeResult = m_Interface->CloseConnection(m_Connection, 0, nullptr, false);
+            if (!closeResult)
+            {
+                UT_WARN_TAG("CLIENT", "CloseConnection returned false, indicating an error");
+            }
+            m_Connection = k_HSteamNetConnection_Invalid;
         }
+        CloseConnectAttempts();
+        m_DnsQuery.reset();
 
         m_ConnectionStatus.store(ConnectionStatus::Disconnected);
 
-        // Shut down the networking
-        GameNetworkingSockets_Kill();
+        // Sends that raced with shutdown have nowhere to go
+        ReleaseQueuedSends();
+
+        // Shut down the networking, if we were the last user of it
+        ReleaseRuntime();
+
+        NotifyDisconnected();
     }
 
-    void Client::Shutdown()
+    bool Client::StartConnectAttempt()
+    {
+        // Addresses that cannot even be attempted are skipped
+        while (m_NextConnectAddress < m_ConnectAddresses.size())
+        {
+            const SteamNetworkingIPAddr& address = m_ConnectAddresses[m_NextConnectAddress++];
+            const HSteamNetConnection connection = m_Runtime->ConnectByIPAddress(address, m_StatusListener);
+            if (connection == k_HSteamNetConnection_Invalid)
+                continue;
+
+            // Lanes must exist before anything is sent on them; a failure here only costs prioritization
+            m_LaneConfig.Apply(m_Interface, connection);
+
+            if (m_ReconnectConfig.Enabled)
+            {
+                // Notice a drop within DropTimeout rather than the library's default, and while reconnecting,
+                // do not sit on an attempt the backoff would already have retried
+                const int32 dropTimeout = static_cast<int32>(m_ReconnectConfig.DropTimeout.count());
+                SteamNetworkingUtils()->SetConnectionConfigValueInt32(connection, k_ESteamNetworkingConfig_TimeoutConnected, dropTimeout);
+                if (m_Reconnecting)
+                    SteamNetworkingUtils()->SetConnectionConfigValueInt32(connection, k_ESteamNetworkingConfig_TimeoutInitial, dropTimeout);
+            }
+
+            // With a single candidate there is nothing to race, so it is the connection from the start
+            if (m_ConnectAddresses.size() == 1)
+                m_Connection = connection;
+            else
+                m_ConnectAttempts.push_back(connection);
+
+            m_NextConnectAttempt = std::chrono::steady_clock::now() + k_ConnectAttemptDelay;
+            return true;
+        }
+        return false;
+    }
+
+    bool Client::UpdateConnectAttempts()
+    {
+        // Between reconnect attempts. The addresses resolved for the first connection are reused.
+        if (m_Reconnecting && !m_DnsQuery && m_ConnectAttempts.empty())
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (now < m_NextReconnectAttempt)
+                return false;
+
+            if (now >= m_ReconnectDeadline)
+            {
+                m_Reconnecting = false;
+                FailConnect(fmt::format("Gave up reconnecting after {} attempts", m_ReconnectAttempt));
+                return true;
+            }
+
+            m_NextConnectAddress = 0;
+            if (!StartConnectAttempt())
+                ScheduleReconnect();
+            return true;
+        }
+
+        if (m_DnsQuery)
+        {
+            if (!m_DnsQuery->IsReady())
+                return false;
+
+            const DnsResult& result = m_DnsQuery->GetResult();
+            if (result.Success)
+            {
+                // Start with the family that connected last time
+                m_ConnectAddresses = result.Addresses;
+                DnsResolver::SortForHappyEyeballs(m_ConnectAddresses, m_PreferIPv6);
+                for (SteamNetworkingIPAddr& address : m_ConnectAddresses)
+                    address.m_port = m_ServerPort;
+            }
+
+            const std::string error = result.Success ? "Failed to create connection" : fmt::format("Could not resolve {}: {}", m_DnsQuery->GetHost(), result.Error);
+            m_DnsQuery.reset();
+
+            if (!StartConnectAttempt())
+                FailConnect(error);
+            return true;
+        }
+
+        // Happy Eyeballs: give the attempts in flight a head start before bringing in the next address
+        if (!m_ConnectAttempts.empty() && m_NextConnectAddress < m_ConnectAddresses.size() &&
+            std::chrono::steady_clock::now() >= m_NextConnectAttempt)
+        {
+            return StartConnectAttempt();
+        }
+        return false;
+    }
+
+    void Client::CloseConnectAttempts()
+    {
+        for (HSteamNetConnection attempt : m_ConnectAttempts)
+        {
+            m_Interface->CloseConnection(attempt, 0, nullptr, false);
+            m_Runtime->UnregisterConnection(attempt);
+        }
+        m_ConnectAttempts.clear();
+    }
+
+    void Client::FailConnect(const std::string& message)
     {
-        // Graceful shutdown
+        if (m_Reconnecting)
+        {
+            UT_WARN_TAG("CLIENT", "Reconnect attempt failed. {}", message);
+            m_ConnectionDebugMessage = message;
+            ScheduleReconnect();
+            return;
+        }
+
+        UT_ERROR_TAG("CLIENT", "Could not connect to remote host. {}", message);
+        m_ConnectionDebugMessage = message;
+        m_ConnectionStatus.store(ConnectionStatus::FailedToConnect);
         m_Running.store(false);
     }
 
-    void Client::SendBuffer(Buffer buffer, bool reliable)
+    void Client::ReleaseRuntime()
     {
-        EResult result = k_EResultInvalidState;
-        if (m_Interface && m_Connection != k_HSteamNetConnection_Invalid)
+        // Also drops the route of our connection
+        m_Runtime->RemoveListener(m_StatusListener);
+        m_StatusListener = NetworkingRuntime::k_InvalidListener;
+
+        m_Interface = nullptr;
+        m_Runtime = nullptr;
+        NetworkingRuntime::Release();
+    }
+
+    void Client::Shutdown()
+    {
+        // Graceful shutdown, including of a connection a callback asked to start next
         {
-            result = m_Interface->SendMessageToConnection(
-                m_Connection,
-                buffer.Data,
-                static_cast<uint32_t>(buffer.Size),
-                reliable ? k_nSteamNetworkingSend_Reliable : k_nSteamNetworkingSend_Unreliable,
-                nullptr // pOutMessageNumber is optional, passing nullptr
-            );
+            std::lock_guard<std::mutex> lock(m_ConnectMutex);
+            m_RestartRequested.store(false);
+            m_Running.store(false);
+        }
+        m_NetworkWaiter.Notify();
+    }
+
+    void Client::SendBuffer(Buffer buffer, SendFlags flags, uint16_t lane)
+    {
+        if (m_CompressionConfig.IsEnabled())
+        {
+            QueueMessage(EncodeOutgoingPayload(buffer, lane), flags, lane);
+            return;
+        }
+
+        // Copy into a pooled slab rather than letting the library allocate one
+        OutgoingMessage message(static_cast<uint32_t>(buffer.Size));
+        if (buffer.Size > 0)
+            std::memcpy(message.GetData(), buffer.Data, buffer.Size);
+
+        QueueMessage(std::move(message), flags, lane);
+    }
+
+    void Client::SendOutgoingMessage(OutgoingMessage message, SendFlags flags, uint16_t lane)
+    {
+        // The header has to go in front, so compression costs this path its zero-copy send
+        if (m_CompressionConfig.IsEnabled() && message)
+            message = EncodeOutgoingPayload(message.GetBuffer(), lane);
+
+        QueueMessage(std::move(message), flags, lane);
+    }
+
+    OutgoingMessage Client::EncodeOutgoingPayload(Buffer payload, uint16_t lane)
+    {
+        if (!m_CompressionConfig.ShouldCompress(lane, payload.Size))
+        {
+            CompressionResult result;
+            return EncodePayload(m_CompressionConfig, payload, lane, result);
+        }
+
+        const auto encodeStart = std::chrono::steady_clock::now();
+        CompressionResult result;
+        OutgoingMessage message = EncodePayload(m_CompressionConfig, payload, lane, result);
+        m_Metrics.AddCompression(
+            m_Connection,
+            CompressionDirection::Compress,
+            result.UncompressedSize,
+            result.Compressed ? result.CompressedSize : result.UncompressedSize,
+            std::chrono::steady_clock::now() - encodeStart
+        );
+        return message;
+    }
+
+    bool Client::DecodeIncomingPayload(int index, Buffer& outPayload)
+    {
+        const auto decodeStart = std::chrono::steady_clock::now();
+        CompressionResult result;
+        const DecodeStatus status = DecodePayload(m_CompressionConfig, outPayload, m_DecompressBuffers[index], outPayload, result);
+        if (status != DecodeStatus::Ok)
+        {
+            UT_WARN_TAG("CLIENT", "Dropping message from server: {}",
+                status == DecodeStatus::UnknownCodec ? "unknown compression codec" : "malformed compressed payload");
+            return false;
+        }
+
+        if (result.Compressed)
+            m_Metrics.AddCompression(m_Connection, CompressionDirection::Decompress, result.UncompressedSize, result.CompressedSize, std::chrono::steady_clock::now() - decodeStart);
+
+        return true;
+    }
+
+    void Client::QueueMessage(OutgoingMessage message, SendFlags flags, uint16_t lane)
+    {
+        if (!m_Running.load())
+        {
+            UT_WARN_TAG("CLIENT", "SendMessages called on an invalid connection.");
+            return;
+        }
+
+        SteamNetworkingMessage_t* outgoingMessage = message.Detach();
+        if (!outgoingMessage)
+            return;
+
+        outgoingMessage->m_nFlags = flags.GetValue();
+        outgoingMessage->m_idxLane = lane;
+
+        if (!m_SendQueue.TryPush(outgoingMessage))
+        {
+            // Queue is full; the library is thread-safe, so send on this thread instead
+            UT_WARN_TAG("CLIENT", "Send queue is full; sending from the calling thread");
+            std::unique_lock<std::mutex> replayLock(m_ReplayMutex, std::defer_lock);
+            std::vector<std::byte> replayPayload;
+            const bool reliable = (outgoingMessage->m_nFlags & k_nSteamNetworkingSend_Reliable) != 0;
+            if (m_ReconnectConfig.Enabled)
+            {
+                // In step with the network thread, so the replay buffer sees sends in wire order
+                replayLock.lock();
+                if (!m_SessionLive)
+                {
+                    // Nowhere to send it; a reliable message waits for the session, behind those already held
+                    if (reliable)
+                        RecordReplay(lane, outgoingMessage->m_nFlags, CopyPayload(*outgoingMessage));
+                    else
+                        m_Metrics.AddDropped(1);
+                    outgoingMessage->Release();
+                    return;
+                }
+                if (reliable)
+                    replayPayload = CopyPayload(*outgoingMessage);
+            }
+
+            outgoingMessage->m_conn = m_Connection;
+            int64 messageNumberOrResult = 0;
+            const uint64_t messageSize = static_cast<uint64_t>(outgoingMessage->m_cbSize);
+            m_Interface->SendMessages(1, &outgoingMessage, &messageNumberOrResult);
+            if (replayLock.owns_lock() && reliable && ShouldReplay(messageNumberOrResult))
+                RecordReplay(lane, flags.GetValue(), std::move(replayPayload));
+            if (messageNumberOrResult >= 0)
+            {
+                m_Metrics.AddSent(1, messageSize);
+            }
+            else
+            {
+                m_Metrics.AddSendFailures(1);
+                UT_WARN_TAG("CLIENT", "SendMessages failed with EResult code: {}", static_cast<int>(-messageNumberOrResult));
+            }
+            return;
+        }
+
+        m_NetworkWaiter.Notify();
+    }
+
+    int Client::FlushSendQueue()
+    {
+        m_SendBatch.clear();
+
+        // Held-back messages go out first once the connection is writable again
+        if (!m_CoalescedSends.empty() && !m_Congested.load())
+        {
+            for (const auto& [lane, message] : m_CoalescedSends)
+            {
+                // Possibly held since before a reconnect
+                message->m_conn = m_Connection;
+                m_SendBatch.push_back(message);
+            }
+            m_CoalescedSends.clear();
+        }
+
+        SteamNetworkingMessage_t* outgoingMessage = nullptr;
+        while (m_SendQueue.TryPop(outgoingMessage))
+        {
+            outgoingMessage->m_conn = m_Connection;
+            if (!DivertCongestedSend(outgoingMessage))
+                m_SendBatch.push_back(outgoingMessage);
+        }
+
+        if (m_SendBatch.empty())
+            return 0;
+
+        const int messageCount = static_cast<int>(m_SendBatch.size());
+        if (!m_Interface || m_Connection == k_HSteamNetConnection_Invalid)
+        {
+            UT_WARN_TAG("CLIENT", "Dropping {} queued messages; connection is invalid", messageCount);
+            for (SteamNetworkingMessage_t* message : m_SendBatch)
+                message->Release();
+            return messageCount;
+        }
+
+        // The library owns the messages once they are sent, so note their sizes first
+        m_SendBatchSizes.resize(messageCount);
+        for (int i = 0; i < messageCount; i++)
+        {
+            m_SendBatchSizes[i] = m_SendBatch[i]->m_cbSize;
+            m_HasNagledSends |= (m_SendBatch[i]->m_nFlags & k_nSteamNetworkingSend_NoNagle) == 0;
+        }
+
+        m_SendBatchResults.resize(messageCount);
+        if (!m_ReconnectConfig.Enabled)
+        {
+            m_Interface->SendMessages(messageCount, m_SendBatch.data(), m_SendBatchResults.data());
         }
         else
         {
-            UT_WARN_TAG("CLIENT", "SendMessageToConnection called on an invalid connection.");
+            m_SendBatchReplays.resize(messageCount);
+            for (int i = 0; i < messageCount; i++)
+            {
+                const SteamNetworkingMessage_t& message = *m_SendBatch[i];
+                StagedReplay& staged = m_SendBatchReplays[i];
+                staged.Reliable = (message.m_nFlags & k_nSteamNetworkingSend_Reliable) != 0;
+                if (!staged.Reliable)
+                    continue;
+                staged.Lane = message.m_idxLane;
+                staged.Flags = message.m_nFlags;
+                staged.Payload = CopyPayload(message);
+            }
+
+            std::lock_guard<std::mutex> lock(m_ReplayMutex);
+            m_Interface->SendMessages(messageCount, m_SendBatch.data(), m_SendBatchResults.data());
+            for (int i = 0; i < messageCount; i++)
+            {
+                StagedReplay& staged = m_SendBatchReplays[i];
+                if (staged.Reliable && ShouldReplay(m_SendBatchResults[i]))
+                    RecordReplay(staged.Lane, staged.Flags, std::move(staged.Payload));
+            }
+        }
+
+        uint64_t sentMessages = 0;
+        uint64_t sentBytes = 0;
+        for (int i = 0; i < messageCount; i++)
+        {
+            const int64 messageNumberOrResult = m_SendBatchResults[i];
+            if (messageNumberOrResult < 0)
+            {
+                m_Metrics.AddSendFailures(1);
+                UT_WARN_TAG("CLIENT", "SendMessages failed with EResult code: {}", static_cast<int>(-messageNumberOrResult));
+                continue;
+            }
+
+            sentMessages++;
+            sentBytes += static_cast<uint64_t>(m_SendBatchSizes[i]);
+        }
+        m_Metrics.AddSent(sentMessages, sentBytes);
+
+        return messageCount;
+    }
+
+    int Client::HoldSendQueue()
+    {
+        // Drained even without a session, so the queue never fills and pushes newer sends ahead of older ones
+        std::lock_guard<std::mutex> lock(m_ReplayMutex);
+        int heldCount = 0;
+        SteamNetworkingMessage_t* outgoingMessage = nullptr;
+        while (m_SendQueue.TryPop(outgoingMessage))
+        {
+            if ((outgoingMessage->m_nFlags & k_nSteamNetworkingSend_Reliable) != 0)
+                RecordReplay(outgoingMessage->m_idxLane, outgoingMessage->m_nFlags, CopyPayload(*outgoingMessage));
+            else
+                m_Metrics.AddDropped(1);
+            outgoingMessage->Release();
+            heldCount++;
+        }
+        return heldCount;
+    }
+
+    void Client::EndFrame()
+    {
+        if (!m_Running.load())
+            return;
+
+        m_EndFrameRequested.store(true, std::memory_order_release);
+        m_NetworkWaiter.Notify();
+    }
+
+    void Client::FlushEndOfFrame()
+    {
+        if (!m_HasNagledSends)
+            return;
+
+        m_HasNagledSends = false;
+        if (m_Interface && m_Connection != k_HSteamNetConnection_Invalid)
+            m_Interface->FlushMessagesOnConnection(m_Connection);
+    }
+
+    bool Client::DivertCongestedSend(SteamNetworkingMessage_t* message)
+    {
+        if (m_FlowControlConfig.UnreliablePolicy == CongestedUnreliablePolicy::Send ||
+            (message->m_nFlags & k_nSteamNetworkingSend_Reliable) != 0 ||
+            !m_Congested.load())
+        {
+            return false;
+        }
+
+        if (m_FlowControlConfig.UnreliablePolicy == CongestedUnreliablePolicy::Drop)
+        {
+            message->Release();
+            m_Metrics.AddDropped(1);
+            return true;
+        }
+
+        // Coalesce: the newest state supersedes whatever is still waiting on this lane
+        auto [it, inserted] = m_CoalescedSends.try_emplace(message->m_idxLane, message);
+        if (!inserted)
+        {
+            it->second->Release();
+            it->second = message;
+            m_Metrics.AddDropped(1);
+        }
+        return true;
+    }
+
+    void Client::UpdateCongestion(const SteamNetConnectionRealTimeStatus_t& status)
+    {
+        if (m_Congested.load())
+        {
+            // Only one caller wins the transition, so the callback fires once
+            bool expected = true;
+            if (m_FlowControlConfig.IsBelowLowWatermark(status) && m_Congested.compare_exchange_strong(expected, false))
+            {
+                m_WritablePending.store(true);
+                m_NetworkWaiter.Notify();
+            }
+        }
+        else if (m_FlowControlConfig.IsAboveHighWatermark(status))
+        {
+            m_Congested.store(true);
+        }
+    }
+
+    void Client::DispatchWritable()
+    {
+        if (!m_WritablePending.exchange(false))
+            return;
+
+        if (m_Dispatching)
+        {
+            Dispatch([this]()
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    if (m_WritableCallback)
+                        m_WritableCallback();
+                });
             return;
         }
 
-        if (result != k_EResultOK)
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_WritableCallback)
         {
-            UT_WARN_TAG("CLIENT", "SendMessageToConnection failed with EResult code: {}", static_cast<int>(result));
+            m_WritableCallback();
         }
     }
 
-    void Client::SendString(const std::string& string, bool reliable)
+    SendStatus Client::TrySendBuffer(Buffer buffer, SendFlags flags, uint16_t lane)
     {
-        SendBuffer(Buffer(string.data(), string.size()), reliable);
+        if (!m_Running.load() || !m_Interface || m_Connection == k_HSteamNetConnection_Invalid)
+            return SendStatus::NotConnected;
+
+        SteamNetConnectionRealTimeStatus_t status;
+        if (m_Interface->GetConnectionRealTimeStatus(m_Connection, &status, 0, nullptr) != k_EResultOK)
+            return SendStatus::NotConnected;
+
+        // Same hysteresis as the periodic check, so this works even with it disabled
+        UpdateCongestion(status);
+        if (m_Congested.load())
+            return SendStatus::WouldBlock;
+
+        SendBuffer(buffer, flags, lane);
+        return SendStatus::Queued;
     }
 
-    void Client::PollIncomingMessages()
+    void Client::ReleaseQueuedSends()
     {
+        for (const auto& [lane, message] : m_CoalescedSends)
+            message->Release();
+        m_CoalescedSends.clear();
+
+        SteamNetworkingMessage_t* outgoingMessage = nullptr;
+        while (m_SendQueue.TryPop(outgoingMessage))
+            outgoingMessage->Release();
+    }
+
+    void Client::SampleConnection()
+    {
+        if (m_Connection == k_HSteamNetConnection_Invalid)
+            return;
+
+        const auto now = std::chrono::steady_clock::now();
+        const std::span<const HSteamNetConnection> connection(&m_Connection, 1);
+
+        // Nothing to learn about lanes from a single one
+        if (m_LaneConfig.GetLaneCount() > 1 && now - m_LastLaneSample >= k_LaneStatsInterval)
+        {
+            m_LastLaneSample = now;
+            m_LaneStats.Sample(m_Interface, connection);
+        }
+
+        if (m_TelemetryInterval.count() > 0 && now - m_LastTelemetrySample >= m_TelemetryInterval)
+        {
+            m_LastTelemetrySample = now;
+            m_Metrics.SampleConnections(m_Interface, connection);
+        }
+
+        if (now - m_LastFlowControlCheck >= m_FlowControlConfig.CheckInterval)
+        {
+            m_LastFlowControlCheck = now;
+
+            SteamNetConnectionRealTimeStatus_t status;
+            if (m_Interface->GetConnectionRealTimeStatus(m_Connection, &status, 0, nullptr) == k_EResultOK)
+                UpdateCongestion(status);
+        }
+    }
+
+    void Client::SendString(const std::string& string, SendFlags flags, uint16_t lane)
+    {
+        SendBuffer(Buffer(string.data(), string.size()), flags, lane);
+    }
+
+    int Client::PollIncomingMessages()
+    {
+        int dispatchedCount = 0;
+
         while (m_Running.load())
         {
-            ISteamNetworkingMessage* incomingMessage = nullptr;
             int messageCount = 0;
 
             if (m_Interface && m_Connection != k_HSteamNetConnection_Invalid)
             {
                 messageCount = m_Interface->ReceiveMessagesOnConnection(
                     m_Connection,
-                    &incomingMessage,
-                    1
+                    m_ReceiveBuffer.data(),
+                    static_cast<int>(m_ReceiveBuffer.size())
                 );
             }
 
@@ -200,36 +894,117 @@ namespace Utopia {
             {
                 UT_ERROR_TAG("CLIENT", "ReceiveMessagesOnConnection returned a critical error: {}", messageCount);
                 m_Running.store(false);
-                return;
+                return dispatchedCount;
+            }
+
+            const auto callbackStart = std::chrono::steady_clock::now();
+            uint64_t receivedBytes = 0;
+            m_ReceivedBatch.clear();
+            for (int i = 0; i < messageCount; i++)
+            {
+                Buffer payload(m_ReceiveBuffer[i]->m_pData, m_ReceiveBuffer[i]->m_cbSize);
+                receivedBytes += static_cast<uint64_t>(m_ReceiveBuffer[i]->m_cbSize);
+
+                if ((m_CompressionConfig.IsEnabled() && !DecodeIncomingPayload(i, payload)) ||
+                    (m_ReconnectConfig.Enabled && HandleSessionMessage(payload)))
+                {
+                    m_ReceiveBuffer[i]->Release();
+                    m_ReceiveBuffer[i] = nullptr;
+                    continue;
+                }
+                m_ReceivedBatch.push_back(payload);
             }
 
+            if (m_TickMode)
+            {
+                // Queued without taking the callback lock; the game thread picks them up in BeginTick()
+                size_t payloadIndex = 0;
+                for (int i = 0; i < messageCount; i++)
+                {
+                    if (!m_ReceiveBuffer[i])
+                        continue;
+
+                    if (SteamNetworkingMessage_t* message = TakeReceivedMessage(i, m_ReceivedBatch[payloadIndex++]))
+                        m_TickEvents.push_back(TickEvent{ TickEventType::Data, m_Connection, MessageHandle(message) });
+                }
+                m_TickInbox.Append(m_TickEvents);
+            }
+            else if (m_Dispatching)
+            {
+                // The messages outlive the poll, so the executor gets them as handles
+                auto batch = std::make_shared<std::vector<MessageHandle>>();
+                batch->reserve(m_ReceivedBatch.size());
+                size_t payloadIndex = 0;
+                for (int i = 0; i < messageCount; i++)
+                {
+                    if (!m_ReceiveBuffer[i])
+                        continue;
+
+                    if (SteamNetworkingMessage_t* message = TakeReceivedMessage(i, m_ReceivedBatch[payloadIndex++]))
+                        batch->emplace_back(message);
+                }
+                if (!batch->empty())
+                    Dispatch([this, batch]() { RunDispatchBatch(*batch); });
+            }
+            else
             {
                 std::lock_guard<std::mutex> lock(m_Mutex);
-                if (m_DataReceivedCallback)
+                if (m_DataBatchReceivedCallback)
+                {
+                    m_DataBatchReceivedCallback(std::span<const Buffer>(m_ReceivedBatch));
+                }
+                else if (m_MessageReceivedCallback)
+                {
+                    size_t payloadIndex = 0;
+                    for (int i = 0; i < messageCount; i++)
+                    {
+                        // Dropped while decoding
+                        if (!m_ReceiveBuffer[i])
+                            continue;
+
+                        if (SteamNetworkingMessage_t* message = TakeReceivedMessage(i, m_ReceivedBatch[payloadIndex++]))
+                            m_MessageReceivedCallback(MessageHandle(message));
+                    }
+                }
+                else if (m_DataReceivedCallback)
                 {
-                    m_DataReceivedCallback(Buffer(incomingMessage->m_pData, incomingMessage->m_cbSize));
+                    for (const Buffer& payload : m_ReceivedBatch)
+                        m_DataReceivedCallback(payload);
                 }
             }
 
-            // Release when done
-            incomingMessage->Release();
-        }
-    }
+            m_Metrics.AddReceived(static_cast<uint64_t>(messageCount), receivedBytes);
+            // Dispatched callbacks are timed where they run
+            if (!m_Dispatching)
+                m_Metrics.AddCallbackTime(std::chrono::steady_clock::now() - callbackStart);
 
-    void Client::PollConnectionStateChanges()
-    {
-        if (m_Interface)
-        {
-            m_Interface->RunCallbacks();
+            // Release when done, unless ownership was handed to a MessageHandle
+            for (int i = 0; i < messageCount; i++)
+            {
+                if (m_ReceiveBuffer[i])
+                    m_ReceiveBuffer[i]->Release();
+            }
+
+            dispatchedCount += messageCount;
+
+            // A short batch means the connection is drained
+            if (messageCount < static_cast<int>(m_ReceiveBuffer.size()))
+                break;
         }
+
+        return dispatchedCount;
     }
 
-    void Client::ConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* info)
+    int Client::PollConnectionStateChanges()
     {
-        if (s_Instance)
-        {
-            s_Instance->OnConnectionStatusChanged(info);
-        }
+        if (!m_Runtime)
+            return 0;
+
+        m_Runtime->RunCallbacks();
+        return m_StatusInbox.Drain([this](SteamNetConnectionStatusChangedCallback_t* status)
+            {
+                OnConnectionStatusChanged(status);
+            });
     }
 
     void Client::OnConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* info)
@@ -243,6 +1018,25 @@ namespace Utopia {
         case k_ESteamNetworkingConnectionState_ClosedByPeer:
         case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
         {
+            const auto attempt = std::find(m_ConnectAttempts.begin(), m_ConnectAttempts.end(), info->m_hConn);
+            if (attempt != m_ConnectAttempts.end())
+            {
+                // One address failed; bring in the next right away rather than waiting out the delay
+                m_ConnectAttempts.erase(attempt);
+                m_Interface->CloseConnection(info->m_hConn, 0, nullptr, false);
+                m_Runtime->UnregisterConnection(info->m_hConn);
+
+                if (!StartConnectAttempt() && m_ConnectAttempts.empty())
+                    FailConnect(info->m_info.m_szEndDebug);
+                break;
+            }
+
+            if (ShouldReconnect(info->m_info))
+            {
+                BeginReconnect(info->m_info);
+                break;
+            }
+
             m_Running.store(false);
             m_ConnectionStatus.store(ConnectionStatus::FailedToConnect);
             m_ConnectionDebugMessage = info->m_info.m_szEndDebug;
@@ -268,6 +1062,7 @@ namespace Utopia {
                 {
                     UT_WARN_TAG("CLIENT", "CloseConnection returned an error code: {}", closeResult);
                 }
+                m_Runtime->UnregisterConnection(info->m_hConn);
             }
             m_Connection = k_HSteamNetConnection_Invalid;
             m_ConnectionStatus.store(ConnectionStatus::Disconnected);
@@ -280,12 +1075,25 @@ namespace Utopia {
 
         case k_ESteamNetworkingConnectionState_Connected:
         {
-            m_ConnectionStatus.store(ConnectionStatus::Connected);
-            std::lock_guard<std::mutex> lock(m_Mutex);
-            if (m_ServerConnectedCallback)
+            const auto attempt = std::find(m_ConnectAttempts.begin(), m_ConnectAttempts.end(), info->m_hConn);
+            if (attempt != m_ConnectAttempts.end())
+            {
+                // First attempt to connect wins the race
+                m_ConnectAttempts.erase(attempt);
+                CloseConnectAttempts();
+                m_Connection = info->m_hConn;
+            }
+            m_PreferIPv6 = !info->m_info.m_addrRemote.IsIPv4();
+
+            // Connected for real once the server's grant says whether the session carried over
+            if (m_ReconnectConfig.Enabled)
             {
-                m_ServerConnectedCallback();
+                SendSessionHello();
+                break;
             }
+
+            m_ConnectionStatus.store(ConnectionStatus::Connected);
+            NotifyConnectionEvent(TickEventType::Connected, &Client::m_ServerConnectedCallback);
             break;
         }
 
@@ -294,6 +1102,293 @@ namespace Utopia {
         }
     }
 
+    SteamNetworkingMessage_t* Client::TakeReceivedMessage(int index, const Buffer& payload)
+    {
+        // A decoded payload no longer matches the library's message, so hand out a copy
+        if (m_CompressionConfig.IsEnabled())
+            return CopyReceivedMessage(*m_ReceiveBuffer[index], payload);
+
+        return std::exchange(m_ReceiveBuffer[index], nullptr);
+    }
+
+    void Client::NotifyDisconnected()
+    {
+        NotifyConnectionEvent(TickEventType::Disconnected, &Client::m_ServerDisconnectedCallback);
+    }
+
+    void Client::NotifyConnectionEvent(TickEventType type, std::function<void()> Client::* callback)
+    {
+        if (m_TickMode)
+        {
+            m_TickInbox.Append(TickEvent{ type, m_Connection, {} });
+            return;
+        }
+        if (m_Dispatching)
+        {
+            Dispatch([this, callback]()
+                {
+                    std::lock_guard<std::mutex> lock(m_Mutex);
+                    if (this->*callback)
+                        (this->*callback)();
+                });
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (this->*callback)
+            (this->*callback)();
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Reconnection
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    void Client::SendSessionHello()
+    {
+        // A session whose unacknowledged sends were thrown away cannot be resumed faithfully; start over
+        const SessionToken resume = m_ReplayOverflowed ? SessionToken{} : m_SessionToken;
+        OutgoingMessage hello = SessionMessage::EncodeHello(resume);
+        if (m_CompressionConfig.IsEnabled() && hello)
+            hello = EncodeOutgoingPayload(hello.GetBuffer(), 0);
+
+        // Ahead of the send queue, which is held until the grant
+        SteamNetworkingMessage_t* message = hello.Detach();
+        if (!message)
+            return;
+        message->m_conn = m_Connection;
+        message->m_nFlags = SendFlags::ReliableNoNagle.GetValue();
+        message->m_idxLane = 0;
+
+        int64 messageNumberOrResult = 0;
+        m_Interface->SendMessages(1, &message, &messageNumberOrResult);
+        if (messageNumberOrResult < 0)
+            UT_WARN_TAG("CLIENT", "Could not send session hello, EResult code: {}", static_cast<int>(-messageNumberOrResult));
+
+        m_AwaitingGrant = true;
+        m_GrantDeadline = std::chrono::steady_clock::now() + m_ReconnectConfig.GrantTimeout;
+    }
+
+    void Client::CheckSessionGrant()
+    {
+        if (std::chrono::steady_clock::now() < m_GrantDeadline)
+            return;
+
+        m_AwaitingGrant = false;
+        m_Interface->CloseConnection(m_Connection, 0, "No session grant", false);
+        m_Runtime->UnregisterConnection(m_Connection);
+        m_Connection = k_HSteamNetConnection_Invalid;
+
+        // Retried like any other failed attempt while reconnecting
+        FailConnect("Server did not answer the session handshake; is SessionConfig enabled on the server?");
+    }
+
+    bool Client::HandleSessionMessage(Buffer payload)
+    {
+        MessageTypeID id;
+        if (!PeekMessageTypeID(payload, id))
+            return false;
+
+        if (id == SessionMessage::k_GrantID)
+        {
+            SessionToken token;
+            bool resumed = false;
+            std::vector<uint64_t> laneCounts;
+            if (SessionMessage::DecodeGrant(payload, token, resumed, laneCounts))
+                OnSessionGranted(token, resumed, laneCounts);
+            else
+                UT_WARN_TAG("CLIENT", "Ignoring malformed session grant");
+            return true;
+        }
+
+        if (id == SessionMessage::k_AckID)
+        {
+            std::vector<uint64_t> laneCounts;
+            if (!SessionMessage::DecodeAck(payload, laneCounts))
+                return true;
+
+            std::lock_guard<std::mutex> lock(m_ReplayMutex);
+            if (!m_ReplayOverflowed && !m_Replay.Acknowledge(laneCounts))
+                UT_WARN_TAG("CLIENT", "Server acknowledged more messages than were sent");
+            return true;
+        }
+
+        return false;
+    }
+
+    void Client::OnSessionGranted(const SessionToken& token, bool resumed, std::span<const uint64_t> laneCounts)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_ReplayMutex);
+            if (resumed)
+            {
+                if (!m_Replay.Acknowledge(laneCounts))
+                    UT_WARN_TAG("CLIENT", "Server acknowledged more messages than were sent");
+
+                // Whatever the server is missing goes out again, ahead of anything sent since the drop
+                SendReplay();
+            }
+            else if (m_SessionToken.IsValid())
+            {
+                UT_WARN_TAG("CLIENT", "Server did not resume the session; {} unacknowledged messages are lost",
+                    m_ReplayOverflowed ? 0 : m_Replay.GetPendingCount());
+                m_Replay.Clear();
+            }
+            else
+            {
+                // The first session; anything sent while connecting was held for it
+                m_Replay.Restart();
+                SendReplay();
+            }
+
+            m_SessionToken = token;
+            m_SessionLive = true;
+            m_AwaitingGrant = false;
+            m_ReplayOverflowed = false;
+        }
+
+        m_Reconnecting = false;
+        m_ReconnectAttempt = 0;
+        m_ConnectionStatus.store(ConnectionStatus::Connected);
+
+        if (resumed)
+        {
+            UT_INFO_TAG("CLIENT", "Session resumed");
+            NotifyConnectionEvent(TickEventType::Resumed, &Client::m_SessionResumedCallback);
+        }
+        else
+        {
+            NotifyConnectionEvent(TickEventType::Connected, &Client::m_ServerConnectedCallback);
+        }
+    }
+
+    void Client::SendReplay()
+    {
+        m_SendBatch.clear();
+        m_Replay.ForEach([this](uint16_t lane, int flags, Buffer payload)
+            {
+                OutgoingMessage message(static_cast<uint32_t>(payload.Size));
+                if (!message)
+                    return;
+                if (payload.Size > 0)
+                    std::memcpy(message.GetData(), payload.Data, payload.Size);
+
+                SteamNetworkingMessage_t* outgoingMessage = message.Detach();
+                outgoingMessage->m_conn = m_Connection;
+                outgoingMessage->m_nFlags = flags;
+                outgoingMessage->m_idxLane = lane;
+                m_SendBatch.push_back(outgoingMessage);
+            });
+
+        if (m_SendBatch.empty())
+            return;
+
+        const int messageCount = static_cast<int>(m_SendBatch.size());
+        UT_INFO_TAG("CLIENT", "Sending {} held messages ({} bytes)", messageCount, m_Replay.GetPendingBytes());
+        m_SendBatchResults.resize(messageCount);
+        m_Interface->SendMessages(messageCount, m_SendBatch.data(), m_SendBatchResults.data());
+        m_Metrics.AddSent(static_cast<uint64_t>(messageCount), static_cast<uint64_t>(m_Replay.GetPendingBytes()));
+        m_SendBatch.clear();
+    }
+
+    bool Client::ShouldReconnect(const SteamNetConnectionInfo_t& info) const
+    {
+        // Only a connection that once held a session comes back; a first connect that fails, fails
+        return m_ReconnectConfig.Enabled && m_Running.load() && IsResumableEnd(info) &&
+            (m_SessionToken.IsValid() || m_Reconnecting);
+    }
+
+    void Client::BeginReconnect(const SteamNetConnectionInfo_t& info)
+    {
+        UT_WARN_TAG("CLIENT", "Lost connection with remote host, reconnecting. {}", info.m_szEndDebug);
+        m_ConnectionDebugMessage = info.m_szEndDebug;
+
+        m_Interface->CloseConnection(m_Connection, 0, nullptr, false);
+        m_Runtime->UnregisterConnection(m_Connection);
+        m_Connection = k_HSteamNetConnection_Invalid;
+        m_Congested.store(false);
+        m_AwaitingGrant = false;
+        {
+            std::lock_guard<std::mutex> lock(m_ReplayMutex);
+            m_SessionLive = false;
+        }
+
+        m_ConnectionStatus.store(ConnectionStatus::Reconnecting);
+        if (!m_Reconnecting)
+        {
+            m_Reconnecting = true;
+            m_ReconnectAttempt = 0;
+            m_ReconnectDeadline = std::chrono::steady_clock::now() + m_ReconnectConfig.GiveUpAfter;
+            NotifyConnectionEvent(TickEventType::Interrupted, &Client::m_ConnectionInterruptedCallback);
+        }
+        ScheduleReconnect();
+    }
+
+    void Client::ScheduleReconnect()
+    {
+        std::uniform_real_distribution<double> jitter(0.0, 1.0);
+        const std::chrono::milliseconds delay = m_ReconnectConfig.GetRetryDelay(m_ReconnectAttempt++, jitter(m_ReconnectRandom));
+        m_NextReconnectAttempt = std::chrono::steady_clock::now() + delay;
+    }
+
+    void Client::RecordReplay(uint16_t lane, int flags, std::vector<std::byte> payload)
+    {
+        if (m_ReplayOverflowed)
+            return;
+
+        m_Replay.Push(lane, flags, std::move(payload));
+        if (m_Replay.GetPendingBytes() > m_ReconnectConfig.MaxReplayBytes)
+        {
+            UT_WARN_TAG("CLIENT", "Over {} bytes unacknowledged; the session will not be resumed after a drop", m_ReconnectConfig.MaxReplayBytes);
+            m_Replay.Clear();
+            m_ReplayOverflowed = true;
+        }
+    }
+
+    void Client::Dispatch(Executor::Work work)
+    {
+        m_PendingDispatches.fetch_add(1);
+        m_Metrics.AddDispatchQueued();
+
+        // Keyed by this client, so clients sharing an executor run in parallel while each stays in order.
+        // The high bit keeps the key apart from the ClientIDs a Server on the same executor keys by.
+        const uint64_t key = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this)) | (uint64_t(1) << 63);
+        const auto queuedAt = std::chrono::steady_clock::now();
+        m_CallbackExecutor->PostOrdered(key, [this, queuedAt, work = std::move(work)]()
+            {
+                const auto callbackStart = std::chrono::steady_clock::now();
+                m_Metrics.AddDispatchStarted(callbackStart - queuedAt);
+                work();
+                m_Metrics.AddCallbackTime(std::chrono::steady_clock::now() - callbackStart);
+
+                // Under the lock, so the destructor cannot see the count reach zero while this still runs
+                std::lock_guard<std::mutex> lock(m_DispatchMutex);
+                if (m_PendingDispatches.fetch_sub(1) == 1)
+                    m_DispatchCondition.notify_all();
+            });
+    }
+
+    void Client::RunDispatchBatch(std::vector<MessageHandle>& messages)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_DataBatchReceivedCallback)
+        {
+            std::vector<Buffer> payloads;
+            payloads.reserve(messages.size());
+            for (const MessageHandle& message : messages)
+                payloads.push_back(message.GetBuffer());
+            m_DataBatchReceivedCallback(std::span<const Buffer>(payloads));
+        }
+        else if (m_MessageReceivedCallback)
+        {
+            for (MessageHandle& message : messages)
+                m_MessageReceivedCallback(std::move(message));
+        }
+        else if (m_DataReceivedCallback)
+        {
+            for (const MessageHandle& message : messages)
+                m_DataReceivedCallback(message.GetBuffer());
+        }
+    }
+
     void Client::OnFatalError(const std::string& message)
     {
         UT_ERROR_TAG("CLIENT", "Fatal Error: {}", message);
@@ -2,18 +2,42 @@
 
 #include "Utopia/Core/Buffer.hpp"
 
+#include "Compression.hpp"
+#include "DnsResolver.hpp"
+#include "Executor.hpp"
+#include "FlowControl.hpp"
+#include "MessageHandle.hpp"
+#include "MessageProtocol.hpp"
+#include "MessagePool.hpp"
+#include "MpscQueue.hpp"
+#include "NetworkLanes.hpp"
+#include "NetworkConditions.hpp"
+#include "NetworkMetrics.hpp"
+#include "NetworkWaiter.hpp"
+#include "NetworkingRuntime.hpp"
+#include "SendFlags.hpp"
+#include "SessionResumption.hpp"
+#include "TickLoop.hpp"
+
 #include <steam/steamnetworkingsockets.h>
 #include <steam/isteamnetworkingutils.h>
 #ifndef STEAMNETWORKINGSOCKETS_OPENSOURCE
 #include <steam/steam_api.h>
 #endif
 
+#include <chrono>
+#include <condition_variable>
 #include <string>
 #include <map>
+#include <memory>
+#include <span>
+#include <vector>
 #include <thread>
 #include <functional>
 #include <atomic>
 #include <mutex>
+#include <optional>
+#include <random>
 
 // Forward-declare this struct so we don't need the full header here.
 struct SteamNetConnectionStatusChangedCallback_t;
@@ -28,13 +52,26 @@ namespace Utopia {
             Disconnected = 0,
             Connected,
             Connecting,
-            FailedToConnect
+            FailedToConnect,
+            // An established connection dropped and is being re-established, see SetReconnectConfig()
+            Reconnecting
         };
 
     public:
+        static constexpr std::chrono::milliseconds k_LaneStatsInterval{ 100 };
+        // Head start each connection attempt gets before the next resolved address joins the race (RFC 8305)
+        static constexpr std::chrono::milliseconds k_ConnectAttemptDelay{ 250 };
+
         using DataReceivedCallback = std::function<void(const Buffer)>;
+        // Payloads point into library memory and are only valid during the callback
+        using DataBatchReceivedCallback = std::function<void(std::span<const Buffer>)>;
+        // Ownership of the message moves into the callback; keep the handle to defer processing without a copy
+        using MessageReceivedCallback = std::function<void(MessageHandle)>;
         using ServerConnectedCallback = std::function<void()>;
         using ServerDisconnectedCallback = std::function<void()>;
+        using WritableCallback = std::function<void()>;
+        using ConnectionInterruptedCallback = std::function<void()>;
+        using SessionResumedCallback = std::function<void()>;
 
     public:
         Client() = default;
@@ -49,46 +86,219 @@ namespace Utopia {
         Client(Client&&) = delete;
         Client& operator=(Client&&) = delete;
 
+        // serverAddress is "ip:port", "[ipv6]:port" or "host:port". Host names are resolved through DnsResolver
+        // without blocking the network thread, and every resolved address is tried Happy Eyeballs style.
+        // Does nothing while IsRunning(). Called from a callback on the network thread, the connection
+        // starts once the previous one is fully down.
         void ConnectToServer(const std::string& serverAddress);
+        // Safe from callbacks, which return before the network thread stops
         void Disconnect();
 
+        // Selects how the network thread idles between polls. Takes effect on the next ConnectToServer().
+        void SetNetworkThreadConfig(const NetworkThreadConfig& config) { m_NetworkThreadConfig = config; }
+        const NetworkThreadConfig& GetNetworkThreadConfig() const { return m_NetworkThreadConfig; }
+
+        // Watermarks for TrySendBuffer and the congested unreliable policy. Takes effect on the next ConnectToServer().
+        void SetFlowControlConfig(const FlowControlConfig& config) { m_FlowControlConfig = config; }
+        const FlowControlConfig& GetFlowControlConfig() const { return m_FlowControlConfig; }
+
+        // Payload compression; must match the server's codec. Takes effect on the next ConnectToServer().
+        void SetCompressionConfig(const CompressionConfig& config) { m_PendingCompressionConfig = config; }
+        const CompressionConfig& GetCompressionConfig() const { return m_PendingCompressionConfig; }
+
+        // Lanes configured on the connection to the server. Takes effect on the next ConnectToServer().
+        void SetLaneConfig(const LaneConfig& config) { m_LaneConfig = config; }
+        const LaneConfig& GetLaneConfig() const { return m_LaneConfig; }
+
+        // Simulated loss, latency and rate limits, applied when the network thread starts on the next ConnectToServer()
+        // or right away while running. Conditions are process-wide, see NetworkConditions.
+        void SetNetworkConditions(const NetworkConditionProfile& profile, ConditionDirection direction = ConditionDirection::Send);
+        // Only resets the process-wide conditions if this instance's profile is still the active one
+        void ClearNetworkConditions();
+
+        // Queue time per lane, sampled every k_LaneStatsInterval
+        std::vector<LaneStats> GetLaneStats() const { return m_LaneStats.GetStats(); }
+
+        // Counters and connection telemetry, readable from any thread. Export with GetMetrics().ExportPrometheus().
+        const MetricsRegistry& GetMetrics() const { return m_Metrics; }
+        // How often the connection's real-time status is sampled; zero disables sampling. Takes effect on the next ConnectToServer().
+        void SetTelemetryInterval(std::chrono::milliseconds interval) { m_TelemetryInterval = interval; }
+
+        // Reconnects on its own when the connection drops, and resumes the session on the server so the game
+        // state there survives. Requires SessionConfig on the server. Takes effect on the next ConnectToServer().
+        void SetReconnectConfig(const ReconnectConfig& config) { m_ReconnectConfig = config; }
+        const ReconnectConfig& GetReconnectConfig() const { return m_ReconnectConfig; }
+
+        // Maximum number of messages drained from the library per receive call. Takes effect on the next ConnectToServer().
+        void SetReceiveBatchSize(int maxMessages) { m_ReceiveBatchSize = maxMessages > 0 ? maxMessages : 1; }
+        int GetReceiveBatchSize() const { return m_ReceiveBatchSize; }
+
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         // Set callbacks for server events
-        // These callbacks will be called from the network thread
+        // These callbacks will be called from the network thread, unless a callback executor is set
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         void SetDataReceivedCallback(const DataReceivedCallback& function);
+        // Takes precedence over the per-message DataReceivedCallback when set
+        void SetDataBatchReceivedCallback(const DataBatchReceivedCallback& function);
+        // Takes precedence over DataReceivedCallback, but not over DataBatchReceivedCallback
+        void SetMessageReceivedCallback(const MessageReceivedCallback& function);
         void SetServerConnectedCallback(const ServerConnectedCallback& function);
+        // Called once the connection is gone for any reason: closed by either side, lost, or never established
         void SetServerDisconnectedCallback(const ServerDisconnectedCallback& function);
+        // Called when a congested connection falls back under the low watermark
+        void SetWritableCallback(const WritableCallback& function);
+        // Called when an established connection drops and reconnection starts. Sends are held meanwhile;
+        // reliable ones are delivered once the session resumes, unreliable ones are dropped.
+        void SetConnectionInterruptedCallback(const ConnectionInterruptedCallback& function);
+        // Called instead of the connected callback when a reconnect resumed the old session. Whatever the
+        // server sent while the connection was down is lost, so resync server state from here. If the server
+        // no longer had the session, the connected callback fires again as for a new connection, and the
+        // sends held for the old session are dropped.
+        void SetSessionResumedCallback(const SessionResumedCallback& function);
+
+        // Where the callbacks run. The default InlineExecutor calls them on the network thread; any other
+        // executor takes them off it, still in order and under the callback lock, so a slow handler no longer
+        // holds up receiving and sending. Clients sharing a ThreadPoolExecutor run their callbacks in parallel.
+        // The executor must outlive the client, whose destructor waits for callbacks still queued; with a
+        // ManualExecutor, run it after Disconnect() until HasPendingCallbacks() turns false.
+        // Ignored in tick mode. Takes effect on the next ConnectToServer().
+        void SetCallbackExecutor(Executor& executor) { m_CallbackExecutor = &executor; }
+        bool HasPendingCallbacks() const { return m_PendingDispatches.load() > 0; }
 
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         // Send Data
+        // Safe to call from any thread. Sends are queued without locks and flushed by the network
+        // thread in one SendMessages call per loop iteration.
+        // lane indexes the LaneConfig; reliable messages are only ordered relative to their own lane.
+        // Messages sent without SendFlags::NoNagle wait briefly to be batched; EndFrame() sends them right away.
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        void SendBuffer(Buffer buffer, bool reliable = true);
-        void SendString(const std::string& string, bool reliable = true);
+        void SendBuffer(Buffer buffer, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+        void SendString(const std::string& string, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+
+        // Sends a pooled message the caller serialized into directly; no copy is made
+        void SendOutgoingMessage(OutgoingMessage message, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+
+        // Like SendBuffer, but refuses with WouldBlock while the connection is over its high watermark.
+        // Wait for the writable callback before trying again.
+        SendStatus TrySendBuffer(Buffer buffer, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+        bool IsCongested() const { return m_Congested.load(); }
+
+        template<typename T>
+        SendStatus TrySendData(const T& data, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            return TrySendBuffer(Buffer(&data, sizeof(T)), flags, lane);
+        }
 
         template<typename T>
-        void SendData(const T& data, bool reliable = true)
+        void SendData(const T& data, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
         {
-            SendBuffer(Buffer(&data, sizeof(T)), reliable);
+            SendBuffer(Buffer(&data, sizeof(T)), flags, lane);
         }
 
+        // Typed messages carry a MessageHeader; dispatch them on the receiving side with MessageProtocol
+        template<NetworkMessage T>
+        void SendMessageToServer(const T& message, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            SendOutgoingMessage(EncodeMessage(message), flags, lane);
+        }
+
+        // Call at the end of a simulation step. Everything sent before this call goes out together on the
+        // network thread's next iteration instead of waiting out Nagle's delay.
+        void EndFrame();
+
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Tick mode
+        // Instead of the data, connected and disconnected callbacks firing on the network thread under the
+        // callback lock, received messages and connection events are queued for the game thread, which
+        // takes them once per tick with BeginTick() and ends the tick with EndTick().
+        ////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Takes effect on the next ConnectToServer()
+        void SetTickMode(bool enabled) { m_TickMode = enabled; }
+        bool IsTickMode() const { return m_TickMode; }
+
+        // Game thread. Every event since the previous BeginTick(), in arrival order.
+        std::span<TickEvent> BeginTick() { return m_TickInbox.Swap(); }
+        // Game thread. Sends everything queued during the tick together, see EndFrame().
+        void EndTick() { EndFrame(); }
+
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
         // Connection Status & Debugging
         ////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        bool IsRunning() const { return m_Running.load(); }
+        // True from ConnectToServer() until the connection fails or is closed
+        bool IsRunning() const { return m_Running.load() || m_RestartRequested.load(); }
         ConnectionStatus GetConnectionStatus() const { return m_ConnectionStatus.load(); }
         const std::string& GetConnectionDebugMessage() const { return m_ConnectionDebugMessage; }
 
     private:
         void NetworkThreadFunc();
+        // Network thread only. One ConnectToServer(), from setup to teardown.
+        void RunConnection();
+        // Requires m_ConnectMutex. Per-connection setup, ending in the running state.
+        void PrepareConnect(const std::string& serverAddress);
         void Shutdown();
 
-        static void ConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* info);
+        void ReleaseRuntime();
+
         void OnConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* info);
 
-        void PollIncomingMessages();
-        void PollConnectionStateChanges();
+        // Network thread only. Starts a connection to the next candidate address; false when none is left.
+        bool StartConnectAttempt();
+        // Network thread only. Picks up the resolved addresses and staggers further attempts. Returns true if it did work.
+        bool UpdateConnectAttempts();
+        void CloseConnectAttempts();
+        void FailConnect(const std::string& message);
+
+        // Returns the number of messages dispatched
+        int PollIncomingMessages();
+        // Returns the number of status changes handled
+        int PollConnectionStateChanges();
+
+        // Network thread only. Returns the number of queued sends flushed.
+        int FlushSendQueue();
+        // Network thread only, with reconnection enabled and no live session. Moves queued reliable sends into
+        // the replay buffer and drops unreliable ones. Returns the number taken off the queue.
+        int HoldSendQueue();
+        void QueueMessage(OutgoingMessage message, SendFlags flags, uint16_t lane);
+        // Frames payload for the wire, compressing it if configured
+        OutgoingMessage EncodeOutgoingPayload(Buffer payload, uint16_t lane);
+        // Network thread only. Strips the compression header of message i in the current receive batch.
+        bool DecodeIncomingPayload(int index, Buffer& outPayload);
+        // Pushes out messages still held back by Nagle's delay
+        void FlushEndOfFrame();
+        void ReleaseQueuedSends();
+        // Lane stats and telemetry, each on its own interval
+        void SampleConnection();
+
+        // Network thread only. Applies the congested unreliable policy; returns true if the message was dropped or held back.
+        bool DivertCongestedSend(SteamNetworkingMessage_t* message);
+        void UpdateCongestion(const SteamNetConnectionRealTimeStatus_t& status);
+        void DispatchWritable();
 
+        // Hands out message i of the current receive batch, copying it when its payload was decoded
+        SteamNetworkingMessage_t* TakeReceivedMessage(int index, const Buffer& payload);
+        // Runs the disconnected callback once the network thread is done, whether or not it ever connected
+        void NotifyDisconnected();
+        // Network thread only. Queues the tick event of the given type, or runs callback like the other callbacks.
+        void NotifyConnectionEvent(TickEventType type, std::function<void()> Client::* callback);
+
+        // Network thread only. Session handshake and reconnection, see SetReconnectConfig().
+        void SendSessionHello();
+        // Fails the connection if the hello has gone unanswered for GrantTimeout
+        void CheckSessionGrant();
+        // Returns true if payload was a session message, which is consumed here
+        bool HandleSessionMessage(Buffer payload);
+        void OnSessionGranted(const SessionToken& token, bool resumed, std::span<const uint64_t> laneCounts);
+        // Requires m_ReplayMutex. Sends everything in the replay buffer, which stays there until acknowledged.
+        void SendReplay();
+        bool ShouldReconnect(const SteamNetConnectionInfo_t& info) const;
+        void BeginReconnect(const SteamNetConnectionInfo_t& info);
+        void ScheduleReconnect();
+        // Requires m_ReplayMutex. Keeps a reliable message that went out, or was meant to, until the server has it.
+        void RecordReplay(uint16_t lane, int flags, std::vector<std::byte> payload);
+        // Network thread only. Runs work on the callback executor in order with the other callbacks.
+        void Dispatch(Executor::Work work);
+        void RunDispatchBatch(std::vector<MessageHandle>& messages);
+        void ApplyNetworkConditions();
         void OnFatalError(const std::string& message);
 
     private:
@@ -96,20 +306,131 @@ namespace Utopia {
 
         // Callbacks
         DataReceivedCallback       m_DataReceivedCallback;
+        DataBatchReceivedCallback  m_DataBatchReceivedCallback;
+        MessageReceivedCallback    m_MessageReceivedCallback;
         ServerConnectedCallback    m_ServerConnectedCallback;
         ServerDisconnectedCallback m_ServerDisconnectedCallback;
+        WritableCallback           m_WritableCallback;
+        ConnectionInterruptedCallback m_ConnectionInterruptedCallback;
+        SessionResumedCallback     m_SessionResumedCallback;
+
+        Executor* m_CallbackExecutor = &InlineExecutor::Get();
+        // Set by ConnectToServer() when callbacks go through m_CallbackExecutor rather than being called inline
+        bool m_Dispatching = false;
+        std::atomic<size_t> m_PendingDispatches{ 0 };
+        std::mutex m_DispatchMutex;
+        std::condition_variable m_DispatchCondition;
 
         std::atomic<ConnectionStatus> m_ConnectionStatus{ ConnectionStatus::Disconnected };
         std::string m_ConnectionDebugMessage;
 
         std::string m_ServerAddress;
+        uint16_t m_ServerPort = 0;
+
+        // Network thread only. Candidate addresses in the order they are tried, and the attempts still
+        // racing. Once one connects it becomes m_Connection and the rest are closed.
+        std::shared_ptr<const DnsQuery> m_DnsQuery;
+        std::vector<SteamNetworkingIPAddr> m_ConnectAddresses;
+        size_t m_NextConnectAddress = 0;
+        std::vector<HSteamNetConnection> m_ConnectAttempts;
+        std::chrono::steady_clock::time_point m_NextConnectAttempt;
+        // Follows the family of the last successful connection, so reconnects try it first
+        bool m_PreferIPv6 = true;
         std::atomic_bool m_Running{ false };
 
+        // Guards starting and stopping. A ConnectToServer() from a callback on the network thread leaves its
+        // address here, and one from elsewhere sets m_JoinPending while it waits for the previous thread.
+        std::mutex m_ConnectMutex;
+        std::string m_RestartAddress;
+        std::atomic_bool m_RestartRequested{ false };
+        bool m_JoinPending = false;
+
+        NetworkThreadConfig m_NetworkThreadConfig;
+        NetworkWaiter m_NetworkWaiter;
+
+        std::optional<NetworkConditionProfile> m_NetworkConditions;
+        ConditionDirection m_NetworkConditionDirection = ConditionDirection::Send;
+        std::mutex m_NetworkConditionsMutex;
+        // Set once the network thread has applied them; later changes are applied immediately
+        bool m_NetworkConditionsStarted = false;
+
+        LaneConfig m_LaneConfig;
+        LaneStatsCollector m_LaneStats;
+        std::chrono::steady_clock::time_point m_LastLaneSample;
+
+        FlowControlConfig m_FlowControlConfig;
+        std::atomic_bool m_Congested{ false };
+        std::atomic_bool m_WritablePending{ false };
+        std::chrono::steady_clock::time_point m_LastFlowControlCheck;
+        // Newest unreliable message per lane, held while congested
+        std::map<uint16_t, SteamNetworkingMessage_t*> m_CoalescedSends;
+
+        MetricsRegistry m_Metrics;
+        std::chrono::milliseconds m_TelemetryInterval{ 1000 };
+        std::chrono::steady_clock::time_point m_LastTelemetrySample;
+
+        // Reused every poll so the receive path does not allocate
+        int m_ReceiveBatchSize = 64;
+        std::vector<ISteamNetworkingMessage*> m_ReceiveBuffer;
+        std::vector<Buffer> m_ReceivedBatch;
+        std::vector<std::vector<std::byte>> m_DecompressBuffers;
+
+        // What SetCompressionConfig() asked for, and the copy taken at start that the running instance uses.
+        // The codec must not change under the network threads, and the decompress buffers are sized for it.
+        CompressionConfig m_PendingCompressionConfig;
+        CompressionConfig m_CompressionConfig;
+
+        ReconnectConfig m_ReconnectConfig;
+        // Network thread only. Set from the first drop until the session is back or reconnecting gives up.
+        bool m_Reconnecting = false;
+        uint32_t m_ReconnectAttempt = 0;
+        std::chrono::steady_clock::time_point m_NextReconnectAttempt;
+        std::chrono::steady_clock::time_point m_ReconnectDeadline;
+        std::mt19937 m_ReconnectRandom{ std::random_device{}() };
+        // From the hello on a new connection until the server's grant
+        bool m_AwaitingGrant = false;
+        std::chrono::steady_clock::time_point m_GrantDeadline;
+
+        // Sends racing with a drop may come from the thread that found the send queue full, hence the lock
+        std::mutex m_ReplayMutex;
+        ReplayBuffer m_Replay;
+        SessionToken m_SessionToken;
+        // Between the server's grant and the next drop; sends are held in m_Replay otherwise
+        bool m_SessionLive = false;
+        // The replay buffer outgrew MaxReplayBytes, so the session can no longer be resumed faithfully
+        bool m_ReplayOverflowed = false;
+        // The reliable messages in m_SendBatch, copied before the library owns them
+        struct StagedReplay
+        {
+            bool Reliable = false;
+            uint16_t Lane = 0;
+            int Flags = 0;
+            std::vector<std::byte> Payload;
+        };
+        std::vector<StagedReplay> m_SendBatchReplays;
+
+        bool m_TickMode = false;
+        TickInbox m_TickInbox;
+        // Staged per receive batch, so the inbox is locked once per batch
+        std::vector<TickEvent> m_TickEvents;
+
+        // Outgoing messages are addressed to m_Connection when drained
+        static constexpr size_t k_SendQueueCapacity = 4096;
+        MpscQueue<SteamNetworkingMessage_t*> m_SendQueue{ k_SendQueueCapacity };
+        std::vector<SteamNetworkingMessage_t*> m_SendBatch;
+        std::vector<int64> m_SendBatchResults;
+        std::vector<int> m_SendBatchSizes;
+        std::atomic_bool m_EndFrameRequested{ false };
+        // Network thread only. Set when messages went out without NoNagle since the last end-of-frame flush.
+        bool m_HasNagledSends = false;
+
+        NetworkingRuntime* m_Runtime = nullptr;
+        NetworkingRuntime::ListenerID m_StatusListener = NetworkingRuntime::k_InvalidListener;
+        ConnectionStatusInbox m_StatusInbox;
+
         ISteamNetworkingSockets* m_Interface = nullptr;
         HSteamNetConnection m_Connection = k_HSteamNetConnection_Invalid;
 
-        // For the "one instance" approach
-        static Client* s_Instance;
         mutable std::mutex m_Mutex;
     };
 
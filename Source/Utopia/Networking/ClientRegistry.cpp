@@ -0,0 +1,89 @@
+#include "ClientRegistry.hpp"
+
+#include <cstring>
+
+namespace Utopia {
+
+    ClientRegistry::ClientRegistry()
+    {
+        PublishSnapshot();
+    }
+
+    ClientInfo& ClientRegistry::Add(ClientID clientID, const char* connectionDesc)
+    {
+        uint32_t slot;
+        if (!m_FreeSlots.empty())
+        {
+            slot = m_FreeSlots.back();
+            m_FreeSlots.pop_back();
+        }
+        else
+        {
+            slot = static_cast<uint32_t>(m_SlotToIndex.size());
+            m_SlotToIndex.push_back(k_InvalidSlot);
+        }
+
+        m_SlotToIndex[slot] = static_cast<uint32_t>(m_Clients.size());
+
+        ClientInfo& client = m_Clients.emplace_back();
+        client.ID = clientID;
+        client.Slot = slot;
+        std::strncpy(client.ConnectionDesc, connectionDesc ? connectionDesc : "", sizeof(client.ConnectionDesc) - 1);
+        client.ConnectionDesc[sizeof(client.ConnectionDesc) - 1] = '\0';
+
+        PublishSnapshot();
+        return client;
+    }
+
+    bool ClientRegistry::Remove(uint32_t slot)
+    {
+        if (slot >= m_SlotToIndex.size() || m_SlotToIndex[slot] == k_InvalidSlot)
+            return false;
+
+        // Swap the last client into the hole to keep storage dense
+        const uint32_t index = m_SlotToIndex[slot];
+        const uint32_t lastIndex = static_cast<uint32_t>(m_Clients.size() - 1);
+        if (index != lastIndex)
+        {
+            m_Clients[index] = m_Clients[lastIndex];
+            m_SlotToIndex[m_Clients[index].Slot] = index;
+        }
+        m_Clients.pop_back();
+
+        m_SlotToIndex[slot] = k_InvalidSlot;
+        m_FreeSlots.push_back(slot);
+
+        PublishSnapshot();
+        return true;
+    }
+
+    void ClientRegistry::Clear()
+    {
+        m_Clients.clear();
+        m_SlotToIndex.clear();
+        m_FreeSlots.clear();
+        PublishSnapshot();
+    }
+
+    ClientInfo* ClientRegistry::Get(uint32_t slot)
+    {
+        if (slot >= m_SlotToIndex.size())
+            return nullptr;
+
+        const uint32_t index = m_SlotToIndex[slot];
+        return index != k_InvalidSlot ? &m_Clients[index] : nullptr;
+    }
+
+    ClientInfo* ClientRegistry::Find(uint32_t slot, ClientID clientID)
+    {
+        // Slots are recycled, so a slot alone may name a newer connection
+        ClientInfo* client = Get(slot);
+        return client && client->ID == clientID ? client : nullptr;
+    }
+
+    void ClientRegistry::PublishSnapshot()
+    {
+        m_Snapshot.store(std::make_shared<const std::vector<ClientInfo>>(m_Clients), std::memory_order_release);
+    }
+
+} // namespace Utopia
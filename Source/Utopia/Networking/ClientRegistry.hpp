@@ -0,0 +1,67 @@
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Utopia {
+
+    using ClientID = HSteamNetConnection;
+
+    struct ClientInfo
+    {
+        ClientID ID;
+
+        // Stable index into the server's client registry, also stored as the connection's user data
+        uint32_t Slot;
+
+        char ConnectionDesc[k_cchSteamNetworkingMaxConnectionDescription];
+    };
+
+    // Slot map of connected clients. Live clients are packed densely for iteration, while each
+    // client keeps a small stable slot index for O(1) lookup. Owned by the network thread;
+    // other threads read the immutable snapshot published on every change.
+    class ClientRegistry
+    {
+    public:
+        using Snapshot = std::shared_ptr<const std::vector<ClientInfo>>;
+
+        static constexpr uint32_t k_InvalidSlot = std::numeric_limits<uint32_t>::max();
+
+        ClientRegistry();
+
+        ClientRegistry(const ClientRegistry&) = delete;
+        ClientRegistry& operator=(const ClientRegistry&) = delete;
+
+        // Network thread only. The returned reference is invalidated by the next Add or Remove.
+        ClientInfo& Add(ClientID clientID, const char* connectionDesc);
+        bool Remove(uint32_t slot);
+        void Clear();
+
+        // Network thread only. Returns nullptr for unknown or recycled slots.
+        ClientInfo* Get(uint32_t slot);
+        ClientInfo* Find(uint32_t slot, ClientID clientID);
+
+        std::span<const ClientInfo> GetClients() const { return m_Clients; }
+        size_t GetCount() const { return m_Clients.size(); }
+
+        // Safe from any thread
+        Snapshot GetSnapshot() const { return m_Snapshot.load(std::memory_order_acquire); }
+
+    private:
+        void PublishSnapshot();
+
+    private:
+        std::vector<ClientInfo> m_Clients;
+        std::vector<uint32_t> m_SlotToIndex;
+        std::vector<uint32_t> m_FreeSlots;
+
+        std::atomic<Snapshot> m_Snapshot;
+    };
+
+} // namespace Utopia
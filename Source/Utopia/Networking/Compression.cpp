@@ -0,0 +1,342 @@
+#include "Compression.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace Utopia {
+
+    namespace {
+
+        constexpr uint32_t k_MinMatch = 4;
+        constexpr uint32_t k_MaxOffset = 0xFFFF;
+        constexpr uint32_t k_HashBits = 12;
+        // The tail is always emitted as literals, so the match finder can read 4 bytes without checks
+        constexpr uint32_t k_LastLiterals = 5;
+
+        uint32_t Read32(const uint8_t* p)
+        {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t Hash(uint32_t value)
+        {
+            return (value * 2654435761u) >> (32 - k_HashBits);
+        }
+
+        // Writes the remainder of a length whose 4 bit field in the token is saturated
+        bool WriteLength(uint8_t*& op, const uint8_t* oend, uint32_t length)
+        {
+            while (length >= 255)
+            {
+                if (op >= oend)
+                    return false;
+                *op++ = 255;
+                length -= 255;
+            }
+
+            if (op >= oend)
+                return false;
+            *op++ = static_cast<uint8_t>(length);
+            return true;
+        }
+
+        bool ReadLength(const uint8_t*& ip, const uint8_t* iend, uint32_t& length, uint32_t limit)
+        {
+            uint8_t byte;
+            do
+            {
+                if (ip >= iend)
+                    return false;
+                byte = *ip++;
+                length += byte;
+                if (length > limit)
+                    return false;
+            } while (byte == 255);
+            return true;
+        }
+
+        // One sequence: token, literal length, literals, and unless this is the last one, offset and match length
+        bool WriteSequence(uint8_t*& op, const uint8_t* oend, const uint8_t* literals, uint32_t literalLength, uint32_t offset, uint32_t matchLength, bool last)
+        {
+            if (op >= oend)
+                return false;
+
+            uint8_t* token = op++;
+            *token = static_cast<uint8_t>(std::min<uint32_t>(literalLength, 15) << 4);
+            if (literalLength >= 15 && !WriteLength(op, oend, literalLength - 15))
+                return false;
+
+            if (static_cast<size_t>(oend - op) < literalLength)
+                return false;
+            if (literalLength > 0)
+                std::memcpy(op, literals, literalLength);
+            op += literalLength;
+
+            if (last)
+                return true;
+
+            if (oend - op < 2)
+                return false;
+            *op++ = static_cast<uint8_t>(offset & 0xFF);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+
+            const uint32_t matchCode = matchLength - k_MinMatch;
+            *token |= static_cast<uint8_t>(std::min<uint32_t>(matchCode, 15));
+            if (matchCode >= 15 && !WriteLength(op, oend, matchCode - 15))
+                return false;
+
+            return true;
+        }
+
+    } // anonymous namespace
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // LZCodec
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    uint32_t LZCodec::GetMaxCompressedSize(uint32_t size) const
+    {
+        // Incompressible input costs one length byte per 255 literals plus the token
+        return size + size / 255 + 16;
+    }
+
+    uint32_t LZCodec::Compress(const void* src, uint32_t srcSize, void* dst, uint32_t dstCapacity) const
+    {
+        const uint8_t* const base = static_cast<const uint8_t*>(src);
+        const uint8_t* const iend = base + srcSize;
+        uint8_t* op = static_cast<uint8_t*>(dst);
+        const uint8_t* const oend = op + dstCapacity;
+
+        const uint8_t* ip = base;
+        const uint8_t* anchor = base;
+
+        if (srcSize > k_MinMatch + k_LastLiterals)
+        {
+            // Positions of recently seen 4 byte sequences, relative to base
+            std::array<uint32_t, 1u << k_HashBits> table{};
+            const uint8_t* const matchLimit = iend - k_LastLiterals;
+
+            // Position 0 is the table's initial value, so start one past it
+            ip++;
+            while (ip + k_MinMatch <= matchLimit)
+            {
+                const uint32_t sequence = Read32(ip);
+                const uint32_t hash = Hash(sequence);
+                const uint8_t* match = base + table[hash];
+                table[hash] = static_cast<uint32_t>(ip - base);
+
+                if (match >= ip || static_cast<uint32_t>(ip - match) > k_MaxOffset || Read32(match) != sequence)
+                {
+                    ip++;
+                    continue;
+                }
+
+                uint32_t matchLength = k_MinMatch;
+                while (ip + matchLength < matchLimit && match[matchLength] == ip[matchLength])
+                    matchLength++;
+
+                if (!WriteSequence(op, oend, anchor, static_cast<uint32_t>(ip - anchor), static_cast<uint32_t>(ip - match), matchLength, false))
+                    return 0;
+
+                ip += matchLength;
+                anchor = ip;
+            }
+        }
+
+        if (!WriteSequence(op, oend, anchor, static_cast<uint32_t>(iend - anchor), 0, 0, true))
+            return 0;
+
+        return static_cast<uint32_t>(op - static_cast<uint8_t*>(dst));
+    }
+
+    bool LZCodec::Decompress(const void* src, uint32_t srcSize, void* dst, uint32_t dstSize) const
+    {
+        const uint8_t* ip = static_cast<const uint8_t*>(src);
+        const uint8_t* const iend = ip + srcSize;
+        uint8_t* const obase = static_cast<uint8_t*>(dst);
+        uint8_t* op = obase;
+        uint8_t* const oend = op + dstSize;
+
+        while (ip < iend)
+        {
+            const uint8_t token = *ip++;
+
+            uint32_t literalLength = token >> 4;
+            if (literalLength == 15 && !ReadLength(ip, iend, literalLength, dstSize))
+                return false;
+
+            if (static_cast<size_t>(iend - ip) < literalLength || static_cast<size_t>(oend - op) < literalLength)
+                return false;
+            if (literalLength > 0)
+                std::memcpy(op, ip, literalLength);
+            ip += literalLength;
+            op += literalLength;
+
+            // The last sequence has no match
+            if (ip == iend)
+                break;
+
+            if (iend - ip < 2)
+                return false;
+            const uint32_t offset = static_cast<uint32_t>(ip[0]) | (static_cast<uint32_t>(ip[1]) << 8);
+            ip += 2;
+            if (offset == 0 || offset > static_cast<uint32_t>(op - obase))
+                return false;
+
+            uint32_t matchLength = token & 15;
+            if (matchLength == 15 && !ReadLength(ip, iend, matchLength, dstSize))
+                return false;
+            matchLength += k_MinMatch;
+
+            if (static_cast<size_t>(oend - op) < matchLength)
+                return false;
+
+            // Matches may overlap their own output, so copy forward byte by byte
+            const uint8_t* match = op - offset;
+            for (uint32_t i = 0; i < matchLength; i++)
+                op[i] = match[i];
+            op += matchLength;
+        }
+
+        return op == oend;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // CompressionConfig
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    bool CompressionConfig::ShouldCompress(uint16_t lane, uint64_t size) const
+    {
+        if (!Codec || size < MinSize)
+            return false;
+
+        return Lanes.empty() || std::find(Lanes.begin(), Lanes.end(), lane) != Lanes.end();
+    }
+
+    CompressionConfig CompressionConfig::LZ(uint32_t minSize)
+    {
+        CompressionConfig config;
+        config.Codec = std::make_shared<LZCodec>();
+        config.MinSize = minSize;
+        return config;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Framing
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    OutgoingMessage EncodePayload(const CompressionConfig& config, Buffer payload, uint16_t lane, CompressionResult& outResult)
+    {
+        const uint32_t size = static_cast<uint32_t>(payload.Size);
+        outResult = {};
+        outResult.UncompressedSize = size;
+
+        if (config.ShouldCompress(lane, size))
+        {
+            const uint32_t capacity = CompressionHeader::k_CompressedSize + config.Codec->GetMaxCompressedSize(size);
+            OutgoingMessage message(capacity);
+            if (!message)
+                return message;
+
+            uint8_t* data = static_cast<uint8_t*>(message.GetData());
+            const uint32_t compressedSize = config.Codec->Compress(payload.Data, size, data + CompressionHeader::k_CompressedSize, capacity - CompressionHeader::k_CompressedSize);
+
+            // Only worth it if the header is paid for
+            if (compressedSize > 0 && compressedSize + CompressionHeader::k_CompressedSize < size + CompressionHeader::k_UncompressedSize)
+            {
+                data[0] = config.Codec->GetID();
+                data[1] = static_cast<uint8_t>(size);
+                data[2] = static_cast<uint8_t>(size >> 8);
+                data[3] = static_cast<uint8_t>(size >> 16);
+                data[4] = static_cast<uint8_t>(size >> 24);
+                message.SetSize(CompressionHeader::k_CompressedSize + compressedSize);
+
+                outResult.Compressed = true;
+                outResult.CompressedSize = compressedSize;
+                return message;
+            }
+
+            // Incompressible; the slab is large enough to hold the raw payload instead
+            data[0] = CompressionHeader::k_Uncompressed;
+            if (size > 0)
+                std::memcpy(data + CompressionHeader::k_UncompressedSize, payload.Data, size);
+            message.SetSize(CompressionHeader::k_UncompressedSize + size);
+            return message;
+        }
+
+        OutgoingMessage message(CompressionHeader::k_UncompressedSize + size);
+        if (!message)
+            return message;
+
+        uint8_t* data = static_cast<uint8_t*>(message.GetData());
+        data[0] = CompressionHeader::k_Uncompressed;
+        if (size > 0)
+            std::memcpy(data + CompressionHeader::k_UncompressedSize, payload.Data, size);
+        return message;
+    }
+
+    DecodeStatus DecodePayload(const CompressionConfig& config, Buffer payload, std::vector<std::byte>& scratch, Buffer& outPayload, CompressionResult& outResult)
+    {
+        outResult = {};
+        if (!payload.Data || payload.Size < CompressionHeader::k_UncompressedSize)
+            return DecodeStatus::Malformed;
+
+        const uint8_t* data = static_cast<const uint8_t*>(payload.Data);
+        if (data[0] == CompressionHeader::k_Uncompressed)
+        {
+            outPayload = Buffer(data + CompressionHeader::k_UncompressedSize, payload.Size - CompressionHeader::k_UncompressedSize);
+            outResult.UncompressedSize = static_cast<uint32_t>(outPayload.Size);
+            return DecodeStatus::Ok;
+        }
+
+        if (!config.Codec || data[0] != config.Codec->GetID())
+            return DecodeStatus::UnknownCodec;
+
+        if (payload.Size < CompressionHeader::k_CompressedSize)
+            return DecodeStatus::Malformed;
+
+        const uint32_t size = static_cast<uint32_t>(data[1])
+            | (static_cast<uint32_t>(data[2]) << 8)
+            | (static_cast<uint32_t>(data[3]) << 16)
+            | (static_cast<uint32_t>(data[4]) << 24);
+
+        // Never trust the peer with more than the library would let it send
+        if (size > static_cast<uint32_t>(k_cbMaxSteamNetworkingSocketsMessageSizeSend))
+            return DecodeStatus::Malformed;
+
+        const uint32_t compressedSize = static_cast<uint32_t>(payload.Size) - CompressionHeader::k_CompressedSize;
+        scratch.resize(size);
+        if (!config.Codec->Decompress(data + CompressionHeader::k_CompressedSize, compressedSize, scratch.data(), size))
+            return DecodeStatus::Malformed;
+
+        outPayload = Buffer(scratch.data(), size);
+        outResult.Compressed = true;
+        outResult.UncompressedSize = size;
+        outResult.CompressedSize = compressedSize;
+        return DecodeStatus::Ok;
+    }
+
+    SteamNetworkingMessage_t* CopyReceivedMessage(const SteamNetworkingMessage_t& message, Buffer payload)
+    {
+        SteamNetworkingMessage_t* copy = MessagePool::Get().AllocateMessage(static_cast<uint32_t>(payload.Size));
+        if (!copy)
+            return nullptr;
+
+        if (payload.Size > 0)
+            std::memcpy(copy->m_pData, payload.Data, payload.Size);
+
+        copy->m_conn = message.m_conn;
+        copy->m_identityPeer = message.m_identityPeer;
+        copy->m_nConnUserData = message.m_nConnUserData;
+        copy->m_usecTimeReceived = message.m_usecTimeReceived;
+        copy->m_nMessageNumber = message.m_nMessageNumber;
+        copy->m_nChannel = message.m_nChannel;
+        copy->m_nFlags = message.m_nFlags;
+        copy->m_nUserData = message.m_nUserData;
+        copy->m_idxLane = message.m_idxLane;
+        return copy;
+    }
+
+} // namespace Utopia
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include "MessagePool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Utopia {
+
+    // A payload compressor. Implementations must be safe to call from several threads at once.
+    class CompressionCodec
+    {
+    public:
+        virtual ~CompressionCodec() = default;
+
+        // Written into the header of every message this codec compressed, so both ends must agree.
+        // 0 is reserved for uncompressed payloads.
+        virtual uint8_t GetID() const = 0;
+
+        // Upper bound of Compress() output for an input of `size` bytes
+        virtual uint32_t GetMaxCompressedSize(uint32_t size) const = 0;
+
+        // Returns the compressed size, or 0 if the output did not fit in dstCapacity
+        virtual uint32_t Compress(const void* src, uint32_t srcSize, void* dst, uint32_t dstCapacity) const = 0;
+
+        // dstSize is the exact uncompressed size. Returns false on malformed input.
+        virtual bool Decompress(const void* src, uint32_t srcSize, void* dst, uint32_t dstSize) const = 0;
+    };
+
+    // Built-in byte-oriented LZ77 codec in the spirit of LZ4: a single hash-table probe per
+    // position, no entropy coding, and a bounds-checked decoder. Fast rather than small.
+    class LZCodec final : public CompressionCodec
+    {
+    public:
+        static constexpr uint8_t k_ID = 1;
+
+        uint8_t GetID() const override { return k_ID; }
+        uint32_t GetMaxCompressedSize(uint32_t size) const override;
+        uint32_t Compress(const void* src, uint32_t srcSize, void* dst, uint32_t dstCapacity) const override;
+        bool Decompress(const void* src, uint32_t srcSize, void* dst, uint32_t dstSize) const override;
+    };
+
+    struct CompressionConfig
+    {
+        // nullptr turns compression off. When set, every message carries a small header, so the
+        // server and its clients must all enable compression or none of them.
+        std::shared_ptr<const CompressionCodec> Codec;
+
+        // Smaller payloads are sent as-is; they rarely shrink enough to be worth the CPU
+        uint32_t MinSize = 128;
+
+        // Lanes whose messages are compressed; empty compresses every lane
+        std::vector<uint16_t> Lanes;
+
+        bool IsEnabled() const { return Codec != nullptr; }
+        bool ShouldCompress(uint16_t lane, uint64_t size) const;
+
+        static CompressionConfig LZ(uint32_t minSize = 128);
+    };
+
+    // Header in front of every payload while compression is enabled: one codec byte, followed by the
+    // uncompressed size as a little-endian uint32 when the codec byte is not k_Uncompressed
+    struct CompressionHeader
+    {
+        static constexpr uint8_t k_Uncompressed = 0;
+        static constexpr uint32_t k_UncompressedSize = 1;
+        static constexpr uint32_t k_CompressedSize = 5;
+    };
+
+    struct CompressionResult
+    {
+        bool Compressed = false;
+        uint32_t UncompressedSize = 0;
+        uint32_t CompressedSize = 0;
+    };
+
+    // Frames payload for sending into a pooled message, compressing it if the config says so and it
+    // actually shrinks. Only call with compression enabled.
+    OutgoingMessage EncodePayload(const CompressionConfig& config, Buffer payload, uint16_t lane, CompressionResult& outResult);
+
+    enum class DecodeStatus
+    {
+        Ok = 0,
+        Malformed,
+        UnknownCodec
+    };
+
+    // Strips the header from a received payload. Uncompressed payloads are returned in place;
+    // compressed ones are expanded into scratch, which the result then points into.
+    DecodeStatus DecodePayload(const CompressionConfig& config, Buffer payload, std::vector<std::byte>& scratch, Buffer& outPayload, CompressionResult& outResult);
+
+    // A pooled copy of a received message that holds payload instead of the original bytes but keeps
+    // the sender, lane and timing, so a decoded message can still be handed out as a MessageHandle
+    [[nodiscard]] SteamNetworkingMessage_t* CopyReceivedMessage(const SteamNetworkingMessage_t& message, Buffer payload);
+
+} // namespace Utopia
@@ -0,0 +1,213 @@
+#include "DnsResolver.hpp"
+
+#include "NetworkingUtils.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace Utopia {
+
+    namespace {
+
+        DnsResolverConfig s_PendingConfig;
+        std::atomic_bool s_ResolverCreated{ false };
+
+        // Expired entries are otherwise only replaced when their host is looked up again
+        constexpr size_t k_CachePruneThreshold = 1024;
+
+    } // anonymous namespace
+
+    void DnsResolver::Configure(const DnsResolverConfig& config)
+    {
+        if (s_ResolverCreated.load())
+        {
+            UT_WARN_TAG("NETWORK", "DnsResolver::Configure called after the resolver was created; ignoring");
+            return;
+        }
+        s_PendingConfig = config;
+    }
+
+    DnsResolver& DnsResolver::Get()
+    {
+        static DnsResolver s_Resolver(s_PendingConfig);
+        return s_Resolver;
+    }
+
+    DnsResolver::DnsResolver(const DnsResolverConfig& config)
+        : m_Config(config)
+    {
+        s_ResolverCreated.store(true);
+
+        const uint32_t workerCount = std::max<uint32_t>(m_Config.WorkerCount, 1);
+        m_Workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; i++)
+            m_Workers.emplace_back([this]() { WorkerThreadFunc(); });
+    }
+
+    DnsResolver::~DnsResolver()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_Condition.notify_all();
+
+        // A worker stuck in a slow lookup holds up exit until the system resolver gives up
+        for (std::thread& worker : m_Workers)
+            worker.join();
+    }
+
+    std::shared_ptr<const DnsQuery> DnsResolver::ResolveAsync(std::string_view host)
+    {
+        std::string hostString(host);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        const auto it = m_Cache.find(hostString);
+        if (it != m_Cache.end())
+        {
+            const CacheEntry& entry = it->second;
+            // Still in flight, or ready and fresh
+            if (!entry.Query->IsReady() || std::chrono::steady_clock::now() < entry.Expiry)
+                return entry.Query;
+        }
+
+        if (m_Cache.size() >= k_CachePruneThreshold)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            std::erase_if(m_Cache, [now](const auto& entry) { return entry.second.Query->IsReady() && now >= entry.second.Expiry; });
+        }
+
+        auto query = std::make_shared<DnsQuery>();
+        query->m_Host = hostString;
+        m_Cache[std::move(hostString)] = CacheEntry{ query, {} };
+        m_Pending.push_back(query);
+        m_Condition.notify_one();
+        return query;
+    }
+
+    std::optional<DnsResult> DnsResolver::GetCached(std::string_view host)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        const auto it = m_Cache.find(std::string(host));
+        if (it == m_Cache.end() || !it->second.Query->IsReady() || std::chrono::steady_clock::now() >= it->second.Expiry)
+            return std::nullopt;
+
+        return it->second.Query->GetResult();
+    }
+
+    void DnsResolver::ClearCache()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        // Lookups in flight stay, so their waiters are still answered
+        std::erase_if(m_Cache, [](const auto& entry) { return entry.second.Query->IsReady(); });
+    }
+
+    void DnsResolver::WorkerThreadFunc()
+    {
+        while (true)
+        {
+            std::shared_ptr<DnsQuery> query;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]() { return m_Stopping || !m_Pending.empty(); });
+                if (m_Stopping)
+                    return;
+
+                query = std::move(m_Pending.front());
+                m_Pending.pop_front();
+            }
+
+            DnsResult& result = query->m_Result;
+            result.Success = Utils::ResolveHostAddresses(query->m_Host, result.Addresses, result.Error);
+            if (result.Success)
+                SortForHappyEyeballs(result.Addresses);
+            else
+                UT_WARN_TAG("NETWORK", "Could not resolve {}: {}", query->m_Host, result.Error);
+
+            Complete(query);
+        }
+    }
+
+    void DnsResolver::Complete(const std::shared_ptr<DnsQuery>& query)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        const std::chrono::seconds ttl = query->m_Result.Success ? m_Config.PositiveTTL : m_Config.NegativeTTL;
+
+        // ClearCache() may have dropped the entry in the meantime; then it is simply not cached
+        const auto it = m_Cache.find(query->m_Host);
+        if (it != m_Cache.end() && it->second.Query == query)
+            it->second.Expiry = std::chrono::steady_clock::now() + ttl;
+
+        query->m_Ready.store(true, std::memory_order_release);
+    }
+
+    bool DnsResolver::SplitHostPort(std::string_view address, std::string& outHost, uint16_t& outPort)
+    {
+        std::string_view host;
+        std::string_view port;
+        if (!address.empty() && address.front() == '[')
+        {
+            // [IPv6]:port
+            const size_t closing = address.find(']');
+            if (closing == std::string_view::npos || closing + 1 >= address.size() || address[closing + 1] != ':')
+                return false;
+
+            host = address.substr(1, closing - 1);
+            port = address.substr(closing + 2);
+        }
+        else
+        {
+            const size_t colon = address.rfind(':');
+            if (colon == std::string_view::npos)
+                return false;
+
+            host = address.substr(0, colon);
+            port = address.substr(colon + 1);
+
+            // A bare IPv6 address has more colons and no port we could tell apart
+            if (host.find(':') != std::string_view::npos)
+                return false;
+        }
+
+        if (host.empty() || port.empty())
+            return false;
+
+        uint32_t portValue = 0;
+        const auto [end, error] = std::from_chars(port.data(), port.data() + port.size(), portValue);
+        if (error != std::errc() || end != port.data() + port.size() || portValue == 0 || portValue > 65535)
+            return false;
+
+        outHost.assign(host);
+        outPort = static_cast<uint16_t>(portValue);
+        return true;
+    }
+
+    void DnsResolver::SortForHappyEyeballs(std::vector<SteamNetworkingIPAddr>& addresses, bool preferIPv6)
+    {
+        std::vector<SteamNetworkingIPAddr> preferred;
+        std::vector<SteamNetworkingIPAddr> other;
+        for (const SteamNetworkingIPAddr& address : addresses)
+        {
+            if (address.IsIPv4() != preferIPv6)
+                preferred.push_back(address);
+            else
+                other.push_back(address);
+        }
+
+        addresses.clear();
+        for (size_t i = 0; i < std::max(preferred.size(), other.size()); i++)
+        {
+            if (i < preferred.size())
+                addresses.push_back(preferred[i]);
+            if (i < other.size())
+                addresses.push_back(other[i]);
+        }
+    }
+
+} // namespace Utopia
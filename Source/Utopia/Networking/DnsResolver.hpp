@@ -0,0 +1,112 @@
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    struct DnsResolverConfig
+    {
+        // The system resolver does not report record TTLs, so successful and failed lookups are
+        // cached for these fixed times instead
+        std::chrono::seconds PositiveTTL{ 60 };
+        std::chrono::seconds NegativeTTL{ 5 };
+
+        // Threads doing blocking lookups; a slow name server only stalls these
+        uint32_t WorkerCount = 2;
+    };
+
+    struct DnsResult
+    {
+        bool Success = false;
+        // Port 0, ordered for Happy Eyeballs with IPv6 first
+        std::vector<SteamNetworkingIPAddr> Addresses;
+        // Only set on failure
+        std::string Error;
+    };
+
+    // One lookup in flight. Poll IsReady(); the result never changes once it is.
+    class DnsQuery
+    {
+    public:
+        bool IsReady() const { return m_Ready.load(std::memory_order_acquire); }
+        // Only valid once IsReady() returns true
+        const DnsResult& GetResult() const { return m_Result; }
+
+        const std::string& GetHost() const { return m_Host; }
+
+    private:
+        friend class DnsResolver;
+
+        std::string m_Host;
+        DnsResult m_Result;
+        std::atomic_bool m_Ready{ false };
+    };
+
+    // Process-wide non-blocking host name resolver. Lookups run on a few worker threads and results,
+    // good or bad, are cached per host, so reconnecting to the same host does not resolve again.
+    // Concurrent lookups of the same host share one query.
+    class DnsResolver
+    {
+    public:
+        // Must be called before the first Get() to take effect
+        static void Configure(const DnsResolverConfig& config);
+        static DnsResolver& Get();
+
+        ~DnsResolver();
+
+        DnsResolver(const DnsResolver&) = delete;
+        DnsResolver& operator=(const DnsResolver&) = delete;
+
+        // Returns a query that is already ready when the host was cached. Safe from any thread.
+        std::shared_ptr<const DnsQuery> ResolveAsync(std::string_view host);
+
+        // A cached result that has not expired yet
+        std::optional<DnsResult> GetCached(std::string_view host);
+        void ClearCache();
+
+        // Splits "host:port", "1.2.3.4:port" or "[::1]:port". False if the port is missing or invalid.
+        static bool SplitHostPort(std::string_view address, std::string& outHost, uint16_t& outPort);
+
+        // Interleaves the families starting with the preferred one, keeping the resolver's order within each
+        // family (RFC 8305, section 4)
+        static void SortForHappyEyeballs(std::vector<SteamNetworkingIPAddr>& addresses, bool preferIPv6 = true);
+
+    private:
+        explicit DnsResolver(const DnsResolverConfig& config);
+
+        void WorkerThreadFunc();
+        void Complete(const std::shared_ptr<DnsQuery>& query);
+
+    private:
+        struct CacheEntry
+        {
+            std::shared_ptr<const DnsQuery> Query;
+            // Only meaningful once Query is ready
+            std::chrono::steady_clock::time_point Expiry;
+        };
+
+        DnsResolverConfig m_Config;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::unordered_map<std::string, CacheEntry> m_Cache;
+        std::deque<std::shared_ptr<DnsQuery>> m_Pending;
+        std::vector<std::thread> m_Workers;
+        bool m_Stopping = false;
+    };
+
+} // namespace Utopia
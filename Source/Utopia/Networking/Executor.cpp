@@ -0,0 +1,250 @@
+#include "Executor.hpp"
+
+#include <algorithm>
+
+namespace Utopia {
+
+    namespace {
+
+        // Lets work posted from inside a pool stay on the worker that posted it
+        thread_local const void* s_CurrentPool = nullptr;
+        thread_local uint32_t s_CurrentWorker = 0;
+
+    } // anonymous namespace
+
+    InlineExecutor& InlineExecutor::Get()
+    {
+        static InlineExecutor s_Executor;
+        return s_Executor;
+    }
+
+    void ManualExecutor::Post(Work work)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Pending.push_back(std::move(work));
+    }
+
+    size_t ManualExecutor::RunPending()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Running.swap(m_Pending);
+        }
+
+        for (Work& work : m_Running)
+            work();
+
+        const size_t count = m_Running.size();
+        m_Running.clear();
+        return count;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // ThreadExecutor
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    ThreadExecutor::ThreadExecutor()
+        : m_Thread([this]() { ThreadFunc(); })
+    {
+    }
+
+    ThreadExecutor::~ThreadExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_Condition.notify_one();
+        m_Thread.join();
+    }
+
+    void ThreadExecutor::Post(Work work)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Queue.push_back(std::move(work));
+        }
+        m_Condition.notify_one();
+    }
+
+    size_t ThreadExecutor::GetQueueDepth() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Queue.size();
+    }
+
+    void ThreadExecutor::ThreadFunc()
+    {
+        while (true)
+        {
+            Work work;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_Condition.wait(lock, [this]() { return m_Stopping || !m_Queue.empty(); });
+                if (m_Queue.empty())
+                    return;
+
+                work = std::move(m_Queue.front());
+                m_Queue.pop_front();
+            }
+            work();
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // ThreadPoolExecutor
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    ThreadPoolExecutor::ThreadPoolExecutor(uint32_t threadCount)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+        for (uint32_t i = 0; i < threadCount; i++)
+            m_Queues.push_back(std::make_unique<WorkerQueue>());
+
+        m_Workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++)
+            m_Workers.emplace_back([this, i]() { WorkerThreadFunc(i); });
+    }
+
+    ThreadPoolExecutor::~ThreadPoolExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Stopping = true;
+        }
+        m_SleepCondition.notify_all();
+
+        for (std::thread& worker : m_Workers)
+            worker.join();
+    }
+
+    void ThreadPoolExecutor::Post(Work work)
+    {
+        m_QueueDepth.fetch_add(1, std::memory_order_relaxed);
+        Schedule(Item{ std::move(work), 0, false });
+    }
+
+    void ThreadPoolExecutor::PostOrdered(uint64_t key, Work work)
+    {
+        m_QueueDepth.fetch_add(1, std::memory_order_relaxed);
+
+        StrandShard& shard = m_StrandShards[key % k_StrandShardCount];
+        bool idle = false;
+        {
+            std::lock_guard<std::mutex> lock(shard.Mutex);
+            auto [it, inserted] = shard.Strands.try_emplace(key);
+            it->second.Queue.push_back(std::move(work));
+            idle = inserted;
+        }
+
+        // A strand with work already queued has a turn scheduled or running that will get to this
+        if (idle)
+            Schedule(Item{ {}, key, true });
+    }
+
+    void ThreadPoolExecutor::Schedule(Item item)
+    {
+        const uint32_t queueIndex = s_CurrentPool == this
+            ? s_CurrentWorker
+            : m_NextQueue.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(m_Queues.size());
+
+        {
+            WorkerQueue& queue = *m_Queues[queueIndex];
+            std::lock_guard<std::mutex> lock(queue.Mutex);
+            queue.Queue.push_back(std::move(item));
+        }
+
+        // Counted under the sleep lock, so a worker about to sleep cannot miss it
+        {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Scheduled.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_SleepCondition.notify_one();
+    }
+
+    bool ThreadPoolExecutor::TryTake(uint32_t workerIndex, Item& outItem)
+    {
+        const uint32_t queueCount = static_cast<uint32_t>(m_Queues.size());
+        for (uint32_t i = 0; i < queueCount; i++)
+        {
+            WorkerQueue& queue = *m_Queues[(workerIndex + i) % queueCount];
+            std::lock_guard<std::mutex> lock(queue.Mutex);
+            if (queue.Queue.empty())
+                continue;
+
+            // Oldest first from our own queue; thieves take the newest, leaving the owner its order
+            if (i == 0)
+            {
+                outItem = std::move(queue.Queue.front());
+                queue.Queue.pop_front();
+            }
+            else
+            {
+                outItem = std::move(queue.Queue.back());
+                queue.Queue.pop_back();
+            }
+
+            m_Scheduled.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPoolExecutor::RunStrand(uint64_t key)
+    {
+        StrandShard& shard = m_StrandShards[key % k_StrandShardCount];
+        for (size_t i = 0; i < k_StrandBatch; i++)
+        {
+            Work work;
+            {
+                std::lock_guard<std::mutex> lock(shard.Mutex);
+                const auto it = shard.Strands.find(key);
+                if (it->second.Queue.empty())
+                {
+                    // Done; the next PostOrdered for this key starts a new strand
+                    shard.Strands.erase(it);
+                    return;
+                }
+
+                work = std::move(it->second.Queue.front());
+                it->second.Queue.pop_front();
+            }
+
+            m_QueueDepth.fetch_sub(1, std::memory_order_relaxed);
+            work();
+        }
+
+        // A busy strand goes to the back of the line rather than holding on to this worker
+        Schedule(Item{ {}, key, true });
+    }
+
+    void ThreadPoolExecutor::WorkerThreadFunc(uint32_t workerIndex)
+    {
+        s_CurrentPool = this;
+        s_CurrentWorker = workerIndex;
+
+        while (true)
+        {
+            Item item;
+            if (TryTake(workerIndex, item))
+            {
+                if (item.IsStrand)
+                {
+                    RunStrand(item.StrandKey);
+                }
+                else
+                {
+                    m_QueueDepth.fetch_sub(1, std::memory_order_relaxed);
+                    item.Function();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_SleepCondition.wait(lock, [this]() { return m_Stopping || m_Scheduled.load(std::memory_order_relaxed) > 0; });
+            if (m_Stopping && m_Scheduled.load(std::memory_order_relaxed) == 0)
+                return;
+        }
+    }
+
+} // namespace Utopia
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    // Where asynchronous work continues, e.g. the coroutines suspended on an AsyncClient.
+    // Implementations must accept Post() from any thread.
+    class Executor
+    {
+    public:
+        using Work = std::function<void()>;
+
+    public:
+        virtual ~Executor() = default;
+
+        virtual void Post(Work work) = 0;
+
+        // Work posted with the same key runs in posting order and never concurrently; work with different
+        // keys may run in parallel. Executors that run everything in order already guarantee this.
+        // Keys are shared by everything posting to the executor: Servers key by ClientID, Clients set the high bit.
+        virtual void PostOrdered(uint64_t /*key*/, Work work) { Post(std::move(work)); }
+    };
+
+    // Runs work immediately on the posting thread, which for network events is the network thread.
+    // Lowest latency, but the work must not block or call back into the Client's setters.
+    class InlineExecutor final : public Executor
+    {
+    public:
+        static InlineExecutor& Get();
+
+        void Post(Work work) override { work(); }
+    };
+
+    // Queues work until the owner calls RunPending(), typically once per frame on the game thread
+    class ManualExecutor final : public Executor
+    {
+    public:
+        void Post(Work work) override;
+
+        // Runs everything posted so far, in order. Work posted while running waits for the next call.
+        // Not reentrant; call from one thread, never from inside posted work.
+        // Returns the number of items run.
+        size_t RunPending();
+
+    private:
+        std::mutex m_Mutex;
+        std::vector<Work> m_Pending;
+        std::vector<Work> m_Running;
+    };
+
+    // Runs work in posting order on one dedicated thread
+    class ThreadExecutor final : public Executor
+    {
+    public:
+        ThreadExecutor();
+        // Runs what is already queued, then joins the thread
+        ~ThreadExecutor() override;
+
+        ThreadExecutor(const ThreadExecutor&) = delete;
+        ThreadExecutor& operator=(const ThreadExecutor&) = delete;
+
+        void Post(Work work) override;
+
+        // Items waiting to run, not counting the one running
+        size_t GetQueueDepth() const;
+
+    private:
+        void ThreadFunc();
+
+    private:
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::deque<Work> m_Queue;
+        bool m_Stopping = false;
+        std::thread m_Thread;
+    };
+
+    // Work-stealing pool. Each worker has its own queue; work posted from a worker stays on it, work
+    // posted from outside is spread round-robin, and idle workers steal from the others. Ordered work is
+    // kept in a strand per key, which runs on one worker at a time.
+    class ThreadPoolExecutor final : public Executor
+    {
+    public:
+        // Zero uses one thread per hardware thread
+        explicit ThreadPoolExecutor(uint32_t threadCount = 0);
+        // Runs what is already queued, then joins the threads
+        ~ThreadPoolExecutor() override;
+
+        ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+        ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+        void Post(Work work) override;
+        void PostOrdered(uint64_t key, Work work) override;
+
+        uint32_t GetThreadCount() const { return static_cast<uint32_t>(m_Workers.size()); }
+        // Items waiting to run across all workers and strands, not counting those running
+        size_t GetQueueDepth() const { return m_QueueDepth.load(std::memory_order_relaxed); }
+
+    private:
+        // Either plain work or a turn for the strand of StrandKey
+        struct Item
+        {
+            Work Function;
+            uint64_t StrandKey = 0;
+            bool IsStrand = false;
+        };
+
+        struct WorkerQueue
+        {
+            std::mutex Mutex;
+            std::deque<Item> Queue;
+        };
+
+        struct Strand
+        {
+            std::deque<Work> Queue;
+        };
+
+        struct StrandShard
+        {
+            std::mutex Mutex;
+            // Present while the strand has work queued or running
+            std::unordered_map<uint64_t, Strand> Strands;
+        };
+
+        // A strand runs this many items before yielding its worker to other queued work
+        static constexpr size_t k_StrandBatch = 32;
+        static constexpr size_t k_StrandShardCount = 16;
+
+        void Schedule(Item item);
+        bool TryTake(uint32_t workerIndex, Item& outItem);
+        void RunStrand(uint64_t key);
+        void WorkerThreadFunc(uint32_t workerIndex);
+
+    private:
+        std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+        std::vector<std::thread> m_Workers;
+        std::atomic<uint32_t> m_NextQueue{ 0 };
+
+        std::array<StrandShard, k_StrandShardCount> m_StrandShards;
+
+        // Scheduled items, strands counting as one; workers sleep when it reaches zero
+        std::mutex m_SleepMutex;
+        std::condition_variable m_SleepCondition;
+        std::atomic<size_t> m_Scheduled{ 0 };
+        std::atomic<size_t> m_QueueDepth{ 0 };
+        bool m_Stopping = false;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,59 @@
+#include "FlowControl.hpp"
+
+#include <algorithm>
+
+namespace Utopia {
+
+    bool CongestionTracker::IsCongested(HSteamNetConnection connection) const
+    {
+        if (!HasCongestion())
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Congested.contains(connection);
+    }
+
+    bool CongestionTracker::MarkCongested(HSteamNetConnection connection)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!m_Congested.insert(connection).second)
+            return false;
+
+        m_Count.store(static_cast<uint32_t>(m_Congested.size()), std::memory_order_release);
+        return true;
+    }
+
+    bool CongestionTracker::MarkWritable(HSteamNetConnection connection)
+    {
+        if (!HasCongestion())
+            return false;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_Congested.erase(connection) == 0)
+            return false;
+
+        m_Count.store(static_cast<uint32_t>(m_Congested.size()), std::memory_order_release);
+        return true;
+    }
+
+    void CongestionTracker::Prune(std::span<const HSteamNetConnection> liveConnections)
+    {
+        if (!HasCongestion())
+            return;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::erase_if(m_Congested, [liveConnections](HSteamNetConnection connection)
+            {
+                return !std::binary_search(liveConnections.begin(), liveConnections.end(), connection);
+            });
+        m_Count.store(static_cast<uint32_t>(m_Congested.size()), std::memory_order_release);
+    }
+
+    void CongestionTracker::Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Congested.clear();
+        m_Count.store(0, std::memory_order_release);
+    }
+
+} // namespace Utopia
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <steam/steamnetworkingsockets.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+namespace Utopia {
+
+    enum class SendStatus
+    {
+        // Handed to the send queue
+        Queued = 0,
+        // The connection is over its high watermark; wait for the writable callback and try again
+        WouldBlock,
+        NotConnected
+    };
+
+    // What happens to unreliable sends addressed to a congested connection
+    enum class CongestedUnreliablePolicy
+    {
+        Send = 0,
+        Drop,
+        // Keep only the newest message per lane and send it once the connection is writable again
+        Coalesce
+    };
+
+    struct FlowControlConfig
+    {
+        // A connection becomes congested when pending bytes or queue time exceed the high watermark,
+        // and writable again once both fall to the low watermark
+        int HighWatermarkBytes = 256 * 1024;
+        int LowWatermarkBytes = 64 * 1024;
+        SteamNetworkingMicroseconds HighWatermarkQueueTime = 250'000;
+        SteamNetworkingMicroseconds LowWatermarkQueueTime = 50'000;
+
+        // How often the network thread re-checks every connection; zero checks on every iteration
+        std::chrono::milliseconds CheckInterval{ 20 };
+
+        CongestedUnreliablePolicy UnreliablePolicy = CongestedUnreliablePolicy::Send;
+
+        bool IsAboveHighWatermark(const SteamNetConnectionRealTimeStatus_t& status) const
+        {
+            return status.m_cbPendingReliable + status.m_cbPendingUnreliable > HighWatermarkBytes
+                || status.m_usecQueueTime > HighWatermarkQueueTime;
+        }
+
+        bool IsBelowLowWatermark(const SteamNetConnectionRealTimeStatus_t& status) const
+        {
+            return status.m_cbPendingReliable + status.m_cbPendingUnreliable <= LowWatermarkBytes
+                && status.m_usecQueueTime <= LowWatermarkQueueTime;
+        }
+    };
+
+    // The set of congested connections. Any thread may query or mark congestion; the network thread
+    // clears it. Queries are a single atomic load while nothing is congested.
+    class CongestionTracker
+    {
+    public:
+        bool IsCongested(HSteamNetConnection connection) const;
+        bool HasCongestion() const { return m_Count.load(std::memory_order_acquire) > 0; }
+
+        // Both return true if the state changed
+        bool MarkCongested(HSteamNetConnection connection);
+        bool MarkWritable(HSteamNetConnection connection);
+
+        // Forgets connections missing from liveConnections, which must be sorted
+        void Prune(std::span<const HSteamNetConnection> liveConnections);
+        void Clear();
+
+    private:
+        mutable std::mutex m_Mutex;
+        std::unordered_set<HSteamNetConnection> m_Congested;
+        std::atomic<uint32_t> m_Count{ 0 };
+    };
+
+} // namespace Utopia
@@ -0,0 +1,217 @@
+#include "InterestManagement.hpp"
+
+#include "Server.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Utopia {
+
+    namespace {
+
+        // Cell coordinates are packed into 21 bits each
+        constexpr int32_t k_MaxCellCoord = (1 << 20) - 1;
+
+        int32_t ToCellCoord(float value, float inverseCellSize)
+        {
+            const float cell = std::floor(value * inverseCellSize);
+            if (!(cell > static_cast<float>(-k_MaxCellCoord)))
+                return -k_MaxCellCoord;
+            if (cell > static_cast<float>(k_MaxCellCoord))
+                return k_MaxCellCoord;
+            return static_cast<int32_t>(cell);
+        }
+
+    } // anonymous namespace
+
+    InterestManager::InterestManager(Server& server, const InterestConfig& config)
+        : m_Server(server), m_Config(config)
+    {
+        if (!(m_Config.CellSize > 0.0f))
+            m_Config.CellSize = InterestConfig().CellSize;
+        m_InverseCellSize = 1.0f / m_Config.CellSize;
+    }
+
+    InterestManager::CellCoord InterestManager::GetCell(const glm::vec3& position) const
+    {
+        return {
+            ToCellCoord(position.x, m_InverseCellSize),
+            ToCellCoord(position.y, m_InverseCellSize),
+            ToCellCoord(position.z, m_InverseCellSize)
+        };
+    }
+
+    uint64_t InterestManager::GetCellKey(const CellCoord& cell)
+    {
+        constexpr uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (static_cast<uint64_t>(cell.X) & mask)
+            | ((static_cast<uint64_t>(cell.Y) & mask) << 21)
+            | ((static_cast<uint64_t>(cell.Z) & mask) << 42);
+    }
+
+    bool InterestManager::IsGlobal(const CellRange& range) const
+    {
+        // Each side spans at most 2^21 cells, so the product fits
+        const uint64_t cellCount = static_cast<uint64_t>(range.Max.X - range.Min.X + 1)
+            * static_cast<uint64_t>(range.Max.Y - range.Min.Y + 1)
+            * static_cast<uint64_t>(range.Max.Z - range.Min.Z + 1);
+        return cellCount > m_Config.MaxCellsPerClient;
+    }
+
+    void InterestManager::InsertIntoCells(ClientID clientID, const CellRange& range)
+    {
+        if (IsGlobal(range))
+        {
+            m_GlobalClients.push_back(clientID);
+            return;
+        }
+
+        for (int32_t z = range.Min.Z; z <= range.Max.Z; z++)
+            for (int32_t y = range.Min.Y; y <= range.Max.Y; y++)
+                for (int32_t x = range.Min.X; x <= range.Max.X; x++)
+                    m_Cells[GetCellKey({ x, y, z })].push_back(clientID);
+    }
+
+    void InterestManager::RemoveFromCells(ClientID clientID, const CellRange& range)
+    {
+        if (IsGlobal(range))
+        {
+            const auto client = std::find(m_GlobalClients.begin(), m_GlobalClients.end(), clientID);
+            if (client != m_GlobalClients.end())
+            {
+                *client = m_GlobalClients.back();
+                m_GlobalClients.pop_back();
+            }
+            return;
+        }
+
+        for (int32_t z = range.Min.Z; z <= range.Max.Z; z++)
+        {
+            for (int32_t y = range.Min.Y; y <= range.Max.Y; y++)
+            {
+                for (int32_t x = range.Min.X; x <= range.Max.X; x++)
+                {
+                    const auto it = m_Cells.find(GetCellKey({ x, y, z }));
+                    if (it == m_Cells.end())
+                        continue;
+
+                    std::vector<ClientID>& clients = it->second;
+                    const auto client = std::find(clients.begin(), clients.end(), clientID);
+                    if (client != clients.end())
+                    {
+                        *client = clients.back();
+                        clients.pop_back();
+                    }
+
+                    if (clients.empty())
+                        m_Cells.erase(it);
+                }
+            }
+        }
+    }
+
+    void InterestManager::SetClientInterest(ClientID clientID, const glm::vec3& position, float radius)
+    {
+        radius = std::max(radius, 0.0f);
+        const CellRange range = {
+            GetCell({ position.x - radius, position.y - radius, position.z - radius }),
+            GetCell({ position.x + radius, position.y + radius, position.z + radius })
+        };
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        const auto [it, inserted] = m_Interests.try_emplace(clientID);
+        Interest& interest = it->second;
+        interest.Position = position;
+        interest.RadiusSquared = radius * radius;
+
+        if (inserted)
+        {
+            InsertIntoCells(clientID, range);
+        }
+        else if (interest.Cells != range)
+        {
+            RemoveFromCells(clientID, interest.Cells);
+            InsertIntoCells(clientID, range);
+        }
+        interest.Cells = range;
+    }
+
+    void InterestManager::RemoveClient(ClientID clientID)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        const auto it = m_Interests.find(clientID);
+        if (it == m_Interests.end())
+            return;
+
+        RemoveFromCells(clientID, it->second.Cells);
+        m_Interests.erase(it);
+    }
+
+    void InterestManager::Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Interests.clear();
+        m_Cells.clear();
+        m_GlobalClients.clear();
+    }
+
+    void InterestManager::CollectInterested(const glm::vec3& position, std::vector<ClientID>& outClientIDs, ClientID excludeClientID) const
+    {
+        const auto collect = [&](const std::vector<ClientID>& clientIDs)
+            {
+                for (const ClientID clientID : clientIDs)
+                {
+                    if (clientID == excludeClientID)
+                        continue;
+
+                    const Interest& interest = m_Interests.at(clientID);
+                    const float dx = position.x - interest.Position.x;
+                    const float dy = position.y - interest.Position.y;
+                    const float dz = position.z - interest.Position.z;
+                    if (dx * dx + dy * dy + dz * dz <= interest.RadiusSquared)
+                        outClientIDs.push_back(clientID);
+                }
+            };
+
+        // A client is listed once in every cell its sphere overlaps, or else once in the global bucket,
+        // so there are no duplicates
+        const auto cell = m_Cells.find(GetCellKey(GetCell(position)));
+        if (cell != m_Cells.end())
+            collect(cell->second);
+        collect(m_GlobalClients);
+    }
+
+    void InterestManager::QueryInterested(const glm::vec3& position, std::vector<ClientID>& outClientIDs, ClientID excludeClientID) const
+    {
+        outClientIDs.clear();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        CollectInterested(position, outClientIDs, excludeClientID);
+    }
+
+    size_t InterestManager::SendToInterested(const glm::vec3& position, Buffer buffer, ClientID excludeClientID, SendFlags flags, uint16_t lane)
+    {
+        // Per thread, since the send runs outside the lock and may overlap another thread's
+        thread_local std::vector<ClientID> s_Recipients;
+        s_Recipients.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            CollectInterested(position, s_Recipients, excludeClientID);
+        }
+        if (s_Recipients.empty())
+            return 0;
+
+        // The send encodes and queues per client, which is too long to hold other senders off for
+        m_Server.SendBufferToClients(s_Recipients, buffer, flags, nullptr, lane);
+        return s_Recipients.size();
+    }
+
+    size_t InterestManager::GetClientCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Interests.size();
+    }
+
+} // namespace Utopia
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include "ClientRegistry.hpp"
+#include "MessageProtocol.hpp"
+#include "SendFlags.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    class Server;
+
+    struct InterestConfig
+    {
+        // Edge length of a grid cell in world units. Close to the typical interest radius works best:
+        // much smaller and every client spans many cells, much larger and each cell holds many misses.
+        float CellSize = 64.0f;
+
+        // A sphere spanning more cells than this goes into a single bucket that every send checks instead,
+        // so one huge radius costs a distance test per send rather than millions of cell entries
+        uint32_t MaxCellsPerClient = 1024;
+    };
+
+    // Relevance filter for broadcasts. Every client registers a sphere of interest, which is bucketed
+    // into a uniform grid; SendToInterested() then only looks at the clients whose sphere overlaps the
+    // cell of the position being sent, so the cost follows local density instead of player count.
+    // For a 2D world leave z at 0.
+    //
+    // Safe from any thread. Pair with the server's disconnect callback:
+    //   server.SetClientDisconnectedCallback([&](const ClientInfo& client) { interest.RemoveClient(client.ID); });
+    class InterestManager
+    {
+    public:
+        explicit InterestManager(Server& server, const InterestConfig& config = {});
+
+        InterestManager(const InterestManager&) = delete;
+        InterestManager& operator=(const InterestManager&) = delete;
+
+        // Registers the client or moves its area of interest. Cheap while the area stays in the same cells.
+        // The client is listed in every cell its sphere touches, so keep the radius within a few cells;
+        // past MaxCellsPerClient it is checked on every send instead.
+        void SetClientInterest(ClientID clientID, const glm::vec3& position, float radius);
+        void RemoveClient(ClientID clientID);
+        void Clear();
+
+        // Clients whose area of interest contains position
+        void QueryInterested(const glm::vec3& position, std::vector<ClientID>& outClientIDs, ClientID excludeClientID = 0) const;
+
+        // Sends to every client interested in position through the server's batched fan-out.
+        // Returns the number of recipients.
+        size_t SendToInterested(const glm::vec3& position, Buffer buffer, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+
+        template<NetworkMessage T>
+        size_t SendMessageToInterested(const glm::vec3& position, const T& message, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            const OutgoingMessage encoded = EncodeMessage(message);
+            return SendToInterested(position, encoded.GetBuffer(), excludeClientID, flags, lane);
+        }
+
+        size_t GetClientCount() const;
+
+    private:
+        struct CellCoord
+        {
+            int32_t X = 0, Y = 0, Z = 0;
+
+            bool operator==(const CellCoord& other) const = default;
+        };
+
+        // Inclusive range of cells covered by a client's sphere
+        struct CellRange
+        {
+            CellCoord Min;
+            CellCoord Max;
+
+            bool operator==(const CellRange& other) const = default;
+        };
+
+        struct Interest
+        {
+            glm::vec3 Position;
+            float RadiusSquared = 0.0f;
+            CellRange Cells;
+        };
+
+        CellCoord GetCell(const glm::vec3& position) const;
+        static uint64_t GetCellKey(const CellCoord& cell);
+
+        // Ranges over MaxCellsPerClient go into m_GlobalClients instead of the cells
+        bool IsGlobal(const CellRange& range) const;
+        void InsertIntoCells(ClientID clientID, const CellRange& range);
+        void RemoveFromCells(ClientID clientID, const CellRange& range);
+
+        // Caller holds m_Mutex
+        void CollectInterested(const glm::vec3& position, std::vector<ClientID>& outClientIDs, ClientID excludeClientID) const;
+
+    private:
+        Server& m_Server;
+        InterestConfig m_Config;
+        float m_InverseCellSize = 0.0f;
+
+        mutable std::mutex m_Mutex;
+        std::unordered_map<ClientID, Interest> m_Interests;
+        std::unordered_map<uint64_t, std::vector<ClientID>> m_Cells;
+        std::vector<ClientID> m_GlobalClients;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace Utopia {
+
+    // A whole file mapped into memory, either writable and growable or read-only. Implemented per platform.
+    class MappedFile
+    {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        // Creates or truncates the file and maps size bytes of it read-write
+        bool Create(const std::string& path, size_t size, std::string& outError);
+        // Maps an existing file read-only. An empty file opens with no data.
+        bool OpenRead(const std::string& path, std::string& outError);
+
+        // Writable files only. Keeps the contents but may move them, invalidating pointers from GetData().
+        // On failure the file keeps its previous size and mapping.
+        bool Resize(size_t size, std::string& outError);
+
+        // Unmaps the file. A writable file is first cut down to finalSize bytes, so preallocated space
+        // does not end up on disk.
+        void Close(size_t finalSize);
+        void Close() { Close(m_Size); }
+
+        std::byte* GetData() const { return m_Data; }
+        size_t GetSize() const { return m_Size; }
+        bool IsOpen() const { return m_File != k_InvalidHandle; }
+        bool IsWritable() const { return m_Writable; }
+
+    private:
+        // A file descriptor or a HANDLE, so the header needs no platform includes
+        static constexpr intptr_t k_InvalidHandle = -1;
+
+        std::byte* m_Data = nullptr;
+        size_t m_Size = 0;
+        bool m_Writable = false;
+
+        intptr_t m_File = k_InvalidHandle;
+        // File mapping object; only used on Windows
+        intptr_t m_Mapping = 0;
+    };
+
+} // namespace Utopia
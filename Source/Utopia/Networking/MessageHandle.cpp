@@ -0,0 +1,46 @@
+#include "MessageHandle.hpp"
+
+#include <utility>
+
+namespace Utopia {
+
+    MessageHandle::MessageHandle(SteamNetworkingMessage_t* message) noexcept
+        : m_Message(message)
+    {
+    }
+
+    MessageHandle::~MessageHandle() noexcept
+    {
+        Release();
+    }
+
+    MessageHandle::MessageHandle(MessageHandle&& other) noexcept
+        : m_Message(std::exchange(other.m_Message, nullptr))
+    {
+    }
+
+    MessageHandle& MessageHandle::operator=(MessageHandle&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Release();
+            m_Message = std::exchange(other.m_Message, nullptr);
+        }
+        return *this;
+    }
+
+    void MessageHandle::Release() noexcept
+    {
+        if (m_Message)
+        {
+            m_Message->Release();
+            m_Message = nullptr;
+        }
+    }
+
+    SteamNetworkingMessage_t* MessageHandle::Detach() noexcept
+    {
+        return std::exchange(m_Message, nullptr);
+    }
+
+} // namespace Utopia
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <cstdint>
+
+namespace Utopia {
+
+    // Owns a received GameNetworkingSockets message without copying its payload.
+    // Move it wherever the data is needed (another thread, a deferred queue); the
+    // message goes back to the library when the owning handle is released or destroyed.
+    class MessageHandle
+    {
+    public:
+        MessageHandle() = default;
+        explicit MessageHandle(SteamNetworkingMessage_t* message) noexcept;
+        ~MessageHandle() noexcept;
+
+        MessageHandle(const MessageHandle&) = delete;
+        MessageHandle& operator=(const MessageHandle&) = delete;
+
+        MessageHandle(MessageHandle&& other) noexcept;
+        MessageHandle& operator=(MessageHandle&& other) noexcept;
+
+        // Returns the message to the library. Safe to call more than once.
+        void Release() noexcept;
+
+        // Gives up ownership without releasing; the caller becomes responsible for Release()
+        [[nodiscard]] SteamNetworkingMessage_t* Detach() noexcept;
+
+        bool IsValid() const { return m_Message != nullptr; }
+        explicit operator bool() const { return IsValid(); }
+
+        const void* GetData() const { return m_Message ? m_Message->m_pData : nullptr; }
+        uint32_t GetSize() const { return m_Message ? static_cast<uint32_t>(m_Message->m_cbSize) : 0; }
+
+        // Non-owning view of the payload, valid for as long as this handle holds the message
+        Buffer GetBuffer() const { return Buffer(GetData(), GetSize()); }
+
+        HSteamNetConnection GetSender() const { return m_Message ? m_Message->m_conn : k_HSteamNetConnection_Invalid; }
+        SteamNetworkingMicroseconds GetTimeReceived() const { return m_Message ? m_Message->m_usecTimeReceived : 0; }
+        int64_t GetMessageNumber() const { return m_Message ? m_Message->m_nMessageNumber : 0; }
+        uint16_t GetLane() const { return m_Message ? m_Message->m_idxLane : 0; }
+
+    private:
+        SteamNetworkingMessage_t* m_Message = nullptr;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,217 @@
+#include "MessagePool.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+
+#include <cassert>
+#include <limits>
+#include <utility>
+
+namespace Utopia {
+
+    namespace {
+
+        constexpr uint32_t k_EmptyIndex = std::numeric_limits<uint32_t>::max();
+        constexpr uint32_t k_SlabAlignment = 16;
+
+        MessagePoolConfig s_PendingConfig;
+        std::atomic_bool s_PoolCreated{ false };
+
+        constexpr uint64_t PackHead(uint64_t tag, uint32_t index)
+        {
+            return (tag << 32) | index;
+        }
+
+    } // anonymous namespace
+
+    void MessagePool::Configure(const MessagePoolConfig& config)
+    {
+        if (s_PoolCreated.load())
+        {
+            UT_WARN_TAG("NETWORK", "MessagePool::Configure called after the pool was created; ignoring");
+            return;
+        }
+        s_PendingConfig = config;
+    }
+
+    MessagePool& MessagePool::Get()
+    {
+        static MessagePool s_Pool(s_PendingConfig);
+        return s_Pool;
+    }
+
+    MessagePool::MessagePool(const MessagePoolConfig& config)
+    {
+        s_PoolCreated.store(true);
+
+        for (size_t classIndex = 0; classIndex < m_SizeClasses.size(); classIndex++)
+        {
+            SizeClass& sizeClass = m_SizeClasses[classIndex];
+            sizeClass.Capacity = MessagePoolConfig::SizeClasses[classIndex];
+            sizeClass.SlabStride = (static_cast<uint32_t>(sizeof(SlabHeader)) + sizeClass.Capacity + k_SlabAlignment - 1) & ~(k_SlabAlignment - 1);
+            sizeClass.SlabCount = config.SlabCounts[classIndex];
+
+            sizeClass.Storage = std::make_unique<std::byte[]>(static_cast<size_t>(sizeClass.SlabStride) * sizeClass.SlabCount);
+            sizeClass.Next = std::make_unique<std::atomic<uint32_t>[]>(sizeClass.SlabCount);
+
+            for (uint32_t slabIndex = 0; slabIndex < sizeClass.SlabCount; slabIndex++)
+            {
+                auto* header = reinterpret_cast<SlabHeader*>(sizeClass.Storage.get() + static_cast<size_t>(slabIndex) * sizeClass.SlabStride);
+                header->Pool = this;
+                header->SizeClass = static_cast<uint32_t>(classIndex);
+                header->Index = slabIndex;
+
+                sizeClass.Next[slabIndex].store(slabIndex + 1 < sizeClass.SlabCount ? slabIndex + 1 : k_EmptyIndex, std::memory_order_relaxed);
+            }
+
+            sizeClass.Head.store(PackHead(0, sizeClass.SlabCount > 0 ? 0 : k_EmptyIndex));
+        }
+    }
+
+    void* MessagePool::Pop(SizeClass& sizeClass)
+    {
+        uint64_t head = sizeClass.Head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            const uint32_t index = static_cast<uint32_t>(head);
+            if (index == k_EmptyIndex)
+                return nullptr;
+
+            // May read a stale link if another thread pops this slab first; the tag makes our CAS fail then
+            const uint32_t next = sizeClass.Next[index].load(std::memory_order_relaxed);
+            if (sizeClass.Head.compare_exchange_weak(head, PackHead((head >> 32) + 1, next), std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+                std::byte* slab = sizeClass.Storage.get() + static_cast<size_t>(index) * sizeClass.SlabStride;
+                return slab + sizeof(SlabHeader);
+            }
+        }
+    }
+
+    void MessagePool::Push(uint32_t sizeClassIndex, uint32_t slabIndex) noexcept
+    {
+        SizeClass& sizeClass = m_SizeClasses[sizeClassIndex];
+
+        uint64_t head = sizeClass.Head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            sizeClass.Next[slabIndex].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            if (sizeClass.Head.compare_exchange_weak(head, PackHead((head >> 32) + 1, slabIndex), std::memory_order_release, std::memory_order_relaxed))
+                break;
+        }
+
+        m_InUse.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void* MessagePool::AcquireSlab(uint32_t size)
+    {
+        m_Allocations.fetch_add(1, std::memory_order_relaxed);
+
+        // Best fit first; spill into larger classes rather than falling back to the heap
+        for (SizeClass& sizeClass : m_SizeClasses)
+        {
+            if (sizeClass.Capacity < size)
+                continue;
+
+            if (void* slab = Pop(sizeClass))
+            {
+                m_SlabHits.fetch_add(1, std::memory_order_relaxed);
+
+                const uint32_t inUse = m_InUse.fetch_add(1, std::memory_order_relaxed) + 1;
+                uint32_t peak = m_PeakInUse.load(std::memory_order_relaxed);
+                while (inUse > peak && !m_PeakInUse.compare_exchange_weak(peak, inUse, std::memory_order_relaxed))
+                {
+                }
+                return slab;
+            }
+        }
+
+        m_Fallbacks.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void MessagePool::ReleaseSlab(void* slab) noexcept
+    {
+        const SlabHeader* header = static_cast<const SlabHeader*>(slab) - 1;
+        header->Pool->Push(header->SizeClass, header->Index);
+    }
+
+    SteamNetworkingMessage_t* MessagePool::AllocateMessage(uint32_t size)
+    {
+        void* slab = AcquireSlab(size);
+        if (!slab)
+        {
+            // Let the library allocate the payload itself
+            return SteamNetworkingUtils()->AllocateMessage(static_cast<int>(size));
+        }
+
+        // The header still comes from the library, which owns its layout and frees it after sending
+        SteamNetworkingMessage_t* message = SteamNetworkingUtils()->AllocateMessage(0);
+        assert(message && "AllocateMessage returned nullptr!");
+
+        message->m_pData = slab;
+        message->m_cbSize = static_cast<int>(size);
+        message->m_pfnFreeData = &MessagePool::FreeMessageData;
+        return message;
+    }
+
+    void MessagePool::FreeMessageData(SteamNetworkingMessage_t* message)
+    {
+        ReleaseSlab(message->m_pData);
+    }
+
+    MessagePoolStats MessagePool::GetStats() const
+    {
+        MessagePoolStats stats;
+        stats.Allocations = m_Allocations.load(std::memory_order_relaxed);
+        stats.SlabHits = m_SlabHits.load(std::memory_order_relaxed);
+        stats.Fallbacks = m_Fallbacks.load(std::memory_order_relaxed);
+        stats.InUse = m_InUse.load(std::memory_order_relaxed);
+        stats.PeakInUse = m_PeakInUse.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // OutgoingMessage
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    OutgoingMessage::OutgoingMessage(uint32_t capacity)
+        : m_Message(MessagePool::Get().AllocateMessage(capacity)), m_Capacity(capacity)
+    {
+    }
+
+    OutgoingMessage::~OutgoingMessage() noexcept
+    {
+        if (m_Message)
+            m_Message->Release();
+    }
+
+    OutgoingMessage::OutgoingMessage(OutgoingMessage&& other) noexcept
+        : m_Message(std::exchange(other.m_Message, nullptr)), m_Capacity(std::exchange(other.m_Capacity, 0))
+    {
+    }
+
+    OutgoingMessage& OutgoingMessage::operator=(OutgoingMessage&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (m_Message)
+                m_Message->Release();
+            m_Message = std::exchange(other.m_Message, nullptr);
+            m_Capacity = std::exchange(other.m_Capacity, 0);
+        }
+        return *this;
+    }
+
+    void OutgoingMessage::SetSize(uint32_t size)
+    {
+        assert(m_Message && size <= m_Capacity && "OutgoingMessage size exceeds its capacity");
+        m_Message->m_cbSize = static_cast<int>(size);
+    }
+
+    SteamNetworkingMessage_t* OutgoingMessage::Detach() noexcept
+    {
+        m_Capacity = 0;
+        return std::exchange(m_Message, nullptr);
+    }
+
+} // namespace Utopia
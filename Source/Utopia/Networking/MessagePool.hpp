@@ -0,0 +1,135 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace Utopia {
+
+    struct MessagePoolConfig
+    {
+        // Payload capacity of each size class, smallest first. The last class is sized to one MTU.
+        static constexpr std::array<uint32_t, 4> SizeClasses = { 64, 256, 1024, 1200 };
+
+        // Slabs preallocated per size class
+        std::array<uint32_t, SizeClasses.size()> SlabCounts = { 1024, 1024, 512, 512 };
+    };
+
+    // Counts payload slabs only. Every message still gets its header from the library's allocator.
+    struct MessagePoolStats
+    {
+        uint64_t Allocations = 0;
+        uint64_t SlabHits = 0;
+        // Requests larger than the biggest class, or made while that class was exhausted
+        uint64_t Fallbacks = 0;
+        uint32_t InUse = 0;
+        uint32_t PeakInUse = 0;
+
+        double GetSlabHitRate() const { return Allocations ? static_cast<double>(SlabHits) / static_cast<double>(Allocations) : 1.0; }
+    };
+
+    // Process-wide pool of preallocated payload slabs for outgoing messages.
+    // Acquire and release are lock-free, so any thread may send. Slabs are handed to the library via
+    // SendMessages and come back through m_pfnFreeData, which is why there is exactly one pool and it
+    // lives until static destruction.
+    // Only the payload is pooled: each send still costs one library AllocateMessage() for the message
+    // header, which the library frees itself once the message is sent.
+    class MessagePool
+    {
+    public:
+        // Must be called before the first Get() to take effect
+        static void Configure(const MessagePoolConfig& config);
+        static MessagePool& Get();
+
+        MessagePool(const MessagePool&) = delete;
+        MessagePool& operator=(const MessagePool&) = delete;
+
+        // Allocates a library message with room for at least `size` payload bytes, the payload from a slab
+        // when one fits. m_cbSize is set to `size`; the caller fills m_pData, m_conn and m_nFlags.
+        [[nodiscard]] SteamNetworkingMessage_t* AllocateMessage(uint32_t size);
+
+        // Raw slab access for payloads that manage their own lifetime. Returns nullptr on a miss,
+        // which is counted as a fallback; the caller must then allocate elsewhere.
+        [[nodiscard]] void* AcquireSlab(uint32_t size);
+        static void ReleaseSlab(void* slab) noexcept;
+
+        MessagePoolStats GetStats() const;
+
+    private:
+        explicit MessagePool(const MessagePoolConfig& config);
+
+        struct SlabHeader
+        {
+            MessagePool* Pool;
+            uint32_t SizeClass;
+            uint32_t Index;
+        };
+
+        // Treiber stack of slab indices. The head packs a 32-bit ABA tag above the 32-bit index.
+        struct SizeClass
+        {
+            uint32_t Capacity = 0;
+            uint32_t SlabStride = 0;
+            uint32_t SlabCount = 0;
+            std::unique_ptr<std::byte[]> Storage;
+            std::unique_ptr<std::atomic<uint32_t>[]> Next;
+            std::atomic<uint64_t> Head{ 0 };
+        };
+
+        void* Pop(SizeClass& sizeClass);
+        void Push(uint32_t sizeClassIndex, uint32_t slabIndex) noexcept;
+
+        static void FreeMessageData(SteamNetworkingMessage_t* message);
+
+    private:
+        std::array<SizeClass, MessagePoolConfig::SizeClasses.size()> m_SizeClasses;
+
+        std::atomic<uint64_t> m_Allocations{ 0 };
+        std::atomic<uint64_t> m_SlabHits{ 0 };
+        std::atomic<uint64_t> m_Fallbacks{ 0 };
+        std::atomic<uint32_t> m_InUse{ 0 };
+        std::atomic<uint32_t> m_PeakInUse{ 0 };
+    };
+
+    // A pooled outgoing message the application serializes into directly, then hands to
+    // Server::SendOutgoingMessageToClient or Client::SendOutgoingMessage. Move-only; an unsent
+    // message returns its slab to the pool on destruction.
+    class OutgoingMessage
+    {
+    public:
+        OutgoingMessage() = default;
+        explicit OutgoingMessage(uint32_t capacity);
+        ~OutgoingMessage() noexcept;
+
+        OutgoingMessage(const OutgoingMessage&) = delete;
+        OutgoingMessage& operator=(const OutgoingMessage&) = delete;
+
+        OutgoingMessage(OutgoingMessage&& other) noexcept;
+        OutgoingMessage& operator=(OutgoingMessage&& other) noexcept;
+
+        bool IsValid() const { return m_Message != nullptr; }
+        explicit operator bool() const { return IsValid(); }
+
+        void* GetData() const { return m_Message ? m_Message->m_pData : nullptr; }
+        uint32_t GetCapacity() const { return m_Capacity; }
+
+        // Number of bytes actually sent; defaults to the full capacity
+        uint32_t GetSize() const { return m_Message ? static_cast<uint32_t>(m_Message->m_cbSize) : 0; }
+        void SetSize(uint32_t size);
+
+        Buffer GetBuffer() const { return Buffer(GetData(), GetSize()); }
+
+        // Gives up ownership; used by the send paths
+        [[nodiscard]] SteamNetworkingMessage_t* Detach() noexcept;
+
+    private:
+        SteamNetworkingMessage_t* m_Message = nullptr;
+        uint32_t m_Capacity = 0;
+    };
+
+} // namespace Utopia
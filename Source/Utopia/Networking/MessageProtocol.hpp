@@ -0,0 +1,364 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include "MessagePool.hpp"
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace Utopia {
+
+    using MessageTypeID = uint16_t;
+
+    // Written in front of every typed message. Message IDs must stay below k_MaxMessageTypeID,
+    // which bounds the size of the dispatch table.
+    struct MessageHeader
+    {
+        static constexpr uint32_t k_Size = sizeof(MessageTypeID);
+        static constexpr MessageTypeID k_MaxMessageTypeID = 1024;
+        // IDs from here up belong to the library's own subsystems, such as snapshot replication and request envelopes
+        static constexpr MessageTypeID k_FirstReservedID = 0xFF00;
+    };
+
+    // A message type's stable ID. Either give the type a `static constexpr MessageTypeID MessageID`
+    // or specialize this (see UT_NETWORK_MESSAGE) for types you cannot change.
+    template<typename T>
+    struct MessageTypeTraits
+    {
+    };
+
+    template<typename T>
+        requires requires { { T::MessageID } -> std::convertible_to<MessageTypeID>; }
+    struct MessageTypeTraits<T>
+    {
+        static constexpr MessageTypeID ID = T::MessageID;
+    };
+
+    // Trivially copyable messages are sent as their raw bytes. Anything else must specialize this with:
+    //   static uint32_t GetSize(const T& message);
+    //   static void Serialize(const T& message, std::span<std::byte> out);         // out.size() == GetSize(message)
+    //   static bool Deserialize(std::span<const std::byte> in, T& outMessage);     // false rejects the message
+    template<typename T>
+    struct MessageSerializer
+    {
+    };
+
+    template<typename T>
+    concept HasMessageSerializer = requires(const T& message, T& outMessage, std::span<std::byte> out, std::span<const std::byte> in)
+    {
+        { MessageSerializer<T>::GetSize(message) } -> std::convertible_to<uint32_t>;
+        MessageSerializer<T>::Serialize(message, out);
+        { MessageSerializer<T>::Deserialize(in, outMessage) } -> std::same_as<bool>;
+    };
+
+    template<typename T>
+    concept HasMessageTypeID = requires { { MessageTypeTraits<T>::ID } -> std::convertible_to<MessageTypeID>; };
+
+    template<typename T>
+    concept NetworkMessage = HasMessageTypeID<T> && (std::is_trivially_copyable_v<T> || HasMessageSerializer<T>);
+
+    template<typename T>
+    inline constexpr MessageTypeID MessageIDOf = MessageTypeTraits<T>::ID;
+
+    enum class DispatchResult
+    {
+        Handled = 0,
+        // Shorter than a header, or the payload failed to deserialize
+        Malformed,
+        // The ID is not part of the protocol
+        UnknownType,
+        // Registered, but the handler has no OnMessage overload for it
+        Unhandled
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Encoding
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    template<NetworkMessage T>
+    uint32_t GetEncodedMessageSize(const T& message)
+    {
+        if constexpr (HasMessageSerializer<T>)
+            return MessageHeader::k_Size + static_cast<uint32_t>(MessageSerializer<T>::GetSize(message));
+        else
+            return MessageHeader::k_Size + static_cast<uint32_t>(sizeof(T));
+    }
+
+    // Writes header and payload into out, which must hold GetEncodedMessageSize(message) bytes
+    template<NetworkMessage T>
+    void EncodeMessage(const T& message, std::span<std::byte> out)
+    {
+        constexpr MessageTypeID id = MessageIDOf<T>;
+        std::memcpy(out.data(), &id, sizeof(id));
+
+        std::span<std::byte> payload = out.subspan(MessageHeader::k_Size);
+        if constexpr (HasMessageSerializer<T>)
+            MessageSerializer<T>::Serialize(message, payload);
+        else
+            std::memcpy(payload.data(), &message, sizeof(T));
+    }
+
+    // Serializes straight into a pooled slab, ready for SendOutgoingMessage
+    template<NetworkMessage T>
+    OutgoingMessage EncodeMessage(const T& message)
+    {
+        OutgoingMessage outgoingMessage(GetEncodedMessageSize(message));
+        if (outgoingMessage)
+            EncodeMessage(message, std::span<std::byte>(static_cast<std::byte*>(outgoingMessage.GetData()), outgoingMessage.GetSize()));
+        return outgoingMessage;
+    }
+
+    // Returns the ID of an encoded message without decoding it; false if the buffer is too short
+    inline bool PeekMessageTypeID(Buffer buffer, MessageTypeID& outID)
+    {
+        if (!buffer.Data || buffer.Size < MessageHeader::k_Size)
+            return false;
+
+        std::memcpy(&outID, buffer.Data, sizeof(outID));
+        return true;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Decoding and dispatch
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Decodes the payload that follows a message's header. False if it does not deserialize.
+    template<NetworkMessage T>
+    bool DecodeMessagePayload(std::span<const std::byte> payload, T& outMessage)
+    {
+        if constexpr (HasMessageSerializer<T>)
+        {
+            return MessageSerializer<T>::Deserialize(payload, outMessage);
+        }
+        else
+        {
+            if (payload.size() != sizeof(T))
+                return false;
+
+            // The payload follows a 2 byte header, so copy out rather than reinterpret in place
+            std::array<std::byte, sizeof(T)> bytes;
+            std::memcpy(bytes.data(), payload.data(), sizeof(T));
+            outMessage = std::bit_cast<T>(bytes);
+            return true;
+        }
+    }
+
+    // Decodes a whole message when its type is known up front. False if the ID does not match or the payload is malformed.
+    template<NetworkMessage T>
+    bool DecodeMessage(Buffer buffer, T& outMessage)
+    {
+        MessageTypeID id;
+        if (!PeekMessageTypeID(buffer, id) || id != MessageIDOf<T>)
+            return false;
+
+        return DecodeMessagePayload(std::span<const std::byte>(
+            static_cast<const std::byte*>(buffer.Data) + MessageHeader::k_Size,
+            static_cast<size_t>(buffer.Size) - MessageHeader::k_Size
+        ), outMessage);
+    }
+
+    // A fixed set of message types with a jump table built at compile time. Dispatch reads the header,
+    // indexes the table and calls handler.OnMessage(context..., message) with the decoded message,
+    // with no virtual calls and no allocations for trivially copyable messages:
+    //
+    //   using GameProtocol = MessageProtocol<PlayerInput, ChatMessage>;
+    //   struct GameHandler
+    //   {
+    //       void OnMessage(const ClientInfo& client, const PlayerInput& input);
+    //       void OnMessage(const ClientInfo& client, const ChatMessage& chat);
+    //   };
+    //   server.SetDataReceivedCallback([&](const ClientInfo& client, const Buffer buffer)
+    //       {
+    //           GameProtocol::Dispatch(handler, buffer, client);
+    //       });
+    template<typename... Messages>
+    class MessageProtocol
+    {
+        static_assert(sizeof...(Messages) > 0, "A MessageProtocol needs at least one message type");
+        static_assert((HasMessageTypeID<Messages> && ...), "Every message type needs a static MessageID or a UT_NETWORK_MESSAGE registration");
+        static_assert(((std::is_trivially_copyable_v<Messages> || HasMessageSerializer<Messages>) && ...),
+            "Message types that are not trivially copyable must specialize MessageSerializer");
+
+    private:
+        static constexpr std::array<MessageTypeID, sizeof...(Messages)> k_IDs = { MessageIDOf<Messages>... };
+
+        static constexpr bool HasUniqueIDs()
+        {
+            for (size_t i = 0; i < k_IDs.size(); i++)
+            {
+                for (size_t j = i + 1; j < k_IDs.size(); j++)
+                {
+                    if (k_IDs[i] == k_IDs[j])
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        static constexpr MessageTypeID GetMaxID()
+        {
+            MessageTypeID maxID = 0;
+            for (MessageTypeID id : k_IDs)
+                maxID = id > maxID ? id : maxID;
+            return maxID;
+        }
+
+        static_assert(HasUniqueIDs(), "Message IDs within a MessageProtocol must be unique");
+        static_assert(GetMaxID() < MessageHeader::k_MaxMessageTypeID, "Message ID out of range; see MessageHeader::k_MaxMessageTypeID");
+
+    public:
+        static constexpr size_t k_MessageCount = sizeof...(Messages);
+        static constexpr size_t k_TableSize = static_cast<size_t>(GetMaxID()) + 1;
+
+        template<typename T>
+        static constexpr bool Contains = (std::is_same_v<T, Messages> || ...);
+
+        static constexpr bool IsRegistered(MessageTypeID id)
+        {
+            for (MessageTypeID registeredID : k_IDs)
+            {
+                if (registeredID == id)
+                    return true;
+            }
+            return false;
+        }
+
+        template<typename Handler, typename... Context>
+        static DispatchResult Dispatch(Handler& handler, Buffer buffer, const Context&... context)
+        {
+            MessageTypeID id;
+            if (!PeekMessageTypeID(buffer, id))
+                return DispatchResult::Malformed;
+
+            if (id >= k_TableSize)
+                return DispatchResult::UnknownType;
+
+            const std::span<const std::byte> payload(
+                static_cast<const std::byte*>(buffer.Data) + MessageHeader::k_Size,
+                static_cast<size_t>(buffer.Size) - MessageHeader::k_Size
+            );
+            return DispatchTable<Handler, Context...>::k_Entries[id](handler, payload, context...);
+        }
+
+    private:
+        template<typename Handler, typename... Context>
+        using DispatchFunction = DispatchResult(*)(Handler&, std::span<const std::byte>, const Context&...);
+
+        template<typename Handler, typename... Context>
+        static DispatchResult DispatchUnknown(Handler&, std::span<const std::byte>, const Context&...)
+        {
+            return DispatchResult::UnknownType;
+        }
+
+        template<typename T, typename Handler, typename... Context>
+        static DispatchResult DispatchMessage(Handler& handler, std::span<const std::byte> payload, const Context&... context)
+        {
+            if constexpr (!requires(const T& message) { handler.OnMessage(context..., message); })
+            {
+                return DispatchResult::Unhandled;
+            }
+            else
+            {
+                T message{};
+                if (!DecodeMessagePayload(payload, message))
+                    return DispatchResult::Malformed;
+
+                handler.OnMessage(context..., static_cast<const T&>(message));
+                return DispatchResult::Handled;
+            }
+        }
+
+        template<typename Handler, typename... Context>
+        struct DispatchTable
+        {
+            static constexpr std::array<DispatchFunction<Handler, Context...>, k_TableSize> Build()
+            {
+                std::array<DispatchFunction<Handler, Context...>, k_TableSize> entries{};
+                for (auto& entry : entries)
+                    entry = &DispatchUnknown<Handler, Context...>;
+
+                ((entries[MessageIDOf<Messages>] = &DispatchMessage<Messages, Handler, Context...>), ...);
+                return entries;
+            }
+
+            static constexpr std::array<DispatchFunction<Handler, Context...>, k_TableSize> k_Entries = Build();
+        };
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Request/response envelopes
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Wraps a typed message with a correlation ID so the reply can be matched to its request, as
+    // AsyncClient::Request() does. Answering on the server:
+    //   uint32_t correlationID;
+    //   Buffer request;
+    //   if (RequestEnvelope::UnwrapRequest(buffer, correlationID, request))
+    //   {
+    //       // Decode or dispatch request as usual, then
+    //       server.SendOutgoingMessageToClient(client.ID, RequestEnvelope::EncodeResponse(correlationID, reply));
+    //   }
+    namespace RequestEnvelope {
+
+        // Following the snapshot replication IDs
+        static constexpr MessageTypeID k_RequestID = MessageHeader::k_FirstReservedID + 2;
+        static constexpr MessageTypeID k_ResponseID = MessageHeader::k_FirstReservedID + 3;
+
+        // Envelope ID and correlation ID, followed by the encoded message
+        static constexpr uint32_t k_HeaderSize = MessageHeader::k_Size + 4;
+
+        template<NetworkMessage T>
+        OutgoingMessage Encode(MessageTypeID envelopeID, uint32_t correlationID, const T& message)
+        {
+            OutgoingMessage outgoingMessage(k_HeaderSize + GetEncodedMessageSize(message));
+            if (!outgoingMessage)
+                return outgoingMessage;
+
+            std::byte* data = static_cast<std::byte*>(outgoingMessage.GetData());
+            std::memcpy(data, &envelopeID, sizeof(envelopeID));
+            std::memcpy(data + MessageHeader::k_Size, &correlationID, sizeof(correlationID));
+            EncodeMessage(message, std::span<std::byte>(data + k_HeaderSize, outgoingMessage.GetSize() - k_HeaderSize));
+            return outgoingMessage;
+        }
+
+        template<NetworkMessage T>
+        OutgoingMessage EncodeRequest(uint32_t correlationID, const T& request) { return Encode(k_RequestID, correlationID, request); }
+
+        template<NetworkMessage T>
+        OutgoingMessage EncodeResponse(uint32_t correlationID, const T& reply) { return Encode(k_ResponseID, correlationID, reply); }
+
+        // Splits an envelope into its correlation ID and the encoded message inside. False if buffer is not an envelope of that kind.
+        inline bool Unwrap(Buffer buffer, MessageTypeID envelopeID, uint32_t& outCorrelationID, Buffer& outMessage)
+        {
+            MessageTypeID id;
+            if (!PeekMessageTypeID(buffer, id) || id != envelopeID || buffer.Size < k_HeaderSize)
+                return false;
+
+            const std::byte* data = static_cast<const std::byte*>(buffer.Data);
+            std::memcpy(&outCorrelationID, data + MessageHeader::k_Size, sizeof(outCorrelationID));
+            outMessage = Buffer(data + k_HeaderSize, buffer.Size - k_HeaderSize);
+            return true;
+        }
+
+        inline bool UnwrapRequest(Buffer buffer, uint32_t& outCorrelationID, Buffer& outMessage) { return Unwrap(buffer, k_RequestID, outCorrelationID, outMessage); }
+        inline bool UnwrapResponse(Buffer buffer, uint32_t& outCorrelationID, Buffer& outMessage) { return Unwrap(buffer, k_ResponseID, outCorrelationID, outMessage); }
+
+    } // namespace RequestEnvelope
+
+} // namespace Utopia
+
+// Registers a message ID for a type that cannot declare its own MessageID. Use at global scope.
+#define UT_NETWORK_MESSAGE(Type, Value) \
+    template<> \
+    struct Utopia::MessageTypeTraits<Type> \
+    { \
+        static constexpr ::Utopia::MessageTypeID ID = (Value); \
+    }
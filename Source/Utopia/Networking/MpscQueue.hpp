@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace Utopia {
+
+    // Bounded lock-free queue for many producers and a single consumer (after Dmitry Vyukov's
+    // bounded MPMC design). Every cell carries a sequence number, so producers only contend on
+    // one atomic increment and the consumer never writes to a producer-owned cache line.
+    template<typename T>
+    class MpscQueue
+    {
+    public:
+        // Capacity is rounded up to the next power of two
+        explicit MpscQueue(size_t capacity)
+        {
+            size_t roundedCapacity = 2;
+            while (roundedCapacity < capacity)
+                roundedCapacity <<= 1;
+
+            m_Mask = roundedCapacity - 1;
+            m_Cells = std::make_unique<Cell[]>(roundedCapacity);
+            for (size_t i = 0; i < roundedCapacity; i++)
+                m_Cells[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        // Safe from any thread. Returns false if the queue is full.
+        bool TryPush(T value)
+        {
+            size_t position = m_EnqueuePosition.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = m_Cells[position & m_Mask];
+                const size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+                const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+                if (difference == 0)
+                {
+                    if (m_EnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.Value = std::move(value);
+                        cell.Sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = m_EnqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Consumer thread only. Returns false if the queue is empty.
+        bool TryPop(T& outValue)
+        {
+            Cell& cell = m_Cells[m_DequeuePosition & m_Mask];
+            const size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(m_DequeuePosition + 1) < 0)
+                return false;
+
+            outValue = std::move(cell.Value);
+            cell.Sequence.store(m_DequeuePosition + m_Mask + 1, std::memory_order_release);
+            m_DequeuePosition++;
+            return true;
+        }
+
+        size_t GetCapacity() const { return m_Mask + 1; }
+
+    private:
+        static constexpr size_t k_CacheLineSize = 64;
+
+        struct Cell
+        {
+            std::atomic<size_t> Sequence{ 0 };
+            T Value{};
+        };
+
+    private:
+        std::unique_ptr<Cell[]> m_Cells;
+        size_t m_Mask = 0;
+
+        alignas(k_CacheLineSize) std::atomic<size_t> m_EnqueuePosition{ 0 };
+        alignas(k_CacheLineSize) size_t m_DequeuePosition = 0;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,183 @@
+#include "NetworkConditions.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <mutex>
+
+namespace Utopia {
+
+    namespace {
+
+        constexpr std::array<std::string_view, 5> k_BuiltinNames = { "none", "lan", "wifi", "4g", "transatlantic" };
+
+        std::mutex s_ActiveMutex;
+        NetworkConditionProfile s_ActiveProfile;
+
+        bool EqualsIgnoreCase(std::string_view a, std::string_view b)
+        {
+            return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](char x, char y)
+                {
+                    return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+                });
+        }
+
+    } // anonymous namespace
+
+    std::chrono::milliseconds NetworkConditionProfile::GetMaxDelay() const
+    {
+        const int32_t jitter = JitterPercent > 0.0f ? static_cast<int32_t>(std::ceil(JitterMaxMs)) : 0;
+        const int32_t reorder = ReorderPercent > 0.0f ? ReorderTimeMs : 0;
+        return std::chrono::milliseconds(LagMs + jitter + reorder);
+    }
+
+    NetworkConditionProfile NetworkConditionProfile::None()
+    {
+        return {};
+    }
+
+    NetworkConditionProfile NetworkConditionProfile::LAN()
+    {
+        NetworkConditionProfile profile;
+        profile.Name = "lan";
+        profile.LagMs = 1;
+        profile.JitterAvgMs = 0.2f;
+        profile.JitterMaxMs = 1.0f;
+        profile.JitterPercent = 10.0f;
+        return profile;
+    }
+
+    NetworkConditionProfile NetworkConditionProfile::HomeWifi()
+    {
+        NetworkConditionProfile profile;
+        profile.Name = "wifi";
+        profile.LossPercent = 0.5f;
+        profile.LagMs = 5;
+        profile.JitterAvgMs = 3.0f;
+        profile.JitterMaxMs = 30.0f;
+        profile.JitterPercent = 30.0f;
+        profile.ReorderPercent = 0.1f;
+        profile.ReorderTimeMs = 5;
+        return profile;
+    }
+
+    NetworkConditionProfile NetworkConditionProfile::Mobile4G()
+    {
+        NetworkConditionProfile profile;
+        profile.Name = "4g";
+        profile.LossPercent = 1.5f;
+        profile.LagMs = 25;
+        profile.JitterAvgMs = 10.0f;
+        profile.JitterMaxMs = 80.0f;
+        profile.JitterPercent = 50.0f;
+        profile.ReorderPercent = 0.5f;
+        profile.ReorderTimeMs = 10;
+        profile.DuplicatePercent = 0.1f;
+        profile.DuplicateTimeMaxMs = 20;
+        // Roughly a 10 Mbit/s uplink
+        profile.RateLimit = 1250 * 1000;
+        profile.RateLimitBurst = 32 * 1024;
+        return profile;
+    }
+
+    NetworkConditionProfile NetworkConditionProfile::Transatlantic()
+    {
+        NetworkConditionProfile profile;
+        profile.Name = "transatlantic";
+        profile.LossPercent = 0.3f;
+        profile.LagMs = 40;
+        profile.JitterAvgMs = 2.0f;
+        profile.JitterMaxMs = 15.0f;
+        profile.JitterPercent = 20.0f;
+        profile.ReorderPercent = 0.05f;
+        profile.ReorderTimeMs = 5;
+        return profile;
+    }
+
+    std::optional<NetworkConditionProfile> NetworkConditionProfile::FromName(std::string_view name)
+    {
+        if (EqualsIgnoreCase(name, "none"))
+            return None();
+        if (EqualsIgnoreCase(name, "lan"))
+            return LAN();
+        if (EqualsIgnoreCase(name, "wifi"))
+            return HomeWifi();
+        if (EqualsIgnoreCase(name, "4g"))
+            return Mobile4G();
+        if (EqualsIgnoreCase(name, "transatlantic"))
+            return Transatlantic();
+        return std::nullopt;
+    }
+
+    std::span<const std::string_view> NetworkConditionProfile::GetBuiltinNames()
+    {
+        return k_BuiltinNames;
+    }
+
+    bool NetworkConditions::Apply(const NetworkConditionProfile& profile, ConditionDirection direction)
+    {
+        ISteamNetworkingUtils* utils = SteamNetworkingUtils();
+        if (!utils)
+        {
+            UT_ERROR_TAG("NETWORK", "Cannot apply network conditions; the networking library is unavailable");
+            return false;
+        }
+
+        // The receive side is cleared when only sending is shaped, so switching directions leaves nothing behind
+        const NetworkConditionProfile none;
+        const NetworkConditionProfile& receive = direction == ConditionDirection::SendAndReceive ? profile : none;
+
+        bool ok = true;
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketLoss_Send, profile.LossPercent);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketLoss_Recv, receive.LossPercent);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketLag_Send, profile.LagMs);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketLag_Recv, receive.LagMs);
+
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketJitter_Send_Avg, profile.JitterAvgMs);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketJitter_Send_Max, profile.JitterMaxMs);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketJitter_Send_Pct, profile.JitterPercent);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketJitter_Recv_Avg, receive.JitterAvgMs);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketJitter_Recv_Max, receive.JitterMaxMs);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketJitter_Recv_Pct, receive.JitterPercent);
+
+        // The reorder delay is shared by both directions
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketReorder_Send, profile.ReorderPercent);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketReorder_Recv, receive.ReorderPercent);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketReorder_Time, profile.ReorderTimeMs);
+
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketDup_Send, profile.DuplicatePercent);
+        ok &= utils->SetGlobalConfigValueFloat(k_ESteamNetworkingConfig_FakePacketDup_Recv, receive.DuplicatePercent);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakePacketDup_TimeMax, profile.DuplicateTimeMaxMs);
+
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Send_Rate, profile.RateLimit);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Send_Burst, profile.RateLimitBurst);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Recv_Rate, receive.RateLimit);
+        ok &= utils->SetGlobalConfigValueInt32(k_ESteamNetworkingConfig_FakeRateLimit_Recv_Burst, receive.RateLimitBurst);
+
+        if (!ok)
+            UT_WARN_TAG("NETWORK", "The networking library rejected part of network condition profile '{}'", profile.Name);
+        else
+            UT_INFO_TAG("NETWORK", "Simulating network conditions '{}'", profile.Name);
+
+        std::lock_guard<std::mutex> lock(s_ActiveMutex);
+        s_ActiveProfile = profile;
+        return ok;
+    }
+
+    void NetworkConditions::Clear()
+    {
+        Apply(NetworkConditionProfile::None());
+    }
+
+    NetworkConditionProfile NetworkConditions::GetActive()
+    {
+        std::lock_guard<std::mutex> lock(s_ActiveMutex);
+        return s_ActiveProfile;
+    }
+
+} // namespace Utopia
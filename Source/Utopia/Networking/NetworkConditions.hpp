@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace Utopia {
+
+    // Simulated conditions of a one-way network path, applied through the library's FakePacket* and
+    // FakeRateLimit* settings
+    struct NetworkConditionProfile
+    {
+        std::string Name = "none";
+
+        float LossPercent = 0.0f;
+        int32_t LagMs = 0;
+
+        // Extra delay for JitterPercent of packets, exponentially distributed around JitterAvgMs and
+        // capped at JitterMaxMs. Jitter clumps packets but never reorders them.
+        float JitterAvgMs = 0.0f;
+        float JitterMaxMs = 0.0f;
+        float JitterPercent = 0.0f;
+
+        // Packets held back by ReorderTimeMs so later ones overtake them
+        float ReorderPercent = 0.0f;
+        int32_t ReorderTimeMs = 0;
+
+        // Duplicates arrive up to DuplicateTimeMaxMs after the original
+        float DuplicatePercent = 0.0f;
+        int32_t DuplicateTimeMaxMs = 0;
+
+        // Token bucket in bytes per second; 0 leaves the rate unlimited
+        int32_t RateLimit = 0;
+        int32_t RateLimitBurst = 16 * 1024;
+
+        // Worst-case delay the profile adds to one packet, for sizing timeouts
+        std::chrono::milliseconds GetMaxDelay() const;
+
+        bool operator==(const NetworkConditionProfile&) const = default;
+
+        static NetworkConditionProfile None();
+        // Same switch: sub-millisecond jitter and nothing lost
+        static NetworkConditionProfile LAN();
+        static NetworkConditionProfile HomeWifi();
+        static NetworkConditionProfile Mobile4G();
+        // Europe to US east coast, around 80 ms round trip
+        static NetworkConditionProfile Transatlantic();
+
+        // Case-insensitive lookup of the built-in profiles by name, see GetBuiltinNames()
+        static std::optional<NetworkConditionProfile> FromName(std::string_view name);
+        static std::span<const std::string_view> GetBuiltinNames();
+    };
+
+    enum class ConditionDirection
+    {
+        // Outgoing packets only. When server and clients share a process, every leg is still shaped once.
+        Send = 0,
+        // Outgoing and incoming, for an endpoint talking to a peer that simulates nothing
+        SendAndReceive
+    };
+
+    // The library simulates at its UDP layer for the whole process, so conditions are process-wide and the
+    // last profile applied wins; they cannot differ per connection. The library's random source cannot be
+    // seeded, so runs are reproducible in distribution rather than packet for packet.
+    class NetworkConditions
+    {
+    public:
+        // Safe from any thread and at any time, including mid-run; packets already delayed keep their delay.
+        // Returns false if the library rejected a setting.
+        static bool Apply(const NetworkConditionProfile& profile, ConditionDirection direction = ConditionDirection::Send);
+        static void Clear();
+
+        static NetworkConditionProfile GetActive();
+    };
+
+} // namespace Utopia
@@ -0,0 +1,105 @@
+#include "NetworkLanes.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <algorithm>
+
+namespace Utopia {
+
+    bool LaneConfig::Apply(ISteamNetworkingSockets* networkInterface, HSteamNetConnection connection) const
+    {
+        // A connection has a single lane by default
+        if (Lanes.size() <= 1)
+            return true;
+
+        std::vector<int> priorities;
+        std::vector<uint16> weights;
+        priorities.reserve(Lanes.size());
+        weights.reserve(Lanes.size());
+        for (const Lane& lane : Lanes)
+        {
+            priorities.push_back(lane.Priority);
+            weights.push_back(lane.Weight);
+        }
+
+        const EResult result = networkInterface->ConfigureConnectionLanes(
+            connection,
+            static_cast<int>(Lanes.size()),
+            priorities.data(),
+            weights.data()
+        );
+        if (result != k_EResultOK)
+        {
+            UT_WARN_TAG("NETWORK", "ConfigureConnectionLanes failed with EResult code: {}", static_cast<int>(result));
+            return false;
+        }
+
+        return true;
+    }
+
+    void LaneStatsCollector::Reset(const LaneConfig& config)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Lanes.assign(config.Lanes.size(), {});
+        for (uint16_t i = 0; i < config.GetLaneCount(); i++)
+        {
+            m_Lanes[i].Stats.Lane = i;
+            m_Lanes[i].Stats.Priority = config.Lanes[i].Priority;
+            m_Lanes[i].Stats.Weight = config.Lanes[i].Weight;
+        }
+        m_LaneStatus.resize(m_Lanes.size());
+    }
+
+    void LaneStatsCollector::Sample(ISteamNetworkingSockets* networkInterface, std::span<const HSteamNetConnection> connections)
+    {
+        if (m_LaneStatus.empty())
+            return;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (LaneTotals& lane : m_Lanes)
+        {
+            lane.Stats.PendingReliableBytes = 0;
+            lane.Stats.PendingUnreliableBytes = 0;
+        }
+
+        for (HSteamNetConnection connection : connections)
+        {
+            const EResult result = networkInterface->GetConnectionRealTimeStatus(
+                connection,
+                nullptr,
+                static_cast<int>(m_LaneStatus.size()),
+                m_LaneStatus.data()
+            );
+            if (result != k_EResultOK)
+                continue;
+
+            for (size_t i = 0; i < m_Lanes.size(); i++)
+            {
+                const SteamNetConnectionRealTimeLaneStatus_t& status = m_LaneStatus[i];
+                LaneTotals& lane = m_Lanes[i];
+
+                lane.Stats.Samples++;
+                lane.TotalQueueTime += status.m_usecQueueTime;
+                lane.Stats.MaxQueueTime = std::max(lane.Stats.MaxQueueTime, status.m_usecQueueTime);
+                lane.Stats.PendingReliableBytes += status.m_cbPendingReliable;
+                lane.Stats.PendingUnreliableBytes += status.m_cbPendingUnreliable;
+            }
+        }
+    }
+
+    std::vector<LaneStats> LaneStatsCollector::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        std::vector<LaneStats> stats;
+        stats.reserve(m_Lanes.size());
+        for (const LaneTotals& lane : m_Lanes)
+        {
+            LaneStats& laneStats = stats.emplace_back(lane.Stats);
+            if (lane.Stats.Samples > 0)
+                laneStats.AverageQueueTime = lane.TotalQueueTime / static_cast<SteamNetworkingMicroseconds>(lane.Stats.Samples);
+        }
+        return stats;
+    }
+
+} // namespace Utopia
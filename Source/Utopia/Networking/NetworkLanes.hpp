@@ -0,0 +1,75 @@
+#pragma once
+
+#include <steam/steamnetworkingsockets.h>
+
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace Utopia {
+
+    // One send lane of a connection. Reliable messages on the same lane arrive in order; messages on
+    // different lanes do not block each other.
+    struct Lane
+    {
+        // Lower values are sent first
+        int Priority = 0;
+        // Lanes sharing a priority split bandwidth in proportion to their weights
+        uint16_t Weight = 1;
+    };
+
+    // Applied to every connection as it is established. Lanes only shape what this side sends;
+    // the peer configures its own. Lane 0 is the cheapest on the wire, so make it the busiest one.
+    struct LaneConfig
+    {
+        std::vector<Lane> Lanes = { Lane{} };
+
+        uint16_t GetLaneCount() const { return static_cast<uint16_t>(Lanes.size()); }
+
+        // Returns false if the library rejected the configuration
+        bool Apply(ISteamNetworkingSockets* networkInterface, HSteamNetConnection connection) const;
+    };
+
+    struct LaneStats
+    {
+        uint16_t Lane = 0;
+        int Priority = 0;
+        uint16_t Weight = 1;
+
+        // Predicted wait for a message queued at sample time, across every sampled connection (microseconds)
+        uint64_t Samples = 0;
+        SteamNetworkingMicroseconds AverageQueueTime = 0;
+        SteamNetworkingMicroseconds MaxQueueTime = 0;
+
+        // Summed over all connections at the most recent sample
+        int64_t PendingReliableBytes = 0;
+        int64_t PendingUnreliableBytes = 0;
+    };
+
+    // Accumulates per-lane queue time. Sampling happens on the network thread; stats can be read from any thread.
+    class LaneStatsCollector
+    {
+    public:
+        void Reset(const LaneConfig& config);
+
+        // Samples every given connection once and folds the results into the running stats
+        void Sample(ISteamNetworkingSockets* networkInterface, std::span<const HSteamNetConnection> connections);
+
+        std::vector<LaneStats> GetStats() const;
+
+    private:
+        struct LaneTotals
+        {
+            LaneStats Stats;
+            SteamNetworkingMicroseconds TotalQueueTime = 0;
+        };
+
+        mutable std::mutex m_Mutex;
+        std::vector<LaneTotals> m_Lanes;
+
+        // Network thread only
+        std::vector<SteamNetConnectionRealTimeLaneStatus_t> m_LaneStatus;
+    };
+
+} // namespace Utopia
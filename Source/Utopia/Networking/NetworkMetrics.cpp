@@ -0,0 +1,314 @@
+#include "NetworkMetrics.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace Utopia {
+
+    namespace {
+
+        void StoreMax(std::atomic<uint64_t>& target, uint64_t value)
+        {
+            uint64_t current = target.load(std::memory_order_relaxed);
+            while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void AppendLabelValue(std::ostringstream& out, std::string_view value)
+        {
+            for (char c : value)
+            {
+                switch (c)
+                {
+                case '\\': out << "\\\\"; break;
+                case '"':  out << "\\\""; break;
+                case '\n': out << "\\n"; break;
+                default:   out << c; break;
+                }
+            }
+        }
+
+        // Writes {a="1",b="2"} including an optional per-series label; nothing when there are no labels
+        void AppendLabels(std::ostringstream& out, const MetricsRegistry::Labels& labels, std::string_view extraName = {}, std::string_view extraValue = {})
+        {
+            if (labels.empty() && extraName.empty())
+                return;
+
+            out << '{';
+            bool first = true;
+            for (const auto& [name, value] : labels)
+            {
+                if (!first)
+                    out << ',';
+                out << name << "=\"";
+                AppendLabelValue(out, value);
+                out << '"';
+                first = false;
+            }
+
+            if (!extraName.empty())
+            {
+                if (!first)
+                    out << ',';
+                out << extraName << "=\"";
+                AppendLabelValue(out, extraValue);
+                out << '"';
+            }
+            out << '}';
+        }
+
+        void AppendHeader(std::ostringstream& out, std::string_view prefix, std::string_view name, std::string_view type, std::string_view help)
+        {
+            out << "# HELP " << prefix << '_' << name << ' ' << help << '\n';
+            out << "# TYPE " << prefix << '_' << name << ' ' << type << '\n';
+        }
+
+        template<typename T>
+        void AppendMetric(std::ostringstream& out, std::string_view prefix, std::string_view name, std::string_view type, std::string_view help,
+            const MetricsRegistry::Labels& labels, T value)
+        {
+            AppendHeader(out, prefix, name, type, help);
+            out << prefix << '_' << name;
+            AppendLabels(out, labels);
+            out << ' ' << value << '\n';
+        }
+
+    } // anonymous namespace
+
+    MetricsRegistry::MetricsRegistry()
+        : m_Connections(std::make_shared<const std::vector<ConnectionTelemetry>>())
+    {
+    }
+
+    void MetricsRegistry::AddReceived(uint64_t messages, uint64_t bytes) noexcept
+    {
+        m_MessagesReceived.fetch_add(messages, std::memory_order_relaxed);
+        m_BytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void MetricsRegistry::AddSent(uint64_t messages, uint64_t bytes) noexcept
+    {
+        m_MessagesSent.fetch_add(messages, std::memory_order_relaxed);
+        m_BytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void MetricsRegistry::AddSendFailures(uint64_t failures) noexcept
+    {
+        m_SendFailures.fetch_add(failures, std::memory_order_relaxed);
+    }
+
+    void MetricsRegistry::AddDropped(uint64_t messages) noexcept
+    {
+        m_MessagesDropped.fetch_add(messages, std::memory_order_relaxed);
+    }
+
+    void MetricsRegistry::AddCallbackTime(std::chrono::nanoseconds duration) noexcept
+    {
+        m_CallbackInvocations.fetch_add(1, std::memory_order_relaxed);
+        m_CallbackTimeNs.fetch_add(static_cast<uint64_t>(duration.count()), std::memory_order_relaxed);
+        StoreMax(m_MaxCallbackTimeNs, static_cast<uint64_t>(duration.count()));
+    }
+
+    void MetricsRegistry::AddDispatchQueued() noexcept
+    {
+        StoreMax(m_MaxDispatchQueueDepth, m_DispatchQueueDepth.fetch_add(1, std::memory_order_relaxed) + 1);
+    }
+
+    void MetricsRegistry::AddDispatchStarted(std::chrono::nanoseconds waitTime) noexcept
+    {
+        m_DispatchQueueDepth.fetch_sub(1, std::memory_order_relaxed);
+        m_DispatchesStarted.fetch_add(1, std::memory_order_relaxed);
+        m_DispatchWaitTimeNs.fetch_add(static_cast<uint64_t>(waitTime.count()), std::memory_order_relaxed);
+        StoreMax(m_MaxDispatchWaitTimeNs, static_cast<uint64_t>(waitTime.count()));
+    }
+
+    void MetricsRegistry::AddPollIteration(std::chrono::nanoseconds duration) noexcept
+    {
+        const uint64_t durationNs = static_cast<uint64_t>(duration.count());
+        m_PollIterations.fetch_add(1, std::memory_order_relaxed);
+        m_PollIterationTimeNs.fetch_add(durationNs, std::memory_order_relaxed);
+        StoreMax(m_MaxPollIterationTimeNs, durationNs);
+    }
+
+    void MetricsRegistry::AddCompression(HSteamNetConnection connection, CompressionDirection direction, uint64_t uncompressedBytes, uint64_t compressedBytes, std::chrono::nanoseconds duration)
+    {
+        const size_t index = static_cast<size_t>(direction);
+        const uint64_t durationNs = static_cast<uint64_t>(duration.count());
+
+        AtomicCompressionCounters& counters = m_Compression[index];
+        counters.Messages.fetch_add(1, std::memory_order_relaxed);
+        counters.UncompressedBytes.fetch_add(uncompressedBytes, std::memory_order_relaxed);
+        counters.CompressedBytes.fetch_add(compressedBytes, std::memory_order_relaxed);
+        counters.TimeNs.fetch_add(durationNs, std::memory_order_relaxed);
+
+        if (connection == k_HSteamNetConnection_Invalid)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_ConnectionCompressionMutex);
+        CompressionCounters& connectionCounters = m_ConnectionCompression[connection][index];
+        connectionCounters.Messages++;
+        connectionCounters.UncompressedBytes += uncompressedBytes;
+        connectionCounters.CompressedBytes += compressedBytes;
+        connectionCounters.TimeNs += durationNs;
+    }
+
+    void MetricsRegistry::PublishConnections(std::vector<ConnectionTelemetry> connections)
+    {
+        m_Connections.store(std::make_shared<const std::vector<ConnectionTelemetry>>(std::move(connections)), std::memory_order_release);
+    }
+
+    void MetricsRegistry::SampleConnections(ISteamNetworkingSockets* networkInterface, std::span<const HSteamNetConnection> connections)
+    {
+        std::vector<ConnectionTelemetry> samples;
+        samples.reserve(connections.size());
+
+        for (HSteamNetConnection connection : connections)
+        {
+            SteamNetConnectionRealTimeStatus_t status;
+            if (networkInterface->GetConnectionRealTimeStatus(connection, &status, 0, nullptr) != k_EResultOK)
+                continue;
+
+            ConnectionTelemetry& sample = samples.emplace_back();
+            sample.Connection = connection;
+            sample.Ping = status.m_nPing;
+            sample.LocalQuality = status.m_flConnectionQualityLocal;
+            sample.RemoteQuality = status.m_flConnectionQualityRemote;
+            sample.OutPacketsPerSecond = status.m_flOutPacketsPerSec;
+            sample.OutBytesPerSecond = status.m_flOutBytesPerSec;
+            sample.InPacketsPerSecond = status.m_flInPacketsPerSec;
+            sample.InBytesPerSecond = status.m_flInBytesPerSec;
+            sample.SendRateBytesPerSecond = status.m_nSendRateBytesPerSecond;
+            sample.PendingUnreliableBytes = status.m_cbPendingUnreliable;
+            sample.PendingReliableBytes = status.m_cbPendingReliable;
+            sample.SentUnackedReliableBytes = status.m_cbSentUnackedReliable;
+            sample.QueueTime = status.m_usecQueueTime;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_ConnectionCompressionMutex);
+            if (!m_ConnectionCompression.empty())
+            {
+                for (ConnectionTelemetry& sample : samples)
+                {
+                    const auto it = m_ConnectionCompression.find(sample.Connection);
+                    if (it == m_ConnectionCompression.end())
+                        continue;
+                    sample.Compression = it->second[static_cast<size_t>(CompressionDirection::Compress)];
+                    sample.Decompression = it->second[static_cast<size_t>(CompressionDirection::Decompress)];
+                }
+
+                std::vector<HSteamNetConnection> liveConnections(connections.begin(), connections.end());
+                std::sort(liveConnections.begin(), liveConnections.end());
+                std::erase_if(m_ConnectionCompression, [&liveConnections](const auto& entry)
+                    {
+                        return !std::binary_search(liveConnections.begin(), liveConnections.end(), entry.first);
+                    });
+            }
+        }
+
+        PublishConnections(std::move(samples));
+    }
+
+    MetricsCounters MetricsRegistry::GetCounters() const noexcept
+    {
+        MetricsCounters counters;
+        counters.MessagesReceived = m_MessagesReceived.load(std::memory_order_relaxed);
+        counters.BytesReceived = m_BytesReceived.load(std::memory_order_relaxed);
+        counters.MessagesSent = m_MessagesSent.load(std::memory_order_relaxed);
+        counters.BytesSent = m_BytesSent.load(std::memory_order_relaxed);
+        counters.SendFailures = m_SendFailures.load(std::memory_order_relaxed);
+        counters.MessagesDropped = m_MessagesDropped.load(std::memory_order_relaxed);
+        counters.CallbackInvocations = m_CallbackInvocations.load(std::memory_order_relaxed);
+        counters.CallbackTimeNs = m_CallbackTimeNs.load(std::memory_order_relaxed);
+        counters.MaxCallbackTimeNs = m_MaxCallbackTimeNs.load(std::memory_order_relaxed);
+        counters.DispatchQueueDepth = m_DispatchQueueDepth.load(std::memory_order_relaxed);
+        counters.MaxDispatchQueueDepth = m_MaxDispatchQueueDepth.load(std::memory_order_relaxed);
+        counters.DispatchesStarted = m_DispatchesStarted.load(std::memory_order_relaxed);
+        counters.DispatchWaitTimeNs = m_DispatchWaitTimeNs.load(std::memory_order_relaxed);
+        counters.MaxDispatchWaitTimeNs = m_MaxDispatchWaitTimeNs.load(std::memory_order_relaxed);
+        counters.PollIterations = m_PollIterations.load(std::memory_order_relaxed);
+        counters.PollIterationTimeNs = m_PollIterationTimeNs.load(std::memory_order_relaxed);
+        counters.MaxPollIterationTimeNs = m_MaxPollIterationTimeNs.load(std::memory_order_relaxed);
+
+        auto loadCompression = [](const AtomicCompressionCounters& source)
+            {
+                CompressionCounters result;
+                result.Messages = source.Messages.load(std::memory_order_relaxed);
+                result.UncompressedBytes = source.UncompressedBytes.load(std::memory_order_relaxed);
+                result.CompressedBytes = source.CompressedBytes.load(std::memory_order_relaxed);
+                result.TimeNs = source.TimeNs.load(std::memory_order_relaxed);
+                return result;
+            };
+        counters.Compression = loadCompression(m_Compression[static_cast<size_t>(CompressionDirection::Compress)]);
+        counters.Decompression = loadCompression(m_Compression[static_cast<size_t>(CompressionDirection::Decompress)]);
+        return counters;
+    }
+
+    std::string MetricsRegistry::ExportPrometheus(std::string_view metricPrefix) const
+    {
+        const MetricsCounters counters = GetCounters();
+        const ConnectionSnapshot connections = GetConnections();
+
+        std::ostringstream out;
+
+        AppendMetric(out, metricPrefix, "messages_received_total", "counter", "Messages received.", m_Labels, counters.MessagesReceived);
+        AppendMetric(out, metricPrefix, "bytes_received_total", "counter", "Payload bytes received.", m_Labels, counters.BytesReceived);
+        AppendMetric(out, metricPrefix, "messages_sent_total", "counter", "Messages accepted by SendMessages.", m_Labels, counters.MessagesSent);
+        AppendMetric(out, metricPrefix, "bytes_sent_total", "counter", "Payload bytes accepted by SendMessages.", m_Labels, counters.BytesSent);
+        AppendMetric(out, metricPrefix, "send_failures_total", "counter", "Messages rejected by SendMessages.", m_Labels, counters.SendFailures);
+        AppendMetric(out, metricPrefix, "messages_dropped_total", "counter", "Unreliable messages dropped or superseded for congested connections.", m_Labels, counters.MessagesDropped);
+        AppendMetric(out, metricPrefix, "callback_invocations_total", "counter", "Receive callback dispatches.", m_Labels, counters.CallbackInvocations);
+        AppendMetric(out, metricPrefix, "callback_seconds_total", "counter", "Time spent in receive callbacks.", m_Labels, static_cast<double>(counters.CallbackTimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "callback_max_seconds", "gauge", "Longest single receive callback dispatch.", m_Labels, static_cast<double>(counters.MaxCallbackTimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "dispatch_queue_depth", "gauge", "Callbacks waiting on the dispatch executor.", m_Labels, counters.DispatchQueueDepth);
+        AppendMetric(out, metricPrefix, "dispatch_queue_depth_max", "gauge", "Most callbacks ever waiting on the dispatch executor.", m_Labels, counters.MaxDispatchQueueDepth);
+        AppendMetric(out, metricPrefix, "dispatches_total", "counter", "Callbacks started by the dispatch executor.", m_Labels, counters.DispatchesStarted);
+        AppendMetric(out, metricPrefix, "dispatch_wait_seconds_total", "counter", "Time callbacks waited on the dispatch executor.", m_Labels, static_cast<double>(counters.DispatchWaitTimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "dispatch_wait_max_seconds", "gauge", "Longest wait of a callback on the dispatch executor.", m_Labels, static_cast<double>(counters.MaxDispatchWaitTimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "poll_iterations_total", "counter", "Network loop iterations.", m_Labels, counters.PollIterations);
+        AppendMetric(out, metricPrefix, "poll_iteration_seconds_total", "counter", "Time network loop iterations spent working.", m_Labels, static_cast<double>(counters.PollIterationTimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "poll_iteration_max_seconds", "gauge", "Longest network loop iteration.", m_Labels, static_cast<double>(counters.MaxPollIterationTimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "compressed_messages_total", "counter", "Outgoing payloads run through the codec.", m_Labels, counters.Compression.Messages);
+        AppendMetric(out, metricPrefix, "compression_input_bytes_total", "counter", "Outgoing payload bytes before compression.", m_Labels, counters.Compression.UncompressedBytes);
+        AppendMetric(out, metricPrefix, "compression_output_bytes_total", "counter", "Outgoing payload bytes after compression.", m_Labels, counters.Compression.CompressedBytes);
+        AppendMetric(out, metricPrefix, "compression_seconds_total", "counter", "Time spent compressing.", m_Labels, static_cast<double>(counters.Compression.TimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "decompressed_messages_total", "counter", "Incoming payloads that were compressed.", m_Labels, counters.Decompression.Messages);
+        AppendMetric(out, metricPrefix, "decompression_output_bytes_total", "counter", "Incoming payload bytes after decompression.", m_Labels, counters.Decompression.UncompressedBytes);
+        AppendMetric(out, metricPrefix, "decompression_input_bytes_total", "counter", "Incoming payload bytes as received.", m_Labels, counters.Decompression.CompressedBytes);
+        AppendMetric(out, metricPrefix, "decompression_seconds_total", "counter", "Time spent decompressing.", m_Labels, static_cast<double>(counters.Decompression.TimeNs) / 1e9);
+        AppendMetric(out, metricPrefix, "connections", "gauge", "Connections in the latest telemetry sample.", m_Labels, connections->size());
+
+        // One series per connection for each real-time status field
+        auto appendConnectionMetric = [&](std::string_view name, std::string_view help, auto getValue, std::string_view type = "gauge")
+            {
+                AppendHeader(out, metricPrefix, name, type, help);
+                for (const ConnectionTelemetry& connection : *connections)
+                {
+                    out << metricPrefix << '_' << name;
+                    AppendLabels(out, m_Labels, "connection", std::to_string(connection.Connection));
+                    out << ' ' << getValue(connection) << '\n';
+                }
+            };
+
+        appendConnectionMetric("connection_ping_seconds", "Round-trip ping.", [](const ConnectionTelemetry& c) { return c.Ping / 1000.0; });
+        appendConnectionMetric("connection_quality_local", "Fraction of packets delivered from the peer, -1 if unknown.", [](const ConnectionTelemetry& c) { return c.LocalQuality; });
+        appendConnectionMetric("connection_quality_remote", "Fraction of packets delivered to the peer, -1 if unknown.", [](const ConnectionTelemetry& c) { return c.RemoteQuality; });
+        appendConnectionMetric("connection_out_packets_per_second", "Outgoing packet rate.", [](const ConnectionTelemetry& c) { return c.OutPacketsPerSecond; });
+        appendConnectionMetric("connection_out_bytes_per_second", "Outgoing byte rate.", [](const ConnectionTelemetry& c) { return c.OutBytesPerSecond; });
+        appendConnectionMetric("connection_in_packets_per_second", "Incoming packet rate.", [](const ConnectionTelemetry& c) { return c.InPacketsPerSecond; });
+        appendConnectionMetric("connection_in_bytes_per_second", "Incoming byte rate.", [](const ConnectionTelemetry& c) { return c.InBytesPerSecond; });
+        appendConnectionMetric("connection_send_rate_bytes_per_second", "Estimated send capacity.", [](const ConnectionTelemetry& c) { return c.SendRateBytesPerSecond; });
+        appendConnectionMetric("connection_pending_unreliable_bytes", "Unreliable bytes queued to send.", [](const ConnectionTelemetry& c) { return c.PendingUnreliableBytes; });
+        appendConnectionMetric("connection_pending_reliable_bytes", "Reliable bytes queued to send.", [](const ConnectionTelemetry& c) { return c.PendingReliableBytes; });
+        appendConnectionMetric("connection_unacked_reliable_bytes", "Reliable bytes sent but not yet acknowledged.", [](const ConnectionTelemetry& c) { return c.SentUnackedReliableBytes; });
+        appendConnectionMetric("connection_queue_seconds", "Predicted wait for a message queued now.", [](const ConnectionTelemetry& c) { return c.QueueTime / 1e6; });
+        appendConnectionMetric("connection_compression_ratio", "Uncompressed over compressed size of payloads sent.", [](const ConnectionTelemetry& c) { return c.Compression.GetRatio(); });
+        appendConnectionMetric("connection_compression_seconds_total", "Time spent compressing payloads sent.", [](const ConnectionTelemetry& c) { return c.Compression.TimeNs / 1e9; }, "counter");
+        appendConnectionMetric("connection_decompression_ratio", "Uncompressed over compressed size of payloads received.", [](const ConnectionTelemetry& c) { return c.Decompression.GetRatio(); });
+        appendConnectionMetric("connection_decompression_seconds_total", "Time spent decompressing payloads received.", [](const ConnectionTelemetry& c) { return c.Decompression.TimeNs / 1e9; }, "counter");
+
+        return out.str();
+    }
+
+} // namespace Utopia
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <steam/steamnetworkingsockets.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Utopia {
+
+    enum class CompressionDirection
+    {
+        Compress = 0,
+        Decompress
+    };
+
+    // Work done by the payload codec in one direction. Payloads that were tried but did not shrink
+    // count with their compressed size equal to their uncompressed size.
+    struct CompressionCounters
+    {
+        uint64_t Messages = 0;
+        uint64_t UncompressedBytes = 0;
+        uint64_t CompressedBytes = 0;
+        uint64_t TimeNs = 0;
+
+        // Above 1 means compression saved bandwidth
+        double GetRatio() const { return CompressedBytes ? static_cast<double>(UncompressedBytes) / static_cast<double>(CompressedBytes) : 1.0; }
+    };
+
+    // One GetConnectionRealTimeStatus sample of a single connection
+    struct ConnectionTelemetry
+    {
+        HSteamNetConnection Connection = k_HSteamNetConnection_Invalid;
+
+        int Ping = 0; // Milliseconds
+        // Fraction of packets delivered, 0..1, as seen by us and as reported by the peer. -1 if unknown.
+        float LocalQuality = -1.0f;
+        float RemoteQuality = -1.0f;
+
+        float OutPacketsPerSecond = 0.0f;
+        float OutBytesPerSecond = 0.0f;
+        float InPacketsPerSecond = 0.0f;
+        float InBytesPerSecond = 0.0f;
+        int SendRateBytesPerSecond = 0;
+
+        int PendingUnreliableBytes = 0;
+        int PendingReliableBytes = 0;
+        int SentUnackedReliableBytes = 0;
+        SteamNetworkingMicroseconds QueueTime = 0;
+
+        // Totals since the connection was opened; sends fanned out to many clients are compressed once and not counted here
+        CompressionCounters Compression;
+        CompressionCounters Decompression;
+    };
+
+    struct MetricsCounters
+    {
+        uint64_t MessagesReceived = 0;
+        uint64_t BytesReceived = 0;
+        uint64_t MessagesSent = 0;
+        uint64_t BytesSent = 0;
+        uint64_t SendFailures = 0;
+        // Unreliable messages dropped or superseded because their connection was congested
+        uint64_t MessagesDropped = 0;
+
+        // Time spent inside the user's receive callbacks
+        uint64_t CallbackInvocations = 0;
+        uint64_t CallbackTimeNs = 0;
+        uint64_t MaxCallbackTimeNs = 0;
+
+        // Callbacks handed to a dispatch executor: how many wait to run now and at most, and how long
+        // they waited before their handler started. A growing queue points at a slow handler.
+        uint64_t DispatchQueueDepth = 0;
+        uint64_t MaxDispatchQueueDepth = 0;
+        uint64_t DispatchesStarted = 0;
+        uint64_t DispatchWaitTimeNs = 0;
+        uint64_t MaxDispatchWaitTimeNs = 0;
+
+        // Time each network loop iteration spent working, excluding the wait
+        uint64_t PollIterations = 0;
+        uint64_t PollIterationTimeNs = 0;
+        uint64_t MaxPollIterationTimeNs = 0;
+
+        CompressionCounters Compression;
+        CompressionCounters Decompression;
+    };
+
+    // Module-level counters and the latest per-connection telemetry of one Server or Client.
+    // Writers are the network threads; every read is lock-free and safe from any thread.
+    class MetricsRegistry
+    {
+    public:
+        using Labels = std::vector<std::pair<std::string, std::string>>;
+        using ConnectionSnapshot = std::shared_ptr<const std::vector<ConnectionTelemetry>>;
+
+    public:
+        MetricsRegistry();
+
+        MetricsRegistry(const MetricsRegistry&) = delete;
+        MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+        void AddReceived(uint64_t messages, uint64_t bytes) noexcept;
+        void AddSent(uint64_t messages, uint64_t bytes) noexcept;
+        void AddSendFailures(uint64_t failures) noexcept;
+        void AddDropped(uint64_t messages) noexcept;
+        void AddCallbackTime(std::chrono::nanoseconds duration) noexcept;
+        void AddDispatchQueued() noexcept;
+        void AddDispatchStarted(std::chrono::nanoseconds waitTime) noexcept;
+        void AddPollIteration(std::chrono::nanoseconds duration) noexcept;
+        // Pass k_HSteamNetConnection_Invalid for work not tied to one connection, such as broadcasts
+        void AddCompression(HSteamNetConnection connection, CompressionDirection direction, uint64_t uncompressedBytes, uint64_t compressedBytes, std::chrono::nanoseconds duration);
+
+        // Replaces the per-connection telemetry as a whole
+        void PublishConnections(std::vector<ConnectionTelemetry> connections);
+
+        // Polls GetConnectionRealTimeStatus for every connection and publishes the result.
+        // Compression totals of connections missing from the list are forgotten.
+        void SampleConnections(ISteamNetworkingSockets* networkInterface, std::span<const HSteamNetConnection> connections);
+
+        MetricsCounters GetCounters() const noexcept;
+        ConnectionSnapshot GetConnections() const { return m_Connections.load(std::memory_order_acquire); }
+
+        // Labels attached to every exported series, e.g. {"role", "server"}. Set before the network thread starts.
+        void SetLabels(Labels labels) { m_Labels = std::move(labels); }
+
+        // Prometheus text exposition format (version 0.0.4)
+        std::string ExportPrometheus(std::string_view metricPrefix = "utopia_networking") const;
+
+    private:
+        std::atomic<uint64_t> m_MessagesReceived{ 0 };
+        std::atomic<uint64_t> m_BytesReceived{ 0 };
+        std::atomic<uint64_t> m_MessagesSent{ 0 };
+        std::atomic<uint64_t> m_BytesSent{ 0 };
+        std::atomic<uint64_t> m_SendFailures{ 0 };
+        std::atomic<uint64_t> m_MessagesDropped{ 0 };
+        std::atomic<uint64_t> m_CallbackInvocations{ 0 };
+        std::atomic<uint64_t> m_CallbackTimeNs{ 0 };
+        std::atomic<uint64_t> m_MaxCallbackTimeNs{ 0 };
+        std::atomic<uint64_t> m_DispatchQueueDepth{ 0 };
+        std::atomic<uint64_t> m_MaxDispatchQueueDepth{ 0 };
+        std::atomic<uint64_t> m_DispatchesStarted{ 0 };
+        std::atomic<uint64_t> m_DispatchWaitTimeNs{ 0 };
+        std::atomic<uint64_t> m_MaxDispatchWaitTimeNs{ 0 };
+        std::atomic<uint64_t> m_PollIterations{ 0 };
+        std::atomic<uint64_t> m_PollIterationTimeNs{ 0 };
+        std::atomic<uint64_t> m_MaxPollIterationTimeNs{ 0 };
+
+        struct AtomicCompressionCounters
+        {
+            std::atomic<uint64_t> Messages{ 0 };
+            std::atomic<uint64_t> UncompressedBytes{ 0 };
+            std::atomic<uint64_t> CompressedBytes{ 0 };
+            std::atomic<uint64_t> TimeNs{ 0 };
+        };
+        std::array<AtomicCompressionCounters, 2> m_Compression;
+
+        // Compression is rare next to the per-message counters above, so per-connection totals take a lock
+        std::mutex m_ConnectionCompressionMutex;
+        std::unordered_map<HSteamNetConnection, std::array<CompressionCounters, 2>> m_ConnectionCompression;
+
+        std::atomic<ConnectionSnapshot> m_Connections;
+        Labels m_Labels;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,79 @@
+#include "NetworkWaiter.hpp"
+
+#include "NetworkingUtils.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <thread>
+
+namespace Utopia {
+
+    void NetworkWaiter::Configure(const NetworkThreadConfig& config)
+    {
+        m_Config = config;
+        m_IdleIterations = 0;
+
+        if (m_Config.Policy == WaitPolicy::BusyPoll && m_Config.PinnedCore >= 0)
+        {
+            if (!Utils::SetCurrentThreadAffinity(m_Config.PinnedCore))
+            {
+                UT_WARN_TAG("NETWORK", "Could not pin network thread to core {}", m_Config.PinnedCore);
+            }
+        }
+    }
+
+    void NetworkWaiter::Wait(bool didWork)
+    {
+        if (didWork)
+        {
+            m_IdleIterations = 0;
+            return;
+        }
+
+        switch (m_Config.Policy)
+        {
+        case WaitPolicy::Blocking:
+            Park();
+            break;
+
+        case WaitPolicy::Adaptive:
+            if (m_IdleIterations < m_Config.SpinIterations)
+            {
+                m_IdleIterations++;
+                if (!m_Pending.exchange(false))
+                    std::this_thread::yield();
+            }
+            else
+            {
+                Park();
+            }
+            break;
+
+        case WaitPolicy::BusyPoll:
+            m_Pending.store(false, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    void NetworkWaiter::Notify() noexcept
+    {
+        m_Pending.store(true);
+        if (m_Parked.load())
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Condition.notify_one();
+        }
+    }
+
+    void NetworkWaiter::Park()
+    {
+        // m_Parked is published before the predicate is checked, and Notify() publishes m_Pending
+        // before reading m_Parked, so one side always observes the other and no wakeup is lost.
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Parked.store(true);
+        m_Condition.wait_for(lock, m_Config.MaxWait, [this]() { return m_Pending.load(); });
+        m_Parked.store(false);
+        m_Pending.store(false);
+    }
+
+} // namespace Utopia
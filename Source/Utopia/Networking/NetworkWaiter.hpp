@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace Utopia {
+
+    // How the network thread idles between poll iterations
+    enum class WaitPolicy
+    {
+        // Park until another thread signals work (send, stop) or MaxWait elapses
+        Blocking = 0,
+        // Spin for SpinIterations empty iterations, then park like Blocking
+        Adaptive,
+        // Never park; burn a core (optionally pinned) for the lowest possible latency
+        BusyPoll
+    };
+
+    struct NetworkThreadConfig
+    {
+        WaitPolicy Policy = WaitPolicy::Blocking;
+
+        // GameNetworkingSockets receives on its own service thread and cannot wake us,
+        // so this is the worst-case delay before an inbound message is noticed.
+        std::chrono::microseconds MaxWait{ 1000 };
+
+        // Adaptive only: empty iterations to spin through before parking
+        uint32_t SpinIterations = 2000;
+
+        // BusyPoll only: CPU core to pin the network thread to, -1 to leave affinity alone
+        int PinnedCore = -1;
+    };
+
+    // Idles a network thread according to its NetworkThreadConfig.
+    // Any thread may call Notify() to cut the current wait short.
+    class NetworkWaiter
+    {
+    public:
+        NetworkWaiter() = default;
+
+        NetworkWaiter(const NetworkWaiter&) = delete;
+        NetworkWaiter& operator=(const NetworkWaiter&) = delete;
+
+        // Must be called from the network thread before the first Wait()
+        void Configure(const NetworkThreadConfig& config);
+
+        // Called once per loop iteration. didWork resets the adaptive spin budget.
+        void Wait(bool didWork);
+
+        // Wakes the network thread. Only touches the mutex when the thread is actually parked.
+        void Notify() noexcept;
+
+    private:
+        void Park();
+
+    private:
+        NetworkThreadConfig m_Config;
+        uint32_t m_IdleIterations = 0;
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::atomic_bool m_Pending{ false };
+        std::atomic_bool m_Parked{ false };
+    };
+
+} // namespace Utopia
@@ -0,0 +1,170 @@
+#include "NetworkingRuntime.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <cassert>
+#include <format>
+
+namespace Utopia {
+
+    std::mutex NetworkingRuntime::s_LifetimeMutex;
+    uint32_t NetworkingRuntime::s_RefCount = 0;
+    NetworkingRuntime* NetworkingRuntime::s_Runtime = nullptr;
+
+    void ConnectionStatusInbox::Push(const SteamNetConnectionStatusChangedCallback_t& status)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Pending.push_back(status);
+    }
+
+    int ConnectionStatusInbox::Drain(const std::function<void(SteamNetConnectionStatusChangedCallback_t*)>& handler)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Pending.empty())
+                return 0;
+            std::swap(m_Pending, m_Processing);
+        }
+
+        for (SteamNetConnectionStatusChangedCallback_t& status : m_Processing)
+            handler(&status);
+
+        const int statusCount = static_cast<int>(m_Processing.size());
+        m_Processing.clear();
+        return statusCount;
+    }
+
+    NetworkingRuntime* NetworkingRuntime::Acquire(std::string& errorMessage)
+    {
+        std::lock_guard<std::mutex> lock(s_LifetimeMutex);
+        if (s_RefCount > 0)
+        {
+            s_RefCount++;
+            return s_Runtime;
+        }
+
+        SteamDatagramErrMsg errMsg{};
+        if (!GameNetworkingSockets_Init(nullptr, errMsg))
+        {
+            errorMessage = fmt::format("GameNetworkingSockets_Init failed: {}", errMsg);
+            return nullptr;
+        }
+
+        s_Runtime = new NetworkingRuntime();
+        s_Runtime->m_Interface = SteamNetworkingSockets();
+        assert(s_Runtime->m_Interface && "SteamNetworkingSockets() returned nullptr!");
+
+        // One global callback for every socket; RouteConnectionStatus() finds the owner
+        SteamNetworkingUtils()->SetGlobalCallback_SteamNetConnectionStatusChanged(ConnectionStatusChangedCallback);
+
+        s_RefCount = 1;
+        UT_INFO_TAG("NETWORK", "GameNetworkingSockets initialized");
+        return s_Runtime;
+    }
+
+    void NetworkingRuntime::Release()
+    {
+        std::lock_guard<std::mutex> lock(s_LifetimeMutex);
+        assert(s_RefCount > 0 && "NetworkingRuntime::Release() without a matching Acquire()");
+        if (s_RefCount == 0 || --s_RefCount > 0)
+            return;
+
+        GameNetworkingSockets_Kill();
+        delete s_Runtime;
+        s_Runtime = nullptr;
+        UT_INFO_TAG("NETWORK", "GameNetworkingSockets shut down");
+    }
+
+    NetworkingRuntime::ListenerID NetworkingRuntime::AddListener(StatusChangedFunction function)
+    {
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+        const ListenerID listener = m_NextListenerID++;
+        m_Listeners.emplace(listener, std::move(function));
+        return listener;
+    }
+
+    void NetworkingRuntime::RemoveListener(ListenerID listener)
+    {
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+        m_Listeners.erase(listener);
+        std::erase_if(m_ListenSockets, [listener](const auto& entry) { return entry.second == listener; });
+        std::erase_if(m_Connections, [listener](const auto& entry) { return entry.second == listener; });
+    }
+
+    HSteamListenSocket NetworkingRuntime::CreateListenSocketIP(const SteamNetworkingIPAddr& address, ListenerID listener, std::span<const SteamNetworkingConfigValue_t> options)
+    {
+        // Registered under the lock so no status change can slip past before the socket is known
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+        const HSteamListenSocket socket = m_Interface->CreateListenSocketIP(address, static_cast<int>(options.size()), options.data());
+        if (socket != k_HSteamListenSocket_Invalid)
+            m_ListenSockets[socket] = listener;
+        return socket;
+    }
+
+    HSteamNetConnection NetworkingRuntime::ConnectByIPAddress(const SteamNetworkingIPAddr& address, ListenerID listener, std::span<const SteamNetworkingConfigValue_t> options)
+    {
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+        const HSteamNetConnection connection = m_Interface->ConnectByIPAddress(address, static_cast<int>(options.size()), options.data());
+        if (connection != k_HSteamNetConnection_Invalid)
+            m_Connections[connection] = listener;
+        return connection;
+    }
+
+    void NetworkingRuntime::UnregisterListenSocket(HSteamListenSocket socket)
+    {
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+        m_ListenSockets.erase(socket);
+    }
+
+    void NetworkingRuntime::UnregisterConnection(HSteamNetConnection connection)
+    {
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+        m_Connections.erase(connection);
+    }
+
+    void NetworkingRuntime::RunCallbacks()
+    {
+        std::unique_lock<std::mutex> lock(m_CallbackMutex, std::try_to_lock);
+        if (!lock.owns_lock())
+            return;
+
+        m_Interface->RunCallbacks();
+    }
+
+    void NetworkingRuntime::ConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* status)
+    {
+        // Only ever invoked from RunCallbacks(), so the runtime is alive
+        if (s_Runtime)
+        {
+            s_Runtime->RouteConnectionStatus(*status);
+        }
+    }
+
+    void NetworkingRuntime::RouteConnectionStatus(const SteamNetConnectionStatusChangedCallback_t& status)
+    {
+        std::lock_guard<std::mutex> lock(m_RoutingMutex);
+
+        ListenerID listener = k_InvalidListener;
+        if (auto it = m_Connections.find(status.m_hConn); it != m_Connections.end())
+        {
+            listener = it->second;
+        }
+        else if (auto socketIt = m_ListenSockets.find(status.m_info.m_hListenSocket); socketIt != m_ListenSockets.end())
+        {
+            // First we hear of an incoming connection; it belongs to whoever owns the listen socket
+            listener = socketIt->second;
+            m_Connections.emplace(status.m_hConn, listener);
+        }
+
+        // We also get callbacks for connections we destroyed; those have no owner anymore
+        auto listenerIt = m_Listeners.find(listener);
+        if (listenerIt == m_Listeners.end())
+            return;
+
+        if (status.m_info.m_eState == k_ESteamNetworkingConnectionState_None)
+            m_Connections.erase(status.m_hConn);
+
+        listenerIt->second(status);
+    }
+
+} // namespace Utopia
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <steam/steamnetworkingsockets.h>
+#include <steam/isteamnetworkingutils.h>
+#ifndef STEAMNETWORKINGSOCKETS_OPENSOURCE
+#include <steam/steam_api.h>
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    // Status changes routed from whichever thread ran the library callbacks, queued for the owner's thread
+    class ConnectionStatusInbox
+    {
+    public:
+        void Push(const SteamNetConnectionStatusChangedCallback_t& status);
+
+        // Hands every queued status change to handler on the calling thread. Returns how many were handled.
+        int Drain(const std::function<void(SteamNetConnectionStatusChangedCallback_t*)>& handler);
+
+    private:
+        std::mutex m_Mutex;
+        std::vector<SteamNetConnectionStatusChangedCallback_t> m_Pending;
+        std::vector<SteamNetConnectionStatusChangedCallback_t> m_Processing;
+    };
+
+    // Process-wide GameNetworkingSockets lifetime and connection status routing.
+    // The library is initialized by the first Acquire() and shut down by the last Release(), so any
+    // number of Servers and Clients can share one process. Hold a reference of your own across
+    // reconnects to keep the library from being torn down and re-initialized in between.
+    class NetworkingRuntime
+    {
+    public:
+        using ListenerID = uint32_t;
+        // Called on whichever thread runs callbacks; push into a ConnectionStatusInbox and return
+        using StatusChangedFunction = std::function<void(const SteamNetConnectionStatusChangedCallback_t&)>;
+
+        static constexpr ListenerID k_InvalidListener = 0;
+
+    public:
+        // Returns nullptr if the library failed to initialize, with the reason in errorMessage.
+        // Every successful Acquire() must be paired with one Release().
+        static NetworkingRuntime* Acquire(std::string& errorMessage);
+        static void Release();
+
+        NetworkingRuntime(const NetworkingRuntime&) = delete;
+        NetworkingRuntime& operator=(const NetworkingRuntime&) = delete;
+
+        ISteamNetworkingSockets* GetInterface() const { return m_Interface; }
+
+        ListenerID AddListener(StatusChangedFunction function);
+        // Also forgets every socket and connection routed to this listener. Once this returns
+        // the function is never called again.
+        void RemoveListener(ListenerID listener);
+
+        // Create sockets with their status changes routed to listener. Connections accepted on a
+        // listen socket are routed to the socket's listener.
+        HSteamListenSocket CreateListenSocketIP(const SteamNetworkingIPAddr& address, ListenerID listener, std::span<const SteamNetworkingConfigValue_t> options = {});
+        HSteamNetConnection ConnectByIPAddress(const SteamNetworkingIPAddr& address, ListenerID listener, std::span<const SteamNetworkingConfigValue_t> options = {});
+
+        // Call after closing a socket or connection so its handle can be reused
+        void UnregisterListenSocket(HSteamListenSocket socket);
+        void UnregisterConnection(HSteamNetConnection connection);
+
+        // Runs the library callbacks. Only one thread does so at a time; others return immediately,
+        // since their status changes are routed to them either way.
+        void RunCallbacks();
+
+    private:
+        NetworkingRuntime() = default;
+
+        static void ConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* status);
+        void RouteConnectionStatus(const SteamNetConnectionStatusChangedCallback_t& status);
+
+    private:
+        ISteamNetworkingSockets* m_Interface = nullptr;
+
+        std::mutex m_CallbackMutex;
+
+        // Guards the maps below. Held while dispatching, which is what makes RemoveListener() final.
+        std::mutex m_RoutingMutex;
+        ListenerID m_NextListenerID = 1;
+        std::unordered_map<ListenerID, StatusChangedFunction> m_Listeners;
+        std::unordered_map<HSteamListenSocket, ListenerID> m_ListenSockets;
+        std::unordered_map<HSteamNetConnection, ListenerID> m_Connections;
+
+        static std::mutex s_LifetimeMutex;
+        static uint32_t s_RefCount;
+        static NetworkingRuntime* s_Runtime;
+    };
+
+} // namespace Utopia
@@ -16,12 +16,6 @@ namespace Utopia::Utils {
         return address.ParseString(ipAddressStr.c_str());
     }
 
-    [[nodiscard]] std::optional<std::string> ResolveDomainName(std::string_view name) noexcept
-    {
-        // TODO (Implement): Add actual domain resolution logic
-        //                   Ensure error handling and cross-platform compatibility
-        //                   For now, return std::nullopt to indicate unimplemented functionality
-        return std::nullopt;
-    }
+    // ResolveDomainName and ResolveHostAddresses are implemented per platform
 
 } // namespace Utopia::Utils
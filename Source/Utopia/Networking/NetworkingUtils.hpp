@@ -1,8 +1,11 @@
 #pragma once
 
+#include <steam/steamnetworkingtypes.h>
+
 #include <string>
 #include <string_view>
 #include <optional>
+#include <vector>
 
 namespace Utopia::Utils {
 
@@ -13,4 +16,12 @@ namespace Utopia::Utils {
     // Returns std::nullopt if resolution fails
     [[nodiscard]] std::optional<std::string> ResolveDomainName(std::string_view name) noexcept;
 
+    // Blocking lookup of every IPv4 and IPv6 address of a host name, in resolver order and with port 0.
+    // Returns false with the reason in outError if nothing was found. Prefer DnsResolver off the calling thread.
+    [[nodiscard]] bool ResolveHostAddresses(std::string_view name, std::vector<SteamNetworkingIPAddr>& outAddresses, std::string& outError) noexcept;
+
+    // Pins the calling thread to a single CPU core
+    // Returns false if the platform rejected the request
+    [[nodiscard]] bool SetCurrentThreadAffinity(int core) noexcept;
+
 } // namespace Utopia::Utils
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <concepts>
+
+namespace Utopia {
+
+    // How a message is sent, mirroring the library's k_nSteamNetworkingSend_* bits. Combine with |,
+    // e.g. SendFlags::Reliable | SendFlags::NoNagle.
+    // Implicitly constructible from the `reliable` bool every send function used to take, and from a bool
+    // only: a raw k_nSteamNetworkingSend_* int or a pointer would otherwise convert through it. Use FromValue().
+    class SendFlags
+    {
+    public:
+        // Reliable, batched with Nagle's delay
+        constexpr SendFlags() = default;
+        template<std::same_as<bool> Bool>
+        constexpr SendFlags(Bool reliable)
+            : m_Value(reliable ? k_nSteamNetworkingSend_Reliable : k_nSteamNetworkingSend_Unreliable) {}
+
+        static constexpr SendFlags FromValue(int value) { SendFlags flags; flags.m_Value = value; return flags; }
+
+        constexpr int GetValue() const { return m_Value; }
+
+        constexpr bool IsReliable() const { return (m_Value & k_nSteamNetworkingSend_Reliable) != 0; }
+        // Skips Nagle's delay, so the message goes out with the next packet rather than waiting to be batched
+        constexpr bool IsNoNagle() const { return (m_Value & k_nSteamNetworkingSend_NoNagle) != 0; }
+
+        constexpr SendFlags operator|(SendFlags other) const { return FromValue(m_Value | other.m_Value); }
+        constexpr SendFlags& operator|=(SendFlags other) { m_Value |= other.m_Value; return *this; }
+        constexpr bool operator==(const SendFlags& other) const = default;
+
+        static const SendFlags Unreliable;
+        static const SendFlags Reliable;
+
+        // Send without waiting for more data to batch with
+        static const SendFlags NoNagle;
+        // Unreliable only: drop the message rather than queue it if it cannot go out right away. Implies NoNagle.
+        static const SendFlags NoDelay;
+        // Do the send work on the thread that calls SendMessages instead of the library's service thread.
+        // Sends are flushed by the network thread, so that is the thread that does the work.
+        static const SendFlags UseCurrentThread;
+
+        static const SendFlags UnreliableNoNagle;
+        static const SendFlags UnreliableNoDelay;
+        static const SendFlags ReliableNoNagle;
+
+    private:
+        int m_Value = k_nSteamNetworkingSend_Reliable;
+    };
+
+    inline constexpr SendFlags SendFlags::Unreliable = SendFlags::FromValue(k_nSteamNetworkingSend_Unreliable);
+    inline constexpr SendFlags SendFlags::Reliable = SendFlags::FromValue(k_nSteamNetworkingSend_Reliable);
+    inline constexpr SendFlags SendFlags::NoNagle = SendFlags::FromValue(k_nSteamNetworkingSend_NoNagle);
+    inline constexpr SendFlags SendFlags::NoDelay = SendFlags::FromValue(k_nSteamNetworkingSend_NoDelay | k_nSteamNetworkingSend_NoNagle);
+    inline constexpr SendFlags SendFlags::UseCurrentThread = SendFlags::FromValue(k_nSteamNetworkingSend_UseCurrentThread);
+    inline constexpr SendFlags SendFlags::UnreliableNoNagle = SendFlags::FromValue(k_nSteamNetworkingSend_UnreliableNoNagle);
+    inline constexpr SendFlags SendFlags::UnreliableNoDelay = SendFlags::FromValue(k_nSteamNetworkingSend_UnreliableNoDelay);
+    inline constexpr SendFlags SendFlags::ReliableNoNagle = SendFlags::FromValue(k_nSteamNetworkingSend_ReliableNoNagle);
+
+} // namespace Utopia
@@ -1,17 +1,51 @@
 #include "Server.hpp"
 
+#include "SharedPayload.hpp"
+
 #include "Utopia/Core/Log.hpp"
 #include "Utopia/Core/Buffer.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cassert>
+#include <cstring>
 #include <format>
 #include <iostream>
+#include <utility>
 
 namespace Utopia {
 
-    // Can only have one server instance per-process
-    Server* Server::s_Instance = nullptr;
+    namespace {
+
+        // Connection user data packs the owning worker above the client's registry slot
+        constexpr int64 PackConnectionUserData(uint32_t workerIndex, uint32_t slot)
+        {
+            return static_cast<int64>((static_cast<uint64_t>(workerIndex) << 32) | slot);
+        }
+
+        constexpr uint32_t UnpackWorkerIndex(int64 userData)
+        {
+            return static_cast<uint32_t>(static_cast<uint64_t>(userData) >> 32);
+        }
+
+        constexpr uint32_t UnpackSlot(int64 userData)
+        {
+            return static_cast<uint32_t>(static_cast<uint64_t>(userData));
+        }
+
+        uint32_t HashRemoteAddress(const SteamNetworkingIPAddr& address)
+        {
+            // FNV-1a over the IP only; the port changes on every reconnect
+            uint32_t hash = 2166136261u;
+            for (uint8 byte : address.m_ipv6)
+            {
+                hash ^= byte;
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+    } // anonymous namespace
 
     Server::Server(int port)
         : m_Port(port)
@@ -40,89 +74,251 @@ namespace Utopia {
             return;
         }
 
+        // If an old thread is still around, join it before starting a new one
+        if (m_NetworkThread.joinable())
+        {
+            m_NetworkThread.join();
+        }
+
+        m_CompressionConfig = m_PendingCompressionConfig;
+
+        const uint32_t workerCount = m_WorkerConfig.WorkerCount > 0 ? m_WorkerConfig.WorkerCount : 1;
+        m_Workers.clear();
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            auto worker = std::make_unique<Worker>();
+            worker->Index = i;
+            worker->ReceiveBuffer.assign(m_ReceiveBatchSize, nullptr);
+            worker->ReceivedBatch.reserve(m_ReceiveBatchSize);
+            if (m_CompressionConfig.IsEnabled())
+                worker->DecompressBuffers.resize(m_ReceiveBatchSize);
+            m_Workers.push_back(std::move(worker));
+        }
+        m_NextWorker = 0;
+        // Events left over from the previous run refer to connections that no longer exist
+        m_TickInbox.Clear();
+        m_Dispatching = !m_TickMode && m_CallbackExecutor != &InlineExecutor::Get();
+        m_PendingDispatches.store(1);
+        {
+            // Sessions do not survive a restart, since their clients' connections did not
+            std::lock_guard<std::mutex> lock(m_SessionMutex);
+            m_Sessions.clear();
+        }
+
+        m_Metrics.SetLabels({ { "role", "server" }, { "port", std::to_string(m_Port) } });
+
+        // Set up on the calling thread, so IsRunning() is true exactly when clients can connect
+        if (!Listen())
+        {
+            WaitForDispatches();
+            return;
+        }
+        m_Running.store(true);
+
         m_NetworkThread = std::thread([this]()
             {
                 NetworkThreadFunc();
             });
     }
 
+    void Server::SetNetworkConditions(const NetworkConditionProfile& profile, ConditionDirection direction)
+    {
+        std::lock_guard<std::mutex> lock(m_NetworkConditionsMutex);
+        m_NetworkConditions = profile;
+        m_NetworkConditionDirection = direction;
+        if (m_NetworkConditionsStarted)
+            NetworkConditions::Apply(profile, direction);
+    }
+
+    void Server::ClearNetworkConditions()
+    {
+        std::lock_guard<std::mutex> lock(m_NetworkConditionsMutex);
+        // Leave conditions another instance applied since alone
+        if (m_NetworkConditions && m_NetworkConditionsStarted && NetworkConditions::GetActive() == *m_NetworkConditions)
+            NetworkConditions::Clear();
+        m_NetworkConditions.reset();
+    }
+
+    void Server::ApplyNetworkConditions()
+    {
+        std::lock_guard<std::mutex> lock(m_NetworkConditionsMutex);
+        m_NetworkConditionsStarted = true;
+        if (m_NetworkConditions)
+            NetworkConditions::Apply(*m_NetworkConditions, m_NetworkConditionDirection);
+    }
+
     void Server::Stop()
     {
         m_Running.store(false);
+        for (const auto& worker : m_Workers)
+            worker->Waiter.Notify();
     }
 
-    void Server::NetworkThreadFunc()
+    bool Server::Listen()
     {
-        s_Instance = this;
-        m_Running.store(true);
+        m_Workers[0]->Waiter.Configure(m_NetworkThreadConfig);
 
-        SteamDatagramErrMsg errMsg;
-        if (!GameNetworkingSockets_Init(nullptr, errMsg))
+        std::string errorMessage;
+        m_Runtime = NetworkingRuntime::Acquire(errorMessage);
+        if (!m_Runtime)
         {
-            OnFatalError(fmt::format("GameNetworkingSockets_Init failed: {}", errMsg));
-            return;
+            OnFatalError(errorMessage);
+            return false;
         }
 
-        m_Interface = SteamNetworkingSockets();
-        assert(m_Interface && "SteamNetworkingSockets() returned nullptr!");
+        m_Interface = m_Runtime->GetInterface();
+        ApplyNetworkConditions();
+        m_LaneStats.Reset(m_LaneConfig);
+        m_LastLaneSample = std::chrono::steady_clock::now();
+        m_LastTelemetrySample = m_LastLaneSample;
+        m_LastFlowControlCheck = m_LastLaneSample;
+        m_Congestion.Clear();
+
+        // Status changes may be routed here from another instance's thread; queue them for this one
+        m_StatusListener = m_Runtime->AddListener([this](const SteamNetConnectionStatusChangedCallback_t& status)
+            {
+                m_StatusInbox.Push(status);
+                m_Workers[0]->Waiter.Notify();
+            });
+
+        // Poll groups first, so no connection can arrive before there is somewhere to put it
+        for (const auto& worker : m_Workers)
+        {
+            worker->PollGroup = m_Interface->CreatePollGroup();
+            if (worker->PollGroup == k_HSteamNetPollGroup_Invalid)
+            {
+                OnFatalError(fmt::format("Fatal error: Failed to create poll group on port {}", m_Port));
+                ReleaseRuntime();
+                return false;
+            }
+        }
 
         SteamNetworkingIPAddr serverLocalAddress;
         serverLocalAddress.Clear();
         serverLocalAddress.m_port = static_cast<uint16>(m_Port);
 
-        SteamNetworkingConfigValue_t options;
-        options.SetPtr(
-            k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
-            (void*)Server::ConnectionStatusChangedCallback
-        );
-
-        m_ListenSocket = m_Interface->CreateListenSocketIP(serverLocalAddress, 1, &options);
+        m_ListenSocket = m_Runtime->CreateListenSocketIP(serverLocalAddress, m_StatusListener);
         if (m_ListenSocket == k_HSteamListenSocket_Invalid)
         {
             OnFatalError(fmt::format("Fatal error: Failed to listen on port {}", m_Port));
-            return;
+            ReleaseRuntime();
+            return false;
         }
+        return true;
+    }
+
+    void Server::NetworkThreadFunc()
+    {
+        Worker& mainWorker = *m_Workers[0];
 
-        m_PollGroup = m_Interface->CreatePollGroup();
-        if (m_PollGroup == k_HSteamNetPollGroup_Invalid)
+        for (size_t i = 1; i < m_Workers.size(); i++)
         {
-            OnFatalError(fmt::format("Fatal error: Failed to create poll group on port {}", m_Port));
-            return;
+            Worker& worker = *m_Workers[i];
+            worker.Thread = std::thread([this, &worker]()
+                {
+                    WorkerThreadFunc(worker);
+                });
         }
 
-        UT_INFO_TAG("SERVER", "Server listening on port {}", m_Port);
+        UT_INFO_TAG("SERVER", "Server listening on port {} with {} network worker(s)", m_Port, m_Workers.size());
         std::cout << "Server listening on port " << m_Port << std::endl;
 
         while (m_Running.load())
         {
-            PollIncomingMessages();
-            PollConnectionStateChanges();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            const auto iterationStart = std::chrono::steady_clock::now();
+            bool didWork = ProcessConnectionEvents(mainWorker) > 0;
+            didWork |= PollIncomingMessages(mainWorker) > 0;
+            // Read before draining, so every send that preceded EndFrame() is part of this flush
+            const bool endOfFrame = m_EndFrameRequested.exchange(false, std::memory_order_acquire);
+            didWork |= FlushSendQueue() > 0;
+            if (endOfFrame)
+                FlushEndOfFrame();
+            didWork |= PollConnectionStateChanges() > 0;
+            SampleConnections();
+            SendSessionAcks(mainWorker);
+            ExpireSessions();
+            m_Metrics.AddPollIteration(std::chrono::steady_clock::now() - iterationStart);
+            mainWorker.Waiter.Wait(didWork);
+        }
+
+        for (const auto& worker : m_Workers)
+        {
+            if (worker->Thread.joinable())
+                worker->Thread.join();
         }
 
+        // Nothing is posted past this point; callbacks still queued may send, so let them finish first
+        WaitForDispatches();
+
+        // Get anything queued before Stop() onto the wire; linger below lets it drain
+        FlushSendQueue();
+
         // Begin shutdown process
         UT_INFO_TAG("SERVER", "Closing connections...");
         std::cout << "Closing connections..." << std::endl;
-        for (const auto& [clientID, clientInfo] : m_ConnectedClients)
+        for (const auto& worker : m_Workers)
+        {
+            for (const ClientInfo& client : worker->Clients.GetClients())
+            {
+                m_Interface->CloseConnection(client.ID, 0, "Server Shutdown", true);
+            }
+            worker->Clients.Clear();
+            worker->ClientCount.store(0);
+            worker->Sessions.clear();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_SessionMutex);
+            m_Sessions.clear();
+        }
+
+        // Sends that raced with shutdown have nowhere to go
+        ReleaseQueuedSends();
+
+        ReleaseRuntime();
+    }
+
+    void Server::ReleaseRuntime()
+    {
+        if (m_ListenSocket != k_HSteamListenSocket_Invalid)
         {
-            m_Interface->CloseConnection(clientID, 0, "Server Shutdown", true);
+            m_Interface->CloseListenSocket(m_ListenSocket);
+            m_Runtime->UnregisterListenSocket(m_ListenSocket);
+            m_ListenSocket = k_HSteamListenSocket_Invalid;
         }
-        m_ConnectedClients.clear();
 
-        m_Interface->CloseListenSocket(m_ListenSocket);
-        m_ListenSocket = k_HSteamListenSocket_Invalid;
+        for (const auto& worker : m_Workers)
+        {
+            if (worker->PollGroup != k_HSteamNetPollGroup_Invalid)
+            {
+                m_Interface->DestroyPollGroup(worker->PollGroup);
+                worker->PollGroup = k_HSteamNetPollGroup_Invalid;
+            }
+        }
 
-        m_Interface->DestroyPollGroup(m_PollGroup);
-        m_PollGroup = k_HSteamNetPollGroup_Invalid;
+        // Drops the routes of every connection still registered to us
+        m_Runtime->RemoveListener(m_StatusListener);
+        m_StatusListener = NetworkingRuntime::k_InvalidListener;
 
-        GameNetworkingSockets_Kill();
+        m_Interface = nullptr;
+        m_Runtime = nullptr;
+        NetworkingRuntime::Release();
     }
 
-    void Server::ConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* info)
+    void Server::WorkerThreadFunc(Worker& worker)
     {
-        if (s_Instance)
+        NetworkThreadConfig config = m_NetworkThreadConfig;
+        if (config.PinnedCore >= 0)
+            config.PinnedCore += static_cast<int>(worker.Index);
+        worker.Waiter.Configure(config);
+
+        while (m_Running.load())
         {
-            s_Instance->OnConnectionStatusChanged(info);
+            const auto iterationStart = std::chrono::steady_clock::now();
+            bool didWork = ProcessConnectionEvents(worker) > 0;
+            didWork |= PollIncomingMessages(worker) > 0;
+            SendSessionAcks(worker);
+            m_Metrics.AddPollIteration(std::chrono::steady_clock::now() - iterationStart);
+            worker.Waiter.Wait(didWork);
         }
     }
 
@@ -138,84 +334,272 @@ namespace Utopia {
         case k_ESteamNetworkingConnectionState_ClosedByPeer:
         case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
         {
-            if (status->m_eOldState == k_ESteamNetworkingConnectionState_Connected)
+            // The owning worker unregisters the client and closes the connection
+            if (Worker* worker = FindWorker(status->m_info.m_nUserData))
             {
-                auto itClient = m_ConnectedClients.find(status->m_hConn);
-                if (itClient != m_ConnectedClients.end())
-                {
-                    if (m_ClientDisconnectedCallback)
-                    {
-                        m_ClientDisconnectedCallback(itClient->second);
-                    }
-                    m_ConnectedClients.erase(itClient);
-                }
+                const bool resumable = m_SessionConfig.Enabled && IsResumableEnd(status->m_info);
+                PostConnectionEvent(*worker, resumable ? ConnectionEvent::Type::Drop : ConnectionEvent::Type::Close, status->m_hConn);
+            }
+            else
+            {
+                m_Interface->CloseConnection(status->m_hConn, 0, nullptr, false);
+                m_Runtime->UnregisterConnection(status->m_hConn);
             }
-
-            m_Interface->CloseConnection(status->m_hConn, 0, nullptr, false);
             break;
         }
 
         case k_ESteamNetworkingConnectionState_Connecting:
         {
-            // Try to accept incoming connection
-            if (m_Interface->AcceptConnection(status->m_hConn) != k_EResultOK)
+            // Record the owner right away so a close that races the accept reaches the same worker
+            const uint32_t workerIndex = AssignWorker(status->m_info);
+            // Counted now rather than on accept, so a burst of connects does not all see the same loads
+            m_Workers[workerIndex]->ClientCount.fetch_add(1, std::memory_order_relaxed);
+            m_Interface->SetConnectionUserData(status->m_hConn, PackConnectionUserData(workerIndex, ClientRegistry::k_InvalidSlot));
+            PostConnectionEvent(*m_Workers[workerIndex], ConnectionEvent::Type::Accept, status->m_hConn);
+            break;
+        }
+
+        case k_ESteamNetworkingConnectionState_Connected:
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    uint32_t Server::AssignWorker(const SteamNetConnectionInfo_t& info)
+    {
+        const uint32_t workerCount = static_cast<uint32_t>(m_Workers.size());
+        if (workerCount == 1)
+            return 0;
+
+        if (m_WorkerConfig.AssignmentFunction)
+        {
+            const uint32_t workerIndex = m_WorkerConfig.AssignmentFunction(info, workerCount);
+            if (workerIndex < workerCount)
+                return workerIndex;
+
+            UT_WARN_TAG("SERVER", "Worker assignment function returned {} for {} workers; using round-robin", workerIndex, workerCount);
+        }
+
+        switch (m_WorkerConfig.Assignment)
+        {
+        case WorkerAssignmentPolicy::LeastLoaded:
+        {
+            uint32_t bestIndex = 0;
+            uint32_t bestCount = m_Workers[0]->ClientCount.load(std::memory_order_relaxed);
+            for (uint32_t i = 1; i < workerCount; i++)
             {
-                m_Interface->CloseConnection(status->m_hConn, 0, nullptr, false);
-                UT_WARN_TAG("SERVER", "Couldn't accept incoming connection (already closed?)");
-                std::cout << "Couldn't accept connection (it was already closed?)" << std::endl;
-                break;
+                const uint32_t count = m_Workers[i]->ClientCount.load(std::memory_order_relaxed);
+                if (count < bestCount)
+                {
+                    bestIndex = i;
+                    bestCount = count;
+                }
             }
+            return bestIndex;
+        }
+
+        case WorkerAssignmentPolicy::ClientHash:
+            return HashRemoteAddress(info.m_addrRemote) % workerCount;
+
+        case WorkerAssignmentPolicy::RoundRobin:
+        default:
+            return m_NextWorker++ % workerCount;
+        }
+    }
+
+    Server::Worker* Server::FindWorker(int64 connectionUserData) const
+    {
+        const uint32_t workerIndex = UnpackWorkerIndex(connectionUserData);
+        return workerIndex < m_Workers.size() ? m_Workers[workerIndex].get() : nullptr;
+    }
+
+    void Server::PostConnectionEvent(Worker& worker, ConnectionEvent::Type type, HSteamNetConnection connection)
+    {
+        {
+            std::lock_guard<std::mutex> lock(worker.EventMutex);
+            worker.PendingEvents.push_back({ type, connection });
+        }
+        worker.Waiter.Notify();
+    }
+
+    int Server::ProcessConnectionEvents(Worker& worker)
+    {
+        {
+            // Connection changes are rare, so a short lock here is fine
+            std::lock_guard<std::mutex> lock(worker.EventMutex);
+            if (worker.PendingEvents.empty())
+                return 0;
+            std::swap(worker.PendingEvents, worker.ProcessingEvents);
+            std::swap(worker.PendingExpiries, worker.ProcessingExpiries);
+        }
 
-            // Assign the poll group
-            if (!m_Interface->SetConnectionPollGroup(status->m_hConn, m_PollGroup))
+        size_t expiryIndex = 0;
+        for (const ConnectionEvent& event : worker.ProcessingEvents)
+        {
+            switch (event.EventType)
             {
-                m_Interface->CloseConnection(status->m_hConn, 0, nullptr, false);
-                UT_WARN_TAG("SERVER", "Failed to set poll group for new connection");
-                std::cout << "Failed to set poll group" << std::endl;
+            case ConnectionEvent::Type::Accept:
+                AcceptClient(worker, event.Connection);
+                break;
+            case ConnectionEvent::Type::Close:
+                RemoveClient(worker, event.Connection, nullptr);
+                break;
+            case ConnectionEvent::Type::Drop:
+                RemoveClient(worker, event.Connection, nullptr, true);
+                break;
+            case ConnectionEvent::Type::Supersede:
+                // Unless it dropped on its own in the meantime
+                if (worker.Clients.Find(UnpackSlot(m_Interface->GetConnectionUserData(event.Connection)), event.Connection))
+                    RemoveClient(worker, event.Connection, "Session resumed on another connection", true);
+                break;
+            case ConnectionEvent::Type::Resume:
+                if (const ClientInfo* client = worker.Clients.Find(UnpackSlot(m_Interface->GetConnectionUserData(event.Connection)), event.Connection))
+                    ResumeSession(worker, *client);
+                break;
+            case ConnectionEvent::Type::Expire:
+            {
+                const ClientInfo& client = worker.ProcessingExpiries[expiryIndex++];
+                UT_INFO_TAG("SERVER", "ClientID {} did not come back within the session resume timeout", static_cast<uint32_t>(client.ID));
+                NotifyClientDisconnected(client);
+                break;
+            }
+            case ConnectionEvent::Type::Writable:
+                if (const ClientInfo* client = worker.Clients.Find(UnpackSlot(m_Interface->GetConnectionUserData(event.Connection)), event.Connection))
+                {
+                    if (m_ClientWritableCallback)
+                    {
+                        if (m_Dispatching)
+                            Dispatch(client->ID, [this, client = *client]() { m_ClientWritableCallback(client); });
+                        else
+                            m_ClientWritableCallback(*client);
+                    }
+                }
+                break;
+            case ConnectionEvent::Type::Kick:
+                // The handle came from the caller, so make sure it is one of ours before closing it
+                if (worker.Clients.Find(UnpackSlot(m_Interface->GetConnectionUserData(event.Connection)), event.Connection))
+                    RemoveClient(worker, event.Connection, "Kicked by host");
+                else
+                    UT_WARN_TAG("SERVER", "Cannot kick ClientID {}; it is not connected to this server", static_cast<uint32_t>(event.Connection));
                 break;
             }
+        }
 
-            // Retrieve connection info
-            SteamNetConnectionInfo_t connectionInfo;
-            m_Interface->GetConnectionInfo(status->m_hConn, &connectionInfo);
+        const int eventCount = static_cast<int>(worker.ProcessingEvents.size());
+        worker.ProcessingEvents.clear();
+        worker.ProcessingExpiries.clear();
+        return eventCount;
+    }
 
-            // Register connected client
-            ClientInfo& client = m_ConnectedClients[status->m_hConn];
-            client.ID = status->m_hConn;
-            client.ConnectionDesc = connectionInfo.m_szConnectionDescription;
+    void Server::AcceptClient(Worker& worker, HSteamNetConnection connection)
+    {
+        SteamNetConnectionInfo_t connectionInfo;
+        m_Interface->GetConnectionInfo(connection, &connectionInfo);
 
-            // User callback
-            if (m_ClientConnectedCallback)
-            {
-                m_ClientConnectedCallback(client);
-            }
+        // Register before accepting so every message from this connection carries its slot
+        const uint32_t slot = worker.Clients.Add(connection, connectionInfo.m_szConnectionDescription).Slot;
+        m_Interface->SetConnectionUserData(connection, PackConnectionUserData(worker.Index, slot));
 
-            break;
+        // Try to accept incoming connection
+        if (m_Interface->AcceptConnection(connection) != k_EResultOK)
+        {
+            worker.Clients.Remove(slot);
+            worker.ClientCount.fetch_sub(1, std::memory_order_relaxed);
+            m_Interface->CloseConnection(connection, 0, nullptr, false);
+            m_Runtime->UnregisterConnection(connection);
+            UT_WARN_TAG("SERVER", "Couldn't accept incoming connection (already closed?)");
+            std::cout << "Couldn't accept connection (it was already closed?)" << std::endl;
+            return;
         }
 
-        case k_ESteamNetworkingConnectionState_Connected:
-            break;
+        // Lanes must exist before anything is sent on them; a failure here only costs prioritization
+        m_LaneConfig.Apply(m_Interface, connection);
 
-        default:
-            break;
+        // Assign the poll group
+        if (!m_Interface->SetConnectionPollGroup(connection, worker.PollGroup))
+        {
+            worker.Clients.Remove(slot);
+            worker.ClientCount.fetch_sub(1, std::memory_order_relaxed);
+            m_Interface->CloseConnection(connection, 0, nullptr, false);
+            m_Runtime->UnregisterConnection(connection);
+            UT_WARN_TAG("SERVER", "Failed to set poll group for new connection");
+            std::cout << "Failed to set poll group" << std::endl;
+            return;
+        }
+
+        if (const std::shared_ptr<TrafficCapture> capture = m_TrafficCapture.load(std::memory_order_acquire))
+            capture->RecordConnect(*worker.Clients.Get(slot));
+
+        if (m_SessionConfig.Enabled)
+        {
+            // Announced once its hello says whether it is new or resuming
+            if (worker.Sessions.size() <= slot)
+                worker.Sessions.resize(static_cast<size_t>(slot) + 1);
+            worker.Sessions[slot] = {};
+            return;
         }
+
+        NotifyClientConnected(*worker.Clients.Get(slot));
     }
 
-    void Server::PollConnectionStateChanges()
+    void Server::RemoveClient(Worker& worker, HSteamNetConnection connection, const char* reason, bool resumable)
     {
-        if (m_Interface)
+        // Re-read the user data: the status callback may predate the slot being assigned
+        const uint32_t slot = UnpackSlot(m_Interface->GetConnectionUserData(connection));
+
+        // Clients are registered (and announced) on accept, so a connection that drops before
+        // finishing its handshake must be unregistered here too
+        if (ClientInfo* client = worker.Clients.Find(slot, connection))
         {
-            m_Interface->RunCallbacks();
+            if (const std::shared_ptr<TrafficCapture> capture = m_TrafficCapture.load(std::memory_order_acquire))
+                capture->RecordDisconnect(client->ID);
+
+            if (!m_SessionConfig.Enabled)
+            {
+                NotifyClientDisconnected(*client);
+            }
+            else
+            {
+                // A client that never finished its handshake was never announced
+                ClientSession& session = worker.Sessions[slot];
+                if (session.Established && !ParkSession(*client, session, resumable))
+                    NotifyClientDisconnected(*client);
+                session = {};
+            }
+            worker.Clients.Remove(slot);
+            worker.ClientCount.fetch_sub(1, std::memory_order_relaxed);
         }
+
+        m_Interface->CloseConnection(connection, 0, reason, false);
+        m_Runtime->UnregisterConnection(connection);
+    }
+
+    int Server::PollConnectionStateChanges()
+    {
+        if (!m_Runtime)
+            return 0;
+
+        m_Runtime->RunCallbacks();
+        return m_StatusInbox.Drain([this](SteamNetConnectionStatusChangedCallback_t* status)
+            {
+                OnConnectionStatusChanged(status);
+            });
     }
 
-    void Server::PollIncomingMessages()
+    int Server::PollIncomingMessages(Worker& worker)
     {
-        // Process all messages
+        int dispatchedCount = 0;
+
+        // Drain in batches until the poll group is empty
         while (m_Running.load())
         {
-            ISteamNetworkingMessage* incomingMessage = nullptr;
-            int messageCount = m_Interface->ReceiveMessagesOnPollGroup(m_PollGroup, &incomingMessage, 1);
+            const int messageCount = m_Interface->ReceiveMessagesOnPollGroup(
+                worker.PollGroup,
+                worker.ReceiveBuffer.data(),
+                static_cast<int>(worker.ReceiveBuffer.size())
+            );
             if (messageCount == 0)
                 break;
 
@@ -223,113 +607,1052 @@ namespace Utopia {
             {
                 UT_ERROR_TAG("SERVER", "ReceiveMessagesOnPollGroup returned a critical error: {}", messageCount);
                 m_Running.store(false);
-                return;
+                return dispatchedCount;
             }
 
-            // We only asked for 1 message
-            assert(messageCount == 1 && incomingMessage);
+            // Handles only take over messages when no batch callback wants them, or when they outlive the poll,
+            // queued for the tick or for the callback executor
+            const bool transferOwnership = m_TickMode || m_Dispatching || (!m_DataBatchReceivedCallback && m_MessageReceivedCallback);
+            const std::shared_ptr<TrafficCapture> capture = m_TrafficCapture.load(std::memory_order_acquire);
 
-            auto itClient = m_ConnectedClients.find(incomingMessage->m_conn);
-            if (itClient == m_ConnectedClients.end())
+            // The connection's user data holds its registry slot, so the lookup is a single array index
+            const auto callbackStart = std::chrono::steady_clock::now();
+            uint64_t receivedBytes = 0;
+            worker.ReceivedBatch.clear();
+            for (int i = 0; i < messageCount; i++)
             {
-                UT_WARN_TAG("SERVER", "Received data from unregistered client");
-                std::cout << "ERROR: Received data from unregistered client\n";
-                incomingMessage->Release();
-                continue;
+                ISteamNetworkingMessage* incomingMessage = worker.ReceiveBuffer[i];
+                receivedBytes += static_cast<uint64_t>(incomingMessage->m_cbSize);
+                const ClientInfo* client = worker.Clients.Find(
+                    UnpackSlot(incomingMessage->m_nConnUserData),
+                    incomingMessage->m_conn
+                );
+                if (!client)
+                {
+                    UT_WARN_TAG("SERVER", "Received data from unregistered client");
+                    std::cout << "ERROR: Received data from unregistered client\n";
+                    continue;
+                }
+
+                Buffer payload(incomingMessage->m_pData, incomingMessage->m_cbSize);
+                const bool decoded = incomingMessage->m_cbSize > 0 && (!m_CompressionConfig.IsEnabled() || DecodeIncomingPayload(worker, i, payload));
+
+                // Sessions count every message, dropped or not, so the counts line up with what the client sent
+                if (m_SessionConfig.Enabled && !TrackSessionMessage(worker, *client, *incomingMessage, decoded ? payload : Buffer()))
+                    continue;
+                if (!decoded)
+                    continue;
+
+                if (capture)
+                    capture->RecordData(client->ID, incomingMessage->m_idxLane, payload);
+
+                if (transferOwnership)
+                {
+                    // A decoded payload no longer matches the library's message, so hand out a copy
+                    SteamNetworkingMessage_t* handleMessage = incomingMessage;
+                    if (m_CompressionConfig.IsEnabled())
+                    {
+                        handleMessage = CopyReceivedMessage(*incomingMessage, payload);
+                        if (!handleMessage)
+                            continue;
+                    }
+                    else
+                    {
+                        worker.ReceiveBuffer[i] = nullptr;
+                    }
+                    if (m_TickMode)
+                    {
+                        worker.TickEvents.push_back(TickEvent{ TickEventType::Data, client->ID, MessageHandle(handleMessage) });
+                    }
+                    else if (m_Dispatching)
+                    {
+                        std::shared_ptr<DispatchBatch>& batch = worker.DispatchBatches[client->ID];
+                        if (!batch)
+                            batch = std::make_shared<DispatchBatch>(DispatchBatch{ *client, {} });
+                        batch->Messages.emplace_back(handleMessage);
+                    }
+                    else
+                    {
+                        m_MessageReceivedCallback(*client, MessageHandle(handleMessage));
+                    }
+                }
+                else
+                {
+                    worker.ReceivedBatch.push_back({ client, payload });
+                }
             }
 
-            if (incomingMessage->m_cbSize > 0 && m_DataReceivedCallback)
+            if (m_TickMode)
             {
-                m_DataReceivedCallback(
-                    itClient->second,
-                    Buffer(incomingMessage->m_pData, incomingMessage->m_cbSize)
-                );
+                m_TickInbox.Append(worker.TickEvents);
+            }
+            else if (m_Dispatching)
+            {
+                for (auto& [clientID, batch] : worker.DispatchBatches)
+                    Dispatch(clientID, [this, batch = std::move(batch)]() { RunDispatchBatch(*batch); });
+                worker.DispatchBatches.clear();
+            }
+            else if (m_DataBatchReceivedCallback)
+            {
+                if (!worker.ReceivedBatch.empty())
+                    m_DataBatchReceivedCallback(std::span<const ReceivedMessage>(worker.ReceivedBatch));
+            }
+            else if (m_DataReceivedCallback)
+            {
+                for (const ReceivedMessage& message : worker.ReceivedBatch)
+                    m_DataReceivedCallback(*message.Client, message.Payload);
+            }
+
+            m_Metrics.AddReceived(static_cast<uint64_t>(messageCount), receivedBytes);
+            // Dispatched callbacks are timed where they run
+            if (!m_Dispatching)
+                m_Metrics.AddCallbackTime(std::chrono::steady_clock::now() - callbackStart);
+
+            for (int i = 0; i < messageCount; i++)
+            {
+                if (worker.ReceiveBuffer[i])
+                    worker.ReceiveBuffer[i]->Release();
             }
 
-            incomingMessage->Release();
+            dispatchedCount += messageCount;
+
+            // A short batch means the poll group is drained
+            if (messageCount < static_cast<int>(worker.ReceiveBuffer.size()))
+                break;
         }
+
+        return dispatchedCount;
     }
 
-    void Server::SetClientNick(HSteamNetConnection hConn, const char* nick)
+    bool Server::DecodeIncomingPayload(Worker& worker, int index, Buffer& outPayload)
     {
-        if (m_Interface)
+        const ISteamNetworkingMessage* message = worker.ReceiveBuffer[index];
+
+        const auto decodeStart = std::chrono::steady_clock::now();
+        CompressionResult result;
+        const DecodeStatus status = DecodePayload(m_CompressionConfig, outPayload, worker.DecompressBuffers[index], outPayload, result);
+        if (status != DecodeStatus::Ok)
         {
-            m_Interface->SetConnectionName(hConn, nick);
+            UT_WARN_TAG("SERVER", "Dropping message from ClientID {}: {}",
+                static_cast<uint32_t>(message->m_conn),
+                status == DecodeStatus::UnknownCodec ? "unknown compression codec" : "malformed compressed payload");
+            return false;
         }
+
+        if (result.Compressed)
+            m_Metrics.AddCompression(message->m_conn, CompressionDirection::Decompress, result.UncompressedSize, result.CompressedSize, std::chrono::steady_clock::now() - decodeStart);
+
+        return true;
     }
 
-    //////////////////////////////////////////////////////////////////////////////////////////////////
-    // User Callbacks
-    //////////////////////////////////////////////////////////////////////////////////////////////////
-    void Server::SetDataReceivedCallback(const DataReceivedCallback& function)
+    void Server::Dispatch(ClientID clientID, Executor::Work work)
     {
-        m_DataReceivedCallback = function;
+        m_PendingDispatches.fetch_add(1);
+        m_Metrics.AddDispatchQueued();
+
+        const auto queuedAt = std::chrono::steady_clock::now();
+        m_CallbackExecutor->PostOrdered(clientID, [this, queuedAt, work = std::move(work)]()
+            {
+                const auto callbackStart = std::chrono::steady_clock::now();
+                m_Metrics.AddDispatchStarted(callbackStart - queuedAt);
+                work();
+                m_Metrics.AddCallbackTime(std::chrono::steady_clock::now() - callbackStart);
+
+                // Under the lock, so the network thread cannot see the count reach zero and let the server go while this still runs
+                std::lock_guard<std::mutex> lock(m_DispatchMutex);
+                if (m_PendingDispatches.fetch_sub(1) == 1)
+                    m_DispatchCondition.notify_all();
+            });
     }
 
-    void Server::SetClientConnectedCallback(const ClientConnectedCallback& function)
+    void Server::RunDispatchBatch(DispatchBatch& batch)
     {
-        m_ClientConnectedCallback = function;
+        if (m_DataBatchReceivedCallback)
+        {
+            std::vector<ReceivedMessage> messages;
+            messages.reserve(batch.Messages.size());
+            for (const MessageHandle& message : batch.Messages)
+                messages.push_back({ &batch.Client, message.GetBuffer() });
+            m_DataBatchReceivedCallback(std::span<const ReceivedMessage>(messages));
+        }
+        else if (m_MessageReceivedCallback)
+        {
+            for (MessageHandle& message : batch.Messages)
+                m_MessageReceivedCallback(batch.Client, std::move(message));
+        }
+        else if (m_DataReceivedCallback)
+        {
+            for (const MessageHandle& message : batch.Messages)
+                m_DataReceivedCallback(batch.Client, message.GetBuffer());
+        }
     }
 
-    void Server::SetClientDisconnectedCallback(const ClientDisconnectedCallback& function)
+    void Server::WaitForDispatches()
     {
-        m_ClientDisconnectedCallback = function;
+        std::unique_lock<std::mutex> lock(m_DispatchMutex);
+        m_PendingDispatches.fetch_sub(1);
+        m_DispatchCondition.wait(lock, [this]() { return m_PendingDispatches.load() == 0; });
     }
 
-    //////////////////////////////////////////////////////////////////////////////////////////////////
-    // Sending Data
-    //////////////////////////////////////////////////////////////////////////////////////////////////
-    void Server::SendBufferToClient(ClientID clientID, Buffer buffer, bool reliable)
+    void Server::NotifyClientConnected(const ClientInfo& client)
     {
-        if (!m_Interface)
+        if (m_TickMode)
         {
-            UT_WARN_TAG("SERVER", "Cannot send data; m_Interface is null");
-            return;
+            m_TickInbox.Append(TickEvent{ TickEventType::Connected, client.ID, {} });
         }
-
-        EResult result = m_Interface->SendMessageToConnection(
-            static_cast<HSteamNetConnection>(clientID),
-            buffer.Data,
-            static_cast<uint32_t>(buffer.Size),
-            reliable ? k_nSteamNetworkingSend_Reliable : k_nSteamNetworkingSend_Unreliable,
-            nullptr
-        );
-
-        if (result != k_EResultOK)
+        else if (m_ClientConnectedCallback)
         {
-            UT_WARN_TAG("SERVER",
-                "SendMessageToConnection failed for ClientID {} with EResult code: {}",
-                static_cast<uint32_t>(clientID),
-                static_cast<int>(result)
-            );
+            if (m_Dispatching)
+                Dispatch(client.ID, [this, client]() { m_ClientConnectedCallback(client); });
+            else
+                m_ClientConnectedCallback(client);
         }
     }
 
-    void Server::SendBufferToAllClients(Buffer buffer, ClientID excludeClientID, bool reliable)
+    void Server::NotifyClientDisconnected(const ClientInfo& client)
     {
-        for (const auto& [clientID, clientInfo] : m_ConnectedClients)
+        if (m_TickMode)
         {
-            if (clientID == excludeClientID)
+            m_TickInbox.Append(TickEvent{ TickEventType::Disconnected, client.ID, {} });
+        }
+        else if (m_ClientDisconnectedCallback)
+        {
+            if (m_Dispatching)
+                Dispatch(client.ID, [this, client]() { m_ClientDisconnectedCallback(client); });
+            else
+                m_ClientDisconnectedCallback(client);
+        }
+    }
+
+    void Server::NotifyClientResumed(const ClientInfo& client, ClientID previousID)
+    {
+        if (m_TickMode)
+        {
+            m_TickInbox.Append(TickEvent{ TickEventType::Resumed, client.ID, {}, previousID });
+        }
+        else if (m_ClientResumedCallback)
+        {
+            if (m_Dispatching)
+                Dispatch(client.ID, [this, client, previousID]() { m_ClientResumedCallback(client, previousID); });
+            else
+                m_ClientResumedCallback(client, previousID);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Sessions
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    bool Server::TrackSessionMessage(Worker& worker, const ClientInfo& client, const ISteamNetworkingMessage& message, Buffer payload)
+    {
+        ClientSession& session = worker.Sessions[client.Slot];
+
+        MessageTypeID id;
+        if (PeekMessageTypeID(payload, id) && id == SessionMessage::k_HelloID)
+        {
+            SessionToken resume;
+            if (!SessionMessage::DecodeHello(payload, resume))
+            {
+                UT_WARN_TAG("SERVER", "Ignoring malformed session hello from ClientID {}", static_cast<uint32_t>(client.ID));
+            }
+            else if (!session.Established && !session.Token.IsValid())
+            {
+                // Only the first hello counts; a resume may still be waiting on the old connection
+                session.Token = resume;
+                ResumeSession(worker, client);
+            }
+            return false;
+        }
+
+        // A client that skips the handshake never gets through
+        if (!session.Established)
+            return false;
+
+        if ((message.m_nFlags & k_nSteamNetworkingSend_Reliable) != 0)
+        {
+            if (message.m_idxLane >= session.LaneCounts.size())
+                session.LaneCounts.resize(static_cast<size_t>(message.m_idxLane) + 1);
+            session.LaneCounts[message.m_idxLane]++;
+            session.AckDue = true;
+        }
+        return true;
+    }
+
+    void Server::ResumeSession(Worker& worker, const ClientInfo& client)
+    {
+        ClientSession& session = worker.Sessions[client.Slot];
+        if (!session.Token.IsValid())
+        {
+            StartSession(worker, client);
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_SessionMutex);
+        auto it = m_Sessions.find(session.Token);
+        if (it == m_Sessions.end())
+        {
+            lock.unlock();
+            UT_INFO_TAG("SERVER", "ClientID {} asked to resume a session that has expired; starting a new one", static_cast<uint32_t>(client.ID));
+            StartSession(worker, client);
+            return;
+        }
+
+        SessionRecord& record = it->second;
+        if (record.Connection != k_HSteamNetConnection_Invalid)
+        {
+            // The old connection has not timed out on this end yet. Its worker parks the session and
+            // posts Resume back here, so no message on it can be counted after the counts move.
+            record.ResumingConnection = client.ID;
+            record.ResumingWorker = worker.Index;
+            const HSteamNetConnection previous = record.Connection;
+            Worker& owner = *m_Workers[record.Worker];
+            lock.unlock();
+            PostConnectionEvent(owner, ConnectionEvent::Type::Supersede, previous);
+            return;
+        }
+
+        record.Connection = client.ID;
+        record.Worker = worker.Index;
+        const ClientID previousID = record.Client.ID;
+        session.LaneCounts = std::move(record.LaneCounts);
+        record.LaneCounts.clear();
+        lock.unlock();
+
+        session.Established = true;
+        session.AckDue = false;
+        SendOutgoingMessageToClient(client.ID, SessionMessage::EncodeGrant(session.Token, true, session.LaneCounts), SendFlags::ReliableNoNagle);
+
+        UT_INFO_TAG("SERVER", "ClientID {} resumed the session of ClientID {}", static_cast<uint32_t>(client.ID), static_cast<uint32_t>(previousID));
+        NotifyClientResumed(client, previousID);
+    }
+
+    void Server::StartSession(Worker& worker, const ClientInfo& client)
+    {
+        ClientSession& session = worker.Sessions[client.Slot];
+        session.Token = SessionToken::Generate();
+        session.Established = true;
+        session.AckDue = false;
+        session.LaneCounts.clear();
+        {
+            std::lock_guard<std::mutex> lock(m_SessionMutex);
+            SessionRecord& record = m_Sessions[session.Token];
+            record.Connection = client.ID;
+            record.Worker = worker.Index;
+        }
+
+        SendOutgoingMessageToClient(client.ID, SessionMessage::EncodeGrant(session.Token, false, {}), SendFlags::ReliableNoNagle);
+        NotifyClientConnected(client);
+    }
+
+    bool Server::ParkSession(const ClientInfo& client, ClientSession& session, bool resumable)
+    {
+        std::lock_guard<std::mutex> lock(m_SessionMutex);
+        auto it = m_Sessions.find(session.Token);
+        if (it == m_Sessions.end())
+            return false;
+
+        SessionRecord& record = it->second;
+        const HSteamNetConnection resumingConnection = std::exchange(record.ResumingConnection, k_HSteamNetConnection_Invalid);
+        const uint32_t resumingWorker = record.ResumingWorker;
+
+        if (resumable)
+        {
+            record.Connection = k_HSteamNetConnection_Invalid;
+            record.Client = client;
+            record.LaneCounts = std::move(session.LaneCounts);
+            record.Expiry = std::chrono::steady_clock::now() + m_SessionConfig.ResumeTimeout;
+        }
+        else
+        {
+            // Hung up on purpose; a resume racing with that finds nothing and starts over
+            m_Sessions.erase(it);
+        }
+
+        if (resumingConnection != k_HSteamNetConnection_Invalid)
+            PostConnectionEvent(*m_Workers[resumingWorker], ConnectionEvent::Type::Resume, resumingConnection);
+        return resumable;
+    }
+
+    void Server::SendSessionAcks(Worker& worker)
+    {
+        if (!m_SessionConfig.Enabled)
+            return;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now < worker.NextSessionAck)
+            return;
+        worker.NextSessionAck = now + m_SessionConfig.AckInterval;
+
+        for (const ClientInfo& client : worker.Clients.GetClients())
+        {
+            ClientSession& session = worker.Sessions[client.Slot];
+            if (!session.AckDue)
+                continue;
+
+            // Counts only grow, so a lost ack is made good by the next one
+            session.AckDue = false;
+            SendOutgoingMessageToClient(client.ID, SessionMessage::EncodeAck(session.LaneCounts), SendFlags::UnreliableNoNagle);
+        }
+    }
+
+    void Server::ExpireSessions()
+    {
+        if (!m_SessionConfig.Enabled)
+            return;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now < m_NextSessionExpiry)
+            return;
+        m_NextSessionExpiry = now + m_SessionConfig.AckInterval;
+
+        std::lock_guard<std::mutex> lock(m_SessionMutex);
+        for (auto it = m_Sessions.begin(); it != m_Sessions.end();)
+        {
+            SessionRecord& record = it->second;
+            if (record.Connection != k_HSteamNetConnection_Invalid || record.Expiry > now)
+            {
+                ++it;
+                continue;
+            }
+
+            // The worker that last owned the client announces it, in order with its other callbacks
+            Worker& owner = *m_Workers[record.Worker];
+            {
+                std::lock_guard<std::mutex> eventLock(owner.EventMutex);
+                owner.PendingEvents.push_back({ ConnectionEvent::Type::Expire, record.Client.ID });
+                owner.PendingExpiries.push_back(std::move(record.Client));
+            }
+            owner.Waiter.Notify();
+            it = m_Sessions.erase(it);
+        }
+    }
+
+    void Server::SetClientNick(HSteamNetConnection hConn, const char* nick)
+    {
+        if (m_Interface)
+        {
+            m_Interface->SetConnectionName(hConn, nick);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // User Callbacks
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    void Server::SetDataReceivedCallback(const DataReceivedCallback& function)
+    {
+        m_DataReceivedCallback = function;
+    }
+
+    void Server::SetDataBatchReceivedCallback(const DataBatchReceivedCallback& function)
+    {
+        m_DataBatchReceivedCallback = function;
+    }
+
+    void Server::SetMessageReceivedCallback(const MessageReceivedCallback& function)
+    {
+        m_MessageReceivedCallback = function;
+    }
+
+    void Server::SetClientConnectedCallback(const ClientConnectedCallback& function)
+    {
+        m_ClientConnectedCallback = function;
+    }
+
+    void Server::SetClientDisconnectedCallback(const ClientDisconnectedCallback& function)
+    {
+        m_ClientDisconnectedCallback = function;
+    }
+
+    void Server::SetClientWritableCallback(const ClientWritableCallback& function)
+    {
+        m_ClientWritableCallback = function;
+    }
+
+    void Server::SetClientResumedCallback(const ClientResumedCallback& function)
+    {
+        m_ClientResumedCallback = function;
+    }
+
+    void Server::SetTrafficCapture(std::shared_ptr<TrafficCapture> capture)
+    {
+        m_TrafficCapture.store(capture, std::memory_order_release);
+        if (!capture)
+            return;
+
+        // Recorded after the capture is live, so a client cannot slip in between; replay ignores repeats
+        const ClientRegistry::Snapshot clients = GetConnectedClients();
+        for (const ClientInfo& client : *clients)
+            capture->RecordConnect(client);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Sending Data
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    void Server::SendBufferToClient(ClientID clientID, Buffer buffer, SendFlags flags, uint16_t lane)
+    {
+        if (m_CompressionConfig.IsEnabled())
+        {
+            QueueMessageToClient(clientID, EncodeOutgoingPayload(buffer, static_cast<HSteamNetConnection>(clientID), lane), flags, lane);
+            return;
+        }
+
+        // Copy into a pooled slab rather than letting the library allocate one
+        OutgoingMessage message(static_cast<uint32_t>(buffer.Size));
+        if (buffer.Size > 0)
+            std::memcpy(message.GetData(), buffer.Data, buffer.Size);
+
+        QueueMessageToClient(clientID, std::move(message), flags, lane);
+    }
+
+    void Server::SendOutgoingMessageToClient(ClientID clientID, OutgoingMessage message, SendFlags flags, uint16_t lane)
+    {
+        // The header has to go in front, so compression costs this path its zero-copy send
+        if (m_CompressionConfig.IsEnabled() && message)
+            message = EncodeOutgoingPayload(message.GetBuffer(), static_cast<HSteamNetConnection>(clientID), lane);
+
+        QueueMessageToClient(clientID, std::move(message), flags, lane);
+    }
+
+    OutgoingMessage Server::EncodeOutgoingPayload(Buffer payload, HSteamNetConnection connection, uint16_t lane)
+    {
+        if (!m_CompressionConfig.ShouldCompress(lane, payload.Size))
+        {
+            CompressionResult result;
+            return EncodePayload(m_CompressionConfig, payload, lane, result);
+        }
+
+        const auto encodeStart = std::chrono::steady_clock::now();
+        CompressionResult result;
+        OutgoingMessage message = EncodePayload(m_CompressionConfig, payload, lane, result);
+        m_Metrics.AddCompression(
+            connection,
+            CompressionDirection::Compress,
+            result.UncompressedSize,
+            result.Compressed ? result.CompressedSize : result.UncompressedSize,
+            std::chrono::steady_clock::now() - encodeStart
+        );
+        return message;
+    }
+
+    void Server::QueueMessageToClient(ClientID clientID, OutgoingMessage message, SendFlags flags, uint16_t lane)
+    {
+        SteamNetworkingMessage_t* outgoingMessage = message.Detach();
+        if (!outgoingMessage)
+            return;
+
+        outgoingMessage->m_conn = static_cast<HSteamNetConnection>(clientID);
+        outgoingMessage->m_nFlags = flags.GetValue();
+        outgoingMessage->m_idxLane = lane;
+
+        EnqueueSend(outgoingMessage);
+    }
+
+    void Server::SendBufferToAllClients(Buffer buffer, ClientID excludeClientID, SendFlags flags, uint16_t lane)
+    {
+        if (!m_Running.load())
+        {
+            if (!m_Replaying.load(std::memory_order_relaxed))
+                UT_WARN_TAG("SERVER", "Cannot send data; server is not running");
+            return;
+        }
+
+        // Compressed once, however many clients it goes to
+        OutgoingMessage encoded;
+        if (m_CompressionConfig.IsEnabled())
+        {
+            encoded = EncodeOutgoingPayload(buffer, k_HSteamNetConnection_Invalid, lane);
+            buffer = encoded.GetBuffer();
+        }
+
+        QueueBroadcast(SharedPayload::Create(buffer.Data, static_cast<uint32_t>(buffer.Size)), excludeClientID, flags, lane);
+    }
+
+    void Server::SendPayloadToAllClients(SharedPayload* payload, ClientID excludeClientID, SendFlags flags, uint16_t lane)
+    {
+        // Compression frames into a copy of its own anyway, and the buffer path also reports a stopped server
+        if (m_CompressionConfig.IsEnabled() || !m_Running.load())
+        {
+            SendBufferToAllClients(Buffer(payload->GetData(), payload->GetSize()), excludeClientID, flags, lane);
+            payload->Release();
+            return;
+        }
+
+        QueueBroadcast(payload, excludeClientID, flags, lane);
+    }
+
+    void Server::QueueBroadcast(SharedPayload* payload, ClientID excludeClientID, SendFlags flags, uint16_t lane)
+    {
+        QueuedSend queuedSend;
+        queuedSend.Payload = payload;
+        queuedSend.ExcludeClientID = excludeClientID;
+        queuedSend.Flags = flags.GetValue();
+        queuedSend.Lane = lane;
+
+        if (!m_SendQueue.TryPush(queuedSend))
+        {
+            // Queue is full; resolve recipients here and send on this thread instead
+            UT_WARN_TAG("SERVER", "Send queue is full; broadcasting from the calling thread");
+            SendFramedBufferToClients(CollectClientIDs(excludeClientID), Buffer(payload->GetData(), payload->GetSize()), flags, nullptr, lane);
+            payload->Release();
+            return;
+        }
+
+        m_Workers[0]->Waiter.Notify();
+    }
+
+    void Server::EnqueueSend(SteamNetworkingMessage_t* message)
+    {
+        if (!m_Running.load())
+        {
+            if (!m_Replaying.load(std::memory_order_relaxed))
+                UT_WARN_TAG("SERVER", "Cannot send data; server is not running");
+            message->Release();
+            return;
+        }
+
+        QueuedSend queuedSend;
+        queuedSend.Message = message;
+        if (!m_SendQueue.TryPush(queuedSend))
+        {
+            // Queue is full; the library is thread-safe, so send on this thread instead
+            UT_WARN_TAG("SERVER", "Send queue is full; sending from the calling thread");
+            int64 messageNumberOrResult = 0;
+            const HSteamNetConnection connection = message->m_conn;
+            const uint64_t messageSize = static_cast<uint64_t>(message->m_cbSize);
+            TrackDirectNagledSends(std::span<const ClientID>(&connection, 1), SendFlags::FromValue(message->m_nFlags));
+            m_Interface->SendMessages(1, &message, &messageNumberOrResult);
+            if (messageNumberOrResult >= 0)
+            {
+                m_Metrics.AddSent(1, messageSize);
+            }
+            else
+            {
+                m_Metrics.AddSendFailures(1);
+                UT_WARN_TAG("SERVER",
+                    "SendMessages failed for ClientID {} with EResult code: {}",
+                    static_cast<uint32_t>(connection),
+                    static_cast<int>(-messageNumberOrResult)
+                );
+            }
+            return;
+        }
+
+        m_Workers[0]->Waiter.Notify();
+    }
+
+    int Server::FlushSendQueue()
+    {
+        m_SendBatch.clear();
+
+        // Held-back messages go out first once their connection is writable again
+        if (!m_CoalescedSends.empty())
+        {
+            std::erase_if(m_CoalescedSends, [this](const auto& entry)
+                {
+                    if (m_Congestion.IsCongested(entry.second->m_conn))
+                        return false;
+                    m_SendBatch.push_back(entry.second);
+                    return true;
+                });
+        }
+
+        int flushedCount = 0;
+        QueuedSend queuedSend;
+        while (m_SendQueue.TryPop(queuedSend))
+        {
+            flushedCount++;
+
+            if (queuedSend.Message)
+            {
+                if (!DivertCongestedSend(queuedSend.Message))
+                    m_SendBatch.push_back(queuedSend.Message);
                 continue;
-            SendBufferToClient(clientID, buffer, reliable);
+            }
+
+            // Broadcasts are resolved here against each worker's latest snapshot, taken once per flush
+            if (m_BroadcastTargets.empty())
+            {
+                for (const auto& worker : m_Workers)
+                    m_BroadcastTargets.push_back(worker->Clients.GetSnapshot());
+            }
+
+            for (const ClientRegistry::Snapshot& clients : m_BroadcastTargets)
+            {
+                for (const ClientInfo& client : *clients)
+                {
+                    if (client.ID == queuedSend.ExcludeClientID)
+                        continue;
+
+                    SteamNetworkingMessage_t* message = queuedSend.Payload->CreateMessage(client.ID, queuedSend.Flags, queuedSend.Lane);
+                    if (!DivertCongestedSend(message))
+                        m_SendBatch.push_back(message);
+                }
+            }
+            queuedSend.Payload->Release();
         }
+
+        m_BroadcastTargets.clear();
+
+        if (m_SendBatch.empty())
+            return flushedCount;
+
+        // The library owns the messages once they are sent, so note their sizes first
+        const int messageCount = static_cast<int>(m_SendBatch.size());
+        m_SendBatchSizes.resize(messageCount);
+        for (int i = 0; i < messageCount; i++)
+        {
+            m_SendBatchSizes[i] = m_SendBatch[i]->m_cbSize;
+            if ((m_SendBatch[i]->m_nFlags & k_nSteamNetworkingSend_NoNagle) == 0)
+                m_NagledConnections.push_back(m_SendBatch[i]->m_conn);
+        }
+
+        // Keep the list bounded by the number of connections when EndFrame() is called rarely or never
+        if (m_NagledConnections.size() > k_NagledConnectionsCompactThreshold)
+            CompactNagledConnections();
+
+        m_SendBatchResults.resize(messageCount);
+        m_Interface->SendMessages(messageCount, m_SendBatch.data(), m_SendBatchResults.data());
+
+        int failedCount = 0;
+        uint64_t sentBytes = 0;
+        for (int i = 0; i < messageCount; i++)
+        {
+            if (m_SendBatchResults[i] < 0)
+                failedCount++;
+            else
+                sentBytes += static_cast<uint64_t>(m_SendBatchSizes[i]);
+        }
+
+        m_Metrics.AddSent(static_cast<uint64_t>(messageCount - failedCount), sentBytes);
+        if (failedCount > 0)
+        {
+            m_Metrics.AddSendFailures(static_cast<uint64_t>(failedCount));
+            UT_WARN_TAG("SERVER", "SendMessages failed for {} of {} queued messages", failedCount, messageCount);
+        }
+
+        return flushedCount;
     }
 
-    void Server::SendStringToClient(ClientID clientID, const std::string& string, bool reliable)
+    void Server::EndFrame()
+    {
+        if (!m_Running.load())
+            return;
+
+        m_EndFrameRequested.store(true, std::memory_order_release);
+        m_Workers[0]->Waiter.Notify();
+    }
+
+    void Server::FlushEndOfFrame()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_DirectNagledMutex);
+            m_NagledConnections.insert(m_NagledConnections.end(), m_DirectNagledConnections.begin(), m_DirectNagledConnections.end());
+            m_DirectNagledConnections.clear();
+        }
+
+        if (m_NagledConnections.empty())
+            return;
+
+        CompactNagledConnections();
+        for (HSteamNetConnection connection : m_NagledConnections)
+            m_Interface->FlushMessagesOnConnection(connection);
+
+        m_NagledConnections.clear();
+    }
+
+    void Server::CompactNagledConnections()
+    {
+        std::sort(m_NagledConnections.begin(), m_NagledConnections.end());
+        m_NagledConnections.erase(std::unique(m_NagledConnections.begin(), m_NagledConnections.end()), m_NagledConnections.end());
+    }
+
+    void Server::TrackDirectNagledSends(std::span<const ClientID> clientIDs, SendFlags flags)
+    {
+        if (flags.IsNoNagle())
+            return;
+
+        std::lock_guard<std::mutex> lock(m_DirectNagledMutex);
+        m_DirectNagledConnections.insert(m_DirectNagledConnections.end(), clientIDs.begin(), clientIDs.end());
+
+        // Bounded like m_NagledConnections, for when EndFrame() is called rarely or never
+        if (m_DirectNagledConnections.size() > k_NagledConnectionsCompactThreshold)
+        {
+            std::sort(m_DirectNagledConnections.begin(), m_DirectNagledConnections.end());
+            m_DirectNagledConnections.erase(std::unique(m_DirectNagledConnections.begin(), m_DirectNagledConnections.end()), m_DirectNagledConnections.end());
+        }
+    }
+
+    void Server::SampleConnections()
+    {
+        const auto now = std::chrono::steady_clock::now();
+
+        // Nothing to learn about lanes from a single one
+        const bool sampleLanes = m_LaneConfig.GetLaneCount() > 1 && now - m_LastLaneSample >= k_LaneStatsInterval;
+        const bool sampleTelemetry = m_TelemetryInterval.count() > 0 && now - m_LastTelemetrySample >= m_TelemetryInterval;
+        const bool checkFlowControl = now - m_LastFlowControlCheck >= m_FlowControlConfig.CheckInterval;
+        if (!sampleLanes && !sampleTelemetry && !checkFlowControl)
+            return;
+
+        m_SampleConnections.clear();
+        for (const auto& worker : m_Workers)
+        {
+            const ClientRegistry::Snapshot clients = worker->Clients.GetSnapshot();
+            for (const ClientInfo& client : *clients)
+                m_SampleConnections.push_back(client.ID);
+        }
+
+        if (checkFlowControl)
+        {
+            m_LastFlowControlCheck = now;
+            CheckFlowControl(m_SampleConnections);
+        }
+
+        if (sampleLanes)
+        {
+            m_LastLaneSample = now;
+            m_LaneStats.Sample(m_Interface, m_SampleConnections);
+        }
+
+        if (sampleTelemetry)
+        {
+            m_LastTelemetrySample = now;
+            m_Metrics.SampleConnections(m_Interface, m_SampleConnections);
+        }
+    }
+
+    bool Server::DivertCongestedSend(SteamNetworkingMessage_t* message)
+    {
+        if (m_FlowControlConfig.UnreliablePolicy == CongestedUnreliablePolicy::Send ||
+            (message->m_nFlags & k_nSteamNetworkingSend_Reliable) != 0 ||
+            !m_Congestion.IsCongested(message->m_conn))
+        {
+            return false;
+        }
+
+        if (m_FlowControlConfig.UnreliablePolicy == CongestedUnreliablePolicy::Drop)
+        {
+            message->Release();
+            m_Metrics.AddDropped(1);
+            return true;
+        }
+
+        // Coalesce: the newest state supersedes whatever is still waiting on this lane
+        const uint64_t key = (static_cast<uint64_t>(message->m_conn) << 16) | message->m_idxLane;
+        auto [it, inserted] = m_CoalescedSends.try_emplace(key, message);
+        if (!inserted)
+        {
+            it->second->Release();
+            it->second = message;
+            m_Metrics.AddDropped(1);
+        }
+        return true;
+    }
+
+    void Server::CheckFlowControl(std::span<const HSteamNetConnection> connections)
+    {
+        for (HSteamNetConnection connection : connections)
+        {
+            SteamNetConnectionRealTimeStatus_t status;
+            if (m_Interface->GetConnectionRealTimeStatus(connection, &status, 0, nullptr) != k_EResultOK)
+                continue;
+
+            if (m_FlowControlConfig.IsAboveHighWatermark(status))
+                m_Congestion.MarkCongested(connection);
+            else if (m_FlowControlConfig.IsBelowLowWatermark(status) && m_Congestion.MarkWritable(connection))
+            {
+                PostWritable(connection);
+            }
+        }
+
+        // Forget clients that left while congested
+        if (m_Congestion.HasCongestion())
+        {
+            m_SortedConnections.assign(connections.begin(), connections.end());
+            std::sort(m_SortedConnections.begin(), m_SortedConnections.end());
+            m_Congestion.Prune(m_SortedConnections);
+        }
+    }
+
+    void Server::PostWritable(HSteamNetConnection connection)
+    {
+        // The owning worker runs the callback, like every other callback for this client
+        if (Worker* worker = FindWorker(m_Interface->GetConnectionUserData(connection)))
+            PostConnectionEvent(*worker, ConnectionEvent::Type::Writable, connection);
+
+        // Coalesced messages for it go out on the next flush
+        m_Workers[0]->Waiter.Notify();
+    }
+
+    SendStatus Server::TrySendBufferToClient(ClientID clientID, Buffer buffer, SendFlags flags, uint16_t lane)
+    {
+        if (!m_Running.load() || !m_Interface)
+            return SendStatus::NotConnected;
+
+        const HSteamNetConnection connection = static_cast<HSteamNetConnection>(clientID);
+
+        SteamNetConnectionRealTimeStatus_t status;
+        if (m_Interface->GetConnectionRealTimeStatus(connection, &status, 0, nullptr) != k_EResultOK)
+            return SendStatus::NotConnected;
+
+        // Same hysteresis as CheckFlowControl, so this works even with periodic checks disabled
+        if (m_Congestion.IsCongested(connection))
+        {
+            if (!m_FlowControlConfig.IsBelowLowWatermark(status))
+                return SendStatus::WouldBlock;
+
+            if (m_Congestion.MarkWritable(connection))
+                PostWritable(connection);
+        }
+        else if (m_FlowControlConfig.IsAboveHighWatermark(status))
+        {
+            m_Congestion.MarkCongested(connection);
+            return SendStatus::WouldBlock;
+        }
+
+        SendBufferToClient(clientID, buffer, flags, lane);
+        return SendStatus::Queued;
+    }
+
+    void Server::ReleaseQueuedSends()
+    {
+        for (const auto& [key, message] : m_CoalescedSends)
+            message->Release();
+        m_CoalescedSends.clear();
+
+        QueuedSend queuedSend;
+        while (m_SendQueue.TryPop(queuedSend))
+        {
+            if (queuedSend.Message)
+                queuedSend.Message->Release();
+            else
+                queuedSend.Payload->Release();
+        }
+    }
+
+    void Server::SendBufferToClients(std::span<const ClientID> clientIDs, Buffer buffer, SendFlags flags, std::vector<SendResult>* outResults, uint16_t lane)
+    {
+        if (!m_CompressionConfig.IsEnabled() || clientIDs.empty())
+        {
+            SendFramedBufferToClients(clientIDs, buffer, flags, outResults, lane);
+            return;
+        }
+
+        const OutgoingMessage encoded = EncodeOutgoingPayload(buffer, k_HSteamNetConnection_Invalid, lane);
+        SendFramedBufferToClients(clientIDs, encoded.GetBuffer(), flags, outResults, lane);
+    }
+
+    void Server::SendFramedBufferToClients(std::span<const ClientID> clientIDs, Buffer buffer, SendFlags flags, std::vector<SendResult>* outResults, uint16_t lane)
+    {
+        if (!m_Interface || !m_Running.load())
+        {
+            if (!m_Replaying.load(std::memory_order_relaxed))
+                UT_WARN_TAG("SERVER", "Cannot send data; server is not running");
+            return;
+        }
+
+        if (clientIDs.empty())
+            return;
+
+        const int sendFlags = flags.GetValue();
+        const int messageCount = static_cast<int>(clientIDs.size());
+
+        // One copy of the payload, shared by every outgoing message
+        SharedPayload* payload = SharedPayload::Create(buffer.Data, static_cast<uint32_t>(buffer.Size));
+
+        std::vector<SteamNetworkingMessage_t*> messages(messageCount);
+        for (int i = 0; i < messageCount; i++)
+            messages[i] = payload->CreateMessage(static_cast<HSteamNetConnection>(clientIDs[i]), sendFlags, lane);
+
+        // The messages hold their own references now
+        payload->Release();
+
+        TrackDirectNagledSends(clientIDs, flags);
+
+        std::vector<int64> messageNumberOrResult(messageCount);
+        m_Interface->SendMessages(messageCount, messages.data(), messageNumberOrResult.data());
+
+        int failedCount = 0;
+        if (outResults)
+        {
+            outResults->clear();
+            outResults->reserve(messageCount);
+        }
+
+        for (int i = 0; i < messageCount; i++)
+        {
+            const int64 value = messageNumberOrResult[i];
+            const EResult result = value < 0 ? static_cast<EResult>(-value) : k_EResultOK;
+            if (result != k_EResultOK)
+                failedCount++;
+
+            if (outResults)
+                outResults->push_back({ clientIDs[i], result, value < 0 ? 0 : value });
+        }
+
+        m_Metrics.AddSent(static_cast<uint64_t>(messageCount - failedCount), static_cast<uint64_t>(messageCount - failedCount) * buffer.Size);
+        if (failedCount > 0)
+        {
+            m_Metrics.AddSendFailures(static_cast<uint64_t>(failedCount));
+            UT_WARN_TAG("SERVER", "SendMessages failed for {} of {} clients", failedCount, messageCount);
+        }
+    }
+
+    std::vector<SendResult> Server::BroadcastBuffer(Buffer buffer, ClientID excludeClientID, SendFlags flags, uint16_t lane)
+    {
+        std::vector<SendResult> results;
+        SendBufferToClients(CollectClientIDs(excludeClientID), buffer, flags, &results, lane);
+        return results;
+    }
+
+    std::vector<ClientID> Server::CollectClientIDs(ClientID excludeClientID) const
+    {
+        std::vector<ClientID> clientIDs;
+        for (const auto& worker : m_Workers)
+        {
+            const ClientRegistry::Snapshot clients = worker->Clients.GetSnapshot();
+            for (const ClientInfo& client : *clients)
+            {
+                if (client.ID == excludeClientID)
+                    continue;
+                clientIDs.push_back(client.ID);
+            }
+        }
+        return clientIDs;
+    }
+
+    ClientRegistry::Snapshot Server::GetConnectedClients() const
+    {
+        if (m_Workers.empty())
+            return std::make_shared<const std::vector<ClientInfo>>();
+
+        if (m_Workers.size() == 1)
+            return m_Workers[0]->Clients.GetSnapshot();
+
+        auto clients = std::make_shared<std::vector<ClientInfo>>();
+        for (const auto& worker : m_Workers)
+        {
+            const ClientRegistry::Snapshot workerClients = worker->Clients.GetSnapshot();
+            clients->insert(clients->end(), workerClients->begin(), workerClients->end());
+        }
+        return clients;
+    }
+
+    void Server::SendStringToClient(ClientID clientID, const std::string& string, SendFlags flags, uint16_t lane)
     {
         SendBufferToClient(
             clientID,
             Buffer(string.data(), string.size()),
-            reliable
+            flags,
+            lane
         );
     }
 
-    void Server::SendStringToAllClients(const std::string& string, ClientID excludeClientID, bool reliable)
+    void Server::SendStringToAllClients(const std::string& string, ClientID excludeClientID, SendFlags flags, uint16_t lane)
     {
         SendBufferToAllClients(
             Buffer(string.data(), string.size()),
             excludeClientID,
-            reliable
+            flags,
+            lane
         );
     }
 
@@ -344,16 +1667,15 @@ namespace Utopia {
             return;
         }
 
-        bool success = m_Interface->CloseConnection(
-            static_cast<HSteamNetConnection>(clientID),
-            0,
-            "Kicked by host",
-            false
-        );
-        if (!success)
+        // Let the owning worker close it so the disconnect callback runs on the client's thread
+        const HSteamNetConnection connection = static_cast<HSteamNetConnection>(clientID);
+        if (Worker* worker = FindWorker(m_Interface->GetConnectionUserData(connection)))
         {
-            UT_WARN_TAG("SERVER", "CloseConnection returned false when kicking ClientID {}", static_cast<uint32_t>(clientID));
+            PostConnectionEvent(*worker, ConnectionEvent::Type::Kick, connection);
+            return;
         }
+
+        UT_WARN_TAG("SERVER", "Cannot kick ClientID {}; it is not connected to this server", static_cast<uint32_t>(clientID));
     }
 
     void Server::OnFatalError(const std::string& message)
@@ -2,35 +2,95 @@
 
 #include "Utopia/Core/Buffer.hpp"
 
+#include "ClientRegistry.hpp"
+#include "Compression.hpp"
+#include "Executor.hpp"
+#include "FlowControl.hpp"
+#include "MessageHandle.hpp"
+#include "MessageProtocol.hpp"
+#include "MessagePool.hpp"
+#include "MpscQueue.hpp"
+#include "NetworkLanes.hpp"
+#include "NetworkConditions.hpp"
+#include "NetworkMetrics.hpp"
+#include "NetworkWaiter.hpp"
+#include "NetworkingRuntime.hpp"
+#include "SendFlags.hpp"
+#include "SessionResumption.hpp"
+#include "SharedPayload.hpp"
+#include "TickLoop.hpp"
+#include "TrafficCapture.hpp"
+
 #include <steam/steamnetworkingsockets.h>
 #include <steam/isteamnetworkingutils.h>
 #ifndef STEAMNETWORKINGSOCKETS_OPENSOURCE
 #include <steam/steam_api.h>
 #endif
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <string>
-#include <map>
+#include <span>
+#include <unordered_map>
+#include <vector>
 #include <thread>
 #include <functional>
 #include <atomic>
 #include <mutex>
+#include <optional>
 
 namespace Utopia {
 
-    using ClientID = HSteamNetConnection;
 
-    struct ClientInfo
+    // Per-client outcome of a fan-out send
+    struct SendResult
+    {
+        ClientID Client;
+        EResult Result;         // k_EResultOK on success
+        int64_t MessageNumber;  // Only meaningful when Result is k_EResultOK
+    };
+
+    // One entry of a received batch. Client and Payload are only valid during the callback.
+    struct ReceivedMessage
     {
-        ClientID ID;
-        std::string ConnectionDesc;
+        const ClientInfo* Client;
+        Buffer Payload;
+    };
+
+    // How new connections are spread across network workers
+    enum class WorkerAssignmentPolicy
+    {
+        RoundRobin = 0,
+        LeastLoaded,
+        // Hash of the remote IP, so a reconnecting client lands on the same worker
+        ClientHash
+    };
+
+    struct ServerWorkerConfig
+    {
+        // Each worker owns a poll group and a thread; worker 0 runs on the main network thread
+        uint32_t WorkerCount = 1;
+        WorkerAssignmentPolicy Assignment = WorkerAssignmentPolicy::RoundRobin;
+
+        // Overrides Assignment when set. Must return an index below workerCount.
+        std::function<uint32_t(const SteamNetConnectionInfo_t& info, uint32_t workerCount)> AssignmentFunction;
     };
 
     class Server
     {
     public:
+        static constexpr std::chrono::milliseconds k_LaneStatsInterval{ 100 };
+
         using DataReceivedCallback = std::function<void(const ClientInfo&, const Buffer)>;
+        using DataBatchReceivedCallback = std::function<void(std::span<const ReceivedMessage>)>;
+        // Ownership of the message moves into the callback; keep the handle to defer processing without a copy
+        using MessageReceivedCallback = std::function<void(const ClientInfo&, MessageHandle)>;
         using ClientConnectedCallback = std::function<void(const ClientInfo&)>;
         using ClientDisconnectedCallback = std::function<void(const ClientInfo&)>;
+        using ClientWritableCallback = std::function<void(const ClientInfo&)>;
+        // The client has a new ClientID; move whatever was kept under previousID over to it
+        using ClientResumedCallback = std::function<void(const ClientInfo& client, ClientID previousID)>;
 
     public:
         explicit Server(int port);
@@ -45,54 +105,345 @@ namespace Utopia {
         //////////////////////////////////////////////////////////////////////////////////////////////////
         // Start and Stop the server
         //////////////////////////////////////////////////////////////////////////////////////////////////
+        // Listens before returning; IsRunning() tells whether that worked
         void Start();
         void Stop();
 
+        // Selects how the network thread idles between polls. Takes effect on the next Start().
+        void SetNetworkThreadConfig(const NetworkThreadConfig& config) { m_NetworkThreadConfig = config; }
+        const NetworkThreadConfig& GetNetworkThreadConfig() const { return m_NetworkThreadConfig; }
+
+        // Shards connections across several network workers. Takes effect on the next Start().
+        // With BusyPoll and a PinnedCore, worker N is pinned to PinnedCore + N.
+        void SetWorkerConfig(const ServerWorkerConfig& config) { m_WorkerConfig = config; }
+        const ServerWorkerConfig& GetWorkerConfig() const { return m_WorkerConfig; }
+
+        // Watermarks for TrySendBufferToClient and the congested-client unreliable policy. Takes effect on the next Start().
+        void SetFlowControlConfig(const FlowControlConfig& config) { m_FlowControlConfig = config; }
+        const FlowControlConfig& GetFlowControlConfig() const { return m_FlowControlConfig; }
+
+        // Payload compression for every client; clients must use the same codec. Takes effect on the next Start().
+        void SetCompressionConfig(const CompressionConfig& config) { m_PendingCompressionConfig = config; }
+        const CompressionConfig& GetCompressionConfig() const { return m_PendingCompressionConfig; }
+
+        // Lanes configured on every accepted connection. Takes effect on the next Start().
+        void SetLaneConfig(const LaneConfig& config) { m_LaneConfig = config; }
+        const LaneConfig& GetLaneConfig() const { return m_LaneConfig; }
+
+        // Simulated loss, latency and rate limits, applied when the network thread starts on the next Start()
+        // or right away while running. Conditions are process-wide, see NetworkConditions.
+        void SetNetworkConditions(const NetworkConditionProfile& profile, ConditionDirection direction = ConditionDirection::Send);
+        // Only resets the process-wide conditions if this instance's profile is still the active one
+        void ClearNetworkConditions();
+
+        // Queue time per lane, sampled across all clients every k_LaneStatsInterval
+        std::vector<LaneStats> GetLaneStats() const { return m_LaneStats.GetStats(); }
+
+        // Counters and per-connection telemetry, readable from any thread. Export with GetMetrics().ExportPrometheus().
+        const MetricsRegistry& GetMetrics() const { return m_Metrics; }
+        // How often every connection's real-time status is sampled; zero disables sampling. Takes effect on the next Start().
+        void SetTelemetryInterval(std::chrono::milliseconds interval) { m_TelemetryInterval = interval; }
+
+        // Maximum number of messages drained from the library per receive call. Takes effect on the next Start().
+        void SetReceiveBatchSize(int maxMessages) { m_ReceiveBatchSize = maxMessages > 0 ? maxMessages : 1; }
+        int GetReceiveBatchSize() const { return m_ReceiveBatchSize; }
+
+        // Records every inbound message and connection event into capture until replaced; nullptr stops
+        // recording. Clients already connected are recorded as connecting. Safe from any thread.
+        // Feed the capture back through the callbacks with TrafficReplay.
+        void SetTrafficCapture(std::shared_ptr<TrafficCapture> capture);
+        std::shared_ptr<TrafficCapture> GetTrafficCapture() const { return m_TrafficCapture.load(std::memory_order_acquire); }
+
+        // Session resumption, see SessionResumption.hpp. While enabled, a client is only announced once its
+        // hello says whether it is new or coming back, and one that drops without hanging up is held for
+        // ResumeTimeout: the disconnected callback only fires if it has not returned by then. Messages with
+        // the session IDs are taken out of the stream. Takes effect on the next Start().
+        void SetSessionConfig(const SessionConfig& config) { m_SessionConfig = config; }
+        const SessionConfig& GetSessionConfig() const { return m_SessionConfig; }
+
         //////////////////////////////////////////////////////////////////////////////////////////////////
         // Set callbacks for server events
-        // These callbacks will be called from the server thread
+        // These callbacks will be called from the network worker that owns the client, unless a callback
+        // executor is set. With more than one worker they run concurrently for different clients, but
+        // every callback for a given client runs on the same thread, in order.
         //////////////////////////////////////////////////////////////////////////////////////////////////
         void SetDataReceivedCallback(const DataReceivedCallback& function);
+        // Takes precedence over the per-message DataReceivedCallback when set
+        void SetDataBatchReceivedCallback(const DataBatchReceivedCallback& function);
+        // Takes precedence over DataReceivedCallback, but not over DataBatchReceivedCallback
+        void SetMessageReceivedCallback(const MessageReceivedCallback& function);
         void SetClientConnectedCallback(const ClientConnectedCallback& function);
         void SetClientDisconnectedCallback(const ClientDisconnectedCallback& function);
+        // Called when a congested client falls back under the low watermark
+        void SetClientWritableCallback(const ClientWritableCallback& function);
+        // Called instead of the connected callback when a client resumes its session on a new connection.
+        // Reliable messages it sent that never arrived follow, in order; what the server sent it while it
+        // was away is not replayed, so bring it up to date here.
+        void SetClientResumedCallback(const ClientResumedCallback& function);
+
+        // Where the callbacks run. The default InlineExecutor calls them on the network workers; any other
+        // executor takes them off the socket path, so a slow handler only delays its own client. Each client's
+        // callbacks are posted with PostOrdered() keyed by its ClientID: they stay in order, while different
+        // clients may run in parallel on a ThreadPoolExecutor. Batch callbacks then see one client per batch.
+        // Stopping waits for every queued callback to run, so the executor must outlive the server and, if it
+        // is a ManualExecutor, keep being run after Stop() until HasPendingCallbacks() turns false.
+        // Ignored in tick mode. Takes effect on the next Start().
+        void SetCallbackExecutor(Executor& executor) { m_CallbackExecutor = &executor; }
+        // True from Start() until the network thread has stopped and every callback it queued has run
+        bool HasPendingCallbacks() const { return m_PendingDispatches.load() > 0; }
+
+        //////////////////////////////////////////////////////////////////////////////////////////////////
+        // Tick mode
+        // Instead of the data and connection callbacks firing on the network workers, received messages
+        // and connects/disconnects are queued for the game thread, which takes them once per tick:
+        //   for (TickEvent& event : server.BeginTick()) { ... }
+        //   ... simulate and send ...
+        //   server.EndTick();
+        //////////////////////////////////////////////////////////////////////////////////////////////////
+        // Takes effect on the next Start()
+        void SetTickMode(bool enabled) { m_TickMode = enabled; }
+        bool IsTickMode() const { return m_TickMode; }
+
+        // Game thread. Every event since the previous BeginTick(), in arrival order for each client.
+        // Connection details of a new client are in GetConnectedClients() by the time its event is seen.
+        std::span<TickEvent> BeginTick() { return m_TickInbox.Swap(); }
+        // Game thread. Sends everything queued during the tick together, see EndFrame().
+        void EndTick() { EndFrame(); }
 
         //////////////////////////////////////////////////////////////////////////////////////////////////
         // Send Data
+        // Safe to call from any thread. Sends are queued without locks and flushed by the network
+        // thread in one SendMessages call per loop iteration.
+        // lane indexes the LaneConfig; reliable messages are only ordered relative to their own lane.
+        // Messages sent without SendFlags::NoNagle wait briefly to be batched; EndFrame() sends them right away.
         //////////////////////////////////////////////////////////////////////////////////////////////////
-        void SendBufferToClient(ClientID clientID, Buffer buffer, bool reliable = true);
-        void SendBufferToAllClients(Buffer buffer, ClientID excludeClientID = 0, bool reliable = true);
+        void SendBufferToClient(ClientID clientID, Buffer buffer, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+        void SendBufferToAllClients(Buffer buffer, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+
+        // Copies the payload once and fans it out to every target in a single SendMessages call.
+        // These bypass the queue and send on the calling thread so they can report results;
+        // pass outResults to learn which sends failed, otherwise failures are only logged.
+        void SendBufferToClients(std::span<const ClientID> clientIDs, Buffer buffer, SendFlags flags = SendFlags::Reliable, std::vector<SendResult>* outResults = nullptr, uint16_t lane = 0);
+        std::vector<SendResult> BroadcastBuffer(Buffer buffer, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+
+        // Sends a pooled message the caller serialized into directly; no copy is made
+        void SendOutgoingMessageToClient(ClientID clientID, OutgoingMessage message, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
 
-        void SendStringToClient(ClientID clientID, const std::string& string, bool reliable = true);
-        void SendStringToAllClients(const std::string& string, ClientID excludeClientID = 0, bool reliable = true);
+        // Like SendBufferToClient, but refuses with WouldBlock while the client is over its high watermark.
+        // Wait for the writable callback before trying again.
+        SendStatus TrySendBufferToClient(ClientID clientID, Buffer buffer, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+        bool IsClientCongested(ClientID clientID) const { return m_Congestion.IsCongested(static_cast<HSteamNetConnection>(clientID)); }
+
+        void SendStringToClient(ClientID clientID, const std::string& string, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
+        void SendStringToAllClients(const std::string& string, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0);
 
         template<typename T>
-        void SendDataToClient(ClientID clientID, const T& data, bool reliable = true)
+        void SendDataToClient(ClientID clientID, const T& data, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
         {
-            SendBufferToClient(clientID, Buffer(&data, sizeof(T)), reliable);
+            SendBufferToClient(clientID, Buffer(&data, sizeof(T)), flags, lane);
         }
 
         template<typename T>
-        void SendDataToAllClients(const T& data, ClientID excludeClientID = 0, bool reliable = true)
+        SendStatus TrySendDataToClient(ClientID clientID, const T& data, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
         {
-            SendBufferToAllClients(Buffer(&data, sizeof(T)), excludeClientID, reliable);
+            return TrySendBufferToClient(clientID, Buffer(&data, sizeof(T)), flags, lane);
         }
+
+        template<typename T>
+        void SendDataToAllClients(const T& data, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            SendBufferToAllClients(Buffer(&data, sizeof(T)), excludeClientID, flags, lane);
+        }
+
+        // Typed messages carry a MessageHeader; dispatch them on the receiving side with MessageProtocol
+        template<NetworkMessage T>
+        void SendMessageToClient(ClientID clientID, const T& message, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            SendOutgoingMessageToClient(clientID, EncodeMessage(message), flags, lane);
+        }
+
+        template<NetworkMessage T>
+        void SendMessageToAllClients(const T& message, ClientID excludeClientID = 0, SendFlags flags = SendFlags::Reliable, uint16_t lane = 0)
+        {
+            // Serialized straight into the payload every recipient shares
+            SharedPayload* payload = SharedPayload::Create(GetEncodedMessageSize(message));
+            EncodeMessage(message, std::span<std::byte>(static_cast<std::byte*>(payload->GetMutableData()), payload->GetSize()));
+            SendPayloadToAllClients(payload, excludeClientID, flags, lane);
+        }
+
+        // Call at the end of a server tick. Everything sent before this call goes out together on the
+        // network thread's next iteration instead of waiting out Nagle's delay, including direct sends
+        // such as SendBufferToClients() and BroadcastBuffer().
+        void EndFrame();
         //////////////////////////////////////////////////////////////////////////////////////////////////
 
         void KickClient(ClientID clientID);
 
         bool IsRunning() const { return m_Running.load(); }
-        const std::map<HSteamNetConnection, ClientInfo>& GetConnectedClients() const { return m_ConnectedClients; }
+        // Immutable snapshot of the connected clients across all workers, safe to read from any thread
+        ClientRegistry::Snapshot GetConnectedClients() const;
 
     private:
+        // Invokes the callbacks directly
+        friend class TrafficReplay;
+
+        // One client's share of a receive batch, handed to the callback executor. Holds a copy of the
+        // client, since the registry entry may be gone by the time the callbacks run.
+        struct DispatchBatch
+        {
+            ClientInfo Client;
+            std::vector<MessageHandle> Messages;
+        };
+
+        // Connection changes are detected on the main network thread and handed to the owning
+        // worker, so a client's connect, data and disconnect callbacks all run on one thread
+        struct ConnectionEvent
+        {
+            // Drop is a close the client may come back from. Supersede closes a connection whose session was
+            // resumed elsewhere; Resume hands the session over to the new connection once that is done.
+            // Expire announces a parked session's client as gone; Connection is its last ClientID.
+            enum class Type { Accept, Close, Drop, Kick, Writable, Supersede, Resume, Expire };
+
+            Type EventType;
+            HSteamNetConnection Connection;
+        };
+
+        // Worker thread only, indexed by registry slot
+        struct ClientSession
+        {
+            // Before the handshake completes, the token the client asked to resume, if any
+            SessionToken Token;
+            bool Established = false;
+            // Reliable messages received per lane, and whether that changed since the last ack
+            std::vector<uint64_t> LaneCounts;
+            bool AckDue = false;
+        };
+
+        // Every session, keyed by token. Live while a connection holds it, parked while it waits for its client.
+        struct SessionRecord
+        {
+            HSteamNetConnection Connection = k_HSteamNetConnection_Invalid;
+            uint32_t Worker = 0;
+            // A new connection waiting for the live one to be superseded
+            HSteamNetConnection ResumingConnection = k_HSteamNetConnection_Invalid;
+            uint32_t ResumingWorker = 0;
+
+            // Parked only
+            ClientInfo Client{};
+            std::vector<uint64_t> LaneCounts;
+            std::chrono::steady_clock::time_point Expiry;
+        };
+
+        struct Worker
+        {
+            uint32_t Index = 0;
+            std::thread Thread; // Unused for worker 0, which runs on m_NetworkThread
+            HSteamNetPollGroup PollGroup = k_HSteamNetPollGroup_Invalid;
+            NetworkWaiter Waiter;
+
+            // Owned by this worker's thread; other threads go through its snapshot
+            ClientRegistry Clients;
+            // Connections assigned here, from assignment on the main thread until removed; what LeastLoaded balances
+            std::atomic<uint32_t> ClientCount{ 0 };
+
+            // Reused every poll so the receive path does not allocate
+            std::vector<ISteamNetworkingMessage*> ReceiveBuffer;
+            std::vector<ReceivedMessage> ReceivedBatch;
+            // Staged per receive batch in tick mode, so the inbox is locked once per batch
+            std::vector<TickEvent> TickEvents;
+            // Staged per receive batch when callbacks run on an executor, so each client gets one post
+            std::unordered_map<ClientID, std::shared_ptr<DispatchBatch>> DispatchBatches;
+            // One per batch entry, since decompressed payloads must outlive the whole batch
+            std::vector<std::vector<std::byte>> DecompressBuffers;
+
+            std::vector<ClientSession> Sessions;
+            std::chrono::steady_clock::time_point NextSessionAck;
+
+            std::mutex EventMutex;
+            std::vector<ConnectionEvent> PendingEvents;
+            std::vector<ConnectionEvent> ProcessingEvents;
+            // The clients of Expire events, in event order; their connections are gone, so they travel here
+            std::vector<ClientInfo> PendingExpiries;
+            std::vector<ClientInfo> ProcessingExpiries;
+        };
+
+    private:
+        // Acquires the runtime, creates the poll groups and opens the listen socket. Releases it all on failure.
+        bool Listen();
         void NetworkThreadFunc();
+        void WorkerThreadFunc(Worker& worker);
+
+        void ReleaseRuntime();
 
-        static void ConnectionStatusChangedCallback(SteamNetConnectionStatusChangedCallback_t* info);
         void OnConnectionStatusChanged(SteamNetConnectionStatusChangedCallback_t* info);
 
-        void PollIncomingMessages();
+        uint32_t AssignWorker(const SteamNetConnectionInfo_t& info);
+        Worker* FindWorker(int64 connectionUserData) const;
+        void PostConnectionEvent(Worker& worker, ConnectionEvent::Type type, HSteamNetConnection connection);
+
+        // Worker thread only. Return the number of events or messages handled.
+        int ProcessConnectionEvents(Worker& worker);
+        int PollIncomingMessages(Worker& worker);
+        void AcceptClient(Worker& worker, HSteamNetConnection connection);
+        void RemoveClient(Worker& worker, HSteamNetConnection connection, const char* reason, bool resumable = false);
+
+        // Tick inbox, executor or inline, depending on how callbacks are delivered
+        void NotifyClientConnected(const ClientInfo& client);
+        void NotifyClientDisconnected(const ClientInfo& client);
+        void NotifyClientResumed(const ClientInfo& client, ClientID previousID);
+
+        // Worker thread only. Counts the message against the client's session, handling the hello;
+        // returns false if it must not reach the callbacks.
+        bool TrackSessionMessage(Worker& worker, const ClientInfo& client, const ISteamNetworkingMessage& message, Buffer payload);
+        // Takes over the session in the client's pending token if it is parked, supersedes its connection
+        // if it is still live, or starts a new one if there is none
+        void ResumeSession(Worker& worker, const ClientInfo& client);
+        void StartSession(Worker& worker, const ClientInfo& client);
+        // Parks the session for its client to resume if it may, otherwise ends it. Returns true if parked.
+        bool ParkSession(const ClientInfo& client, ClientSession& session, bool resumable);
+        void SendSessionAcks(Worker& worker);
+        // Network thread only. Fires the disconnected callback of sessions nobody came back for.
+        void ExpireSessions();
+
         void SetClientNick(HSteamNetConnection hConn, const char* nick);
-        void PollConnectionStateChanges();
+        std::vector<ClientID> CollectClientIDs(ClientID excludeClientID) const;
+        // Returns the number of status changes handled
+        int PollConnectionStateChanges();
+
+        // Network thread only. Returns the number of queued sends flushed.
+        int FlushSendQueue();
+        // Pushes out messages still held back by Nagle's delay
+        void FlushEndOfFrame();
+        void CompactNagledConnections();
+        // Any thread. Notes clients sent to directly, bypassing the send queue, without NoNagle.
+        void TrackDirectNagledSends(std::span<const ClientID> clientIDs, SendFlags flags);
+        // Lane stats and telemetry, each on its own interval
+        void SampleConnections();
+        void EnqueueSend(SteamNetworkingMessage_t* message);
+        void QueueMessageToClient(ClientID clientID, OutgoingMessage message, SendFlags flags, uint16_t lane);
+        // Any thread. Both take over the caller's reference to payload; QueueBroadcast() expects it framed for the wire.
+        void SendPayloadToAllClients(SharedPayload* payload, ClientID excludeClientID, SendFlags flags, uint16_t lane);
+        void QueueBroadcast(SharedPayload* payload, ClientID excludeClientID, SendFlags flags, uint16_t lane);
+        // Payload already framed for the wire, i.e. carrying a compression header when compression is enabled
+        void SendFramedBufferToClients(std::span<const ClientID> clientIDs, Buffer buffer, SendFlags flags, std::vector<SendResult>* outResults, uint16_t lane);
+        // Frames payload for the wire, compressing it if configured; connection is for the metrics only
+        OutgoingMessage EncodeOutgoingPayload(Buffer payload, HSteamNetConnection connection, uint16_t lane);
+        // Worker thread only. Strips the compression header of message i in the current receive batch.
+        bool DecodeIncomingPayload(Worker& worker, int index, Buffer& outPayload);
+        void ReleaseQueuedSends();
 
+        // Network thread only. Applies the congested-client policy; returns true if the message was dropped or held back.
+        bool DivertCongestedSend(SteamNetworkingMessage_t* message);
+        void CheckFlowControl(std::span<const HSteamNetConnection> connections);
+        void PostWritable(HSteamNetConnection connection);
+
+        // Worker thread only. Runs work on the callback executor in order with the client's other callbacks.
+        void Dispatch(ClientID clientID, Executor::Work work);
+        void RunDispatchBatch(DispatchBatch& batch);
+        // Drops the network thread's hold on m_PendingDispatches and waits for the executor to catch up
+        void WaitForDispatches();
+
+        void ApplyNetworkConditions();
         void OnFatalError(const std::string& message);
 
     private:
@@ -100,22 +451,102 @@ namespace Utopia {
 
         // Callbacks
         DataReceivedCallback       m_DataReceivedCallback;
+        DataBatchReceivedCallback  m_DataBatchReceivedCallback;
+        MessageReceivedCallback    m_MessageReceivedCallback;
         ClientConnectedCallback    m_ClientConnectedCallback;
         ClientDisconnectedCallback m_ClientDisconnectedCallback;
+        ClientWritableCallback     m_ClientWritableCallback;
+        ClientResumedCallback      m_ClientResumedCallback;
+
+        Executor* m_CallbackExecutor = &InlineExecutor::Get();
+        // Set by Start() when callbacks go through m_CallbackExecutor rather than being called inline
+        bool m_Dispatching = false;
+        // Callbacks queued and not yet run, plus one held by the network thread while it runs
+        std::atomic<size_t> m_PendingDispatches{ 0 };
+        std::mutex m_DispatchMutex;
+        std::condition_variable m_DispatchCondition;
 
         int m_Port;
         std::atomic_bool m_Running{ false };
+        bool m_TickMode = false;
+        TickInbox m_TickInbox;
 
-        std::map<HSteamNetConnection, ClientInfo> m_ConnectedClients;
+        // Set while TrafficReplay drives the callbacks, so their sends are dropped quietly
+        std::atomic_bool m_Replaying{ false };
 
-        ISteamNetworkingSockets* m_Interface = nullptr;
-        HSteamListenSocket  m_ListenSocket = k_HSteamListenSocket_Invalid;
-        HSteamNetPollGroup  m_PollGroup = k_HSteamNetPollGroup_Invalid;
+        NetworkThreadConfig m_NetworkThreadConfig;
+        ServerWorkerConfig m_WorkerConfig;
+        int m_ReceiveBatchSize = 64;
+
+        // What SetCompressionConfig() asked for, and the copy taken at start that the running instance uses.
+        // The codec must not change under the network threads, and the decompress buffers are sized for it.
+        CompressionConfig m_PendingCompressionConfig;
+        CompressionConfig m_CompressionConfig;
+
+        std::atomic<std::shared_ptr<TrafficCapture>> m_TrafficCapture;
+
+        SessionConfig m_SessionConfig;
+        std::mutex m_SessionMutex;
+        std::unordered_map<SessionToken, SessionRecord, SessionTokenHash> m_Sessions;
+        std::chrono::steady_clock::time_point m_NextSessionExpiry;
 
-        static Server* s_Instance;
+        std::optional<NetworkConditionProfile> m_NetworkConditions;
+        ConditionDirection m_NetworkConditionDirection = ConditionDirection::Send;
+        std::mutex m_NetworkConditionsMutex;
+        // Set once the network thread has applied them; later changes are applied immediately
+        bool m_NetworkConditionsStarted = false;
 
-        // Optional: a mutex if you want to guard callback assignment or client container
-        // mutable std::mutex m_Mutex;
+        LaneConfig m_LaneConfig;
+        LaneStatsCollector m_LaneStats;
+        std::chrono::steady_clock::time_point m_LastLaneSample;
+        std::vector<HSteamNetConnection> m_SampleConnections;
+        std::vector<HSteamNetConnection> m_SortedConnections;
+
+        FlowControlConfig m_FlowControlConfig;
+        CongestionTracker m_Congestion;
+        std::chrono::steady_clock::time_point m_LastFlowControlCheck;
+        // Newest unreliable message per congested connection and lane, keyed by (connection << 16) | lane
+        std::unordered_map<uint64_t, SteamNetworkingMessage_t*> m_CoalescedSends;
+
+        MetricsRegistry m_Metrics;
+        std::chrono::milliseconds m_TelemetryInterval{ 1000 };
+        std::chrono::steady_clock::time_point m_LastTelemetrySample;
+
+        // Built by Start(); m_Workers[0] is serviced by m_NetworkThread
+        std::vector<std::unique_ptr<Worker>> m_Workers;
+        uint32_t m_NextWorker = 0;
+
+        // A queued send is either one ready-to-go message, or a shared payload fanned out to every
+        // client except ExcludeClientID when it is drained
+        struct QueuedSend
+        {
+            SteamNetworkingMessage_t* Message = nullptr;
+            SharedPayload* Payload = nullptr;
+            ClientID ExcludeClientID = 0;
+            int Flags = 0;
+            uint16_t Lane = 0;
+        };
+
+        static constexpr size_t k_SendQueueCapacity = 8192;
+        MpscQueue<QueuedSend> m_SendQueue{ k_SendQueueCapacity };
+        std::vector<SteamNetworkingMessage_t*> m_SendBatch;
+        std::vector<int64> m_SendBatchResults;
+        std::vector<int> m_SendBatchSizes;
+        std::atomic_bool m_EndFrameRequested{ false };
+        // Network thread only. Connections sent to without NoNagle since the last end-of-frame flush.
+        std::vector<HSteamNetConnection> m_NagledConnections;
+        static constexpr size_t k_NagledConnectionsCompactThreshold = 4096;
+        // The same for direct sends, which happen on the caller's thread; merged in at the end of the frame
+        std::mutex m_DirectNagledMutex;
+        std::vector<HSteamNetConnection> m_DirectNagledConnections;
+        std::vector<ClientRegistry::Snapshot> m_BroadcastTargets;
+
+        NetworkingRuntime* m_Runtime = nullptr;
+        NetworkingRuntime::ListenerID m_StatusListener = NetworkingRuntime::k_InvalidListener;
+        ConnectionStatusInbox m_StatusInbox;
+
+        ISteamNetworkingSockets* m_Interface = nullptr;
+        HSteamListenSocket  m_ListenSocket = k_HSteamListenSocket_Invalid;
     };
 
 } // namespace Utopia
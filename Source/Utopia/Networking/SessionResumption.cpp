@@ -0,0 +1,218 @@
+#include "SessionResumption.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace Utopia {
+
+    namespace {
+
+        // Hello: token. Grant: token, resumed flag, lane count, counts. Ack: lane count, counts.
+        constexpr uint32_t k_TokenSize = 16;
+        constexpr uint32_t k_HelloSize = MessageHeader::k_Size + k_TokenSize;
+        constexpr uint32_t k_GrantHeaderSize = MessageHeader::k_Size + k_TokenSize + 1 + 2;
+        constexpr uint32_t k_AckHeaderSize = MessageHeader::k_Size + 2;
+
+        std::byte* WriteBytes(std::byte* out, const void* value, size_t size)
+        {
+            std::memcpy(out, value, size);
+            return out + size;
+        }
+
+        std::byte* WriteToken(std::byte* out, const SessionToken& token)
+        {
+            out = WriteBytes(out, &token.High, sizeof(token.High));
+            return WriteBytes(out, &token.Low, sizeof(token.Low));
+        }
+
+        const std::byte* ReadToken(const std::byte* in, SessionToken& outToken)
+        {
+            std::memcpy(&outToken.High, in, sizeof(outToken.High));
+            std::memcpy(&outToken.Low, in + sizeof(outToken.High), sizeof(outToken.Low));
+            return in + k_TokenSize;
+        }
+
+        std::byte* WriteLaneCounts(std::byte* out, std::span<const uint64_t> laneCounts)
+        {
+            const uint16_t laneCount = static_cast<uint16_t>(laneCounts.size());
+            out = WriteBytes(out, &laneCount, sizeof(laneCount));
+            return WriteBytes(out, laneCounts.data(), laneCounts.size_bytes());
+        }
+
+        bool ReadLaneCounts(const std::byte* in, size_t size, std::vector<uint64_t>& outLaneCounts)
+        {
+            uint16_t laneCount;
+            std::memcpy(&laneCount, in, sizeof(laneCount));
+            if (size != sizeof(laneCount) + laneCount * sizeof(uint64_t))
+                return false;
+
+            outLaneCounts.resize(laneCount);
+            std::memcpy(outLaneCounts.data(), in + sizeof(laneCount), laneCount * sizeof(uint64_t));
+            return true;
+        }
+
+        bool CheckHeader(Buffer payload, MessageTypeID expectedID, uint32_t minSize)
+        {
+            MessageTypeID id;
+            return PeekMessageTypeID(payload, id) && id == expectedID && payload.Size >= minSize;
+        }
+
+    } // anonymous namespace
+
+    std::chrono::milliseconds ReconnectConfig::GetRetryDelay(uint32_t attempt, double random) const
+    {
+        const double maxDelay = static_cast<double>(MaxDelay.count());
+        const double backoff = std::min(maxDelay, static_cast<double>(InitialDelay.count()) * std::pow(Multiplier, static_cast<double>(attempt)));
+        const double jitter = std::clamp(Jitter, 0.0, 1.0) * std::clamp(random, 0.0, 1.0);
+        return std::chrono::milliseconds(static_cast<int64_t>(backoff * (1.0 - jitter)));
+    }
+
+    SessionToken SessionToken::Generate()
+    {
+        // Tokens are rare and must not be guessable from one another, so draw each from the OS
+        std::random_device device;
+        SessionToken token;
+        while (!token.IsValid())
+        {
+            token.High = (static_cast<uint64_t>(device()) << 32) | device();
+            token.Low = (static_cast<uint64_t>(device()) << 32) | device();
+        }
+        return token;
+    }
+
+    bool IsResumableEnd(const SteamNetConnectionInfo_t& info)
+    {
+        return info.m_eEndReason < k_ESteamNetConnectionEnd_App_Min || info.m_eEndReason > k_ESteamNetConnectionEnd_AppException_Max;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // SessionMessage
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    OutgoingMessage SessionMessage::EncodeHello(const SessionToken& resume)
+    {
+        OutgoingMessage message(k_HelloSize);
+        if (!message)
+            return message;
+
+        std::byte* out = static_cast<std::byte*>(message.GetData());
+        out = WriteBytes(out, &k_HelloID, sizeof(k_HelloID));
+        WriteToken(out, resume);
+        return message;
+    }
+
+    OutgoingMessage SessionMessage::EncodeGrant(const SessionToken& token, bool resumed, std::span<const uint64_t> laneCounts)
+    {
+        OutgoingMessage message(k_GrantHeaderSize + static_cast<uint32_t>(laneCounts.size_bytes()));
+        if (!message)
+            return message;
+
+        const uint8_t resumedFlag = resumed ? 1 : 0;
+        std::byte* out = static_cast<std::byte*>(message.GetData());
+        out = WriteBytes(out, &k_GrantID, sizeof(k_GrantID));
+        out = WriteToken(out, token);
+        out = WriteBytes(out, &resumedFlag, sizeof(resumedFlag));
+        WriteLaneCounts(out, laneCounts);
+        return message;
+    }
+
+    OutgoingMessage SessionMessage::EncodeAck(std::span<const uint64_t> laneCounts)
+    {
+        OutgoingMessage message(k_AckHeaderSize + static_cast<uint32_t>(laneCounts.size_bytes()));
+        if (!message)
+            return message;
+
+        std::byte* out = static_cast<std::byte*>(message.GetData());
+        out = WriteBytes(out, &k_AckID, sizeof(k_AckID));
+        WriteLaneCounts(out, laneCounts);
+        return message;
+    }
+
+    bool SessionMessage::DecodeHello(Buffer payload, SessionToken& outResume)
+    {
+        if (!CheckHeader(payload, k_HelloID, k_HelloSize) || payload.Size != k_HelloSize)
+            return false;
+
+        ReadToken(static_cast<const std::byte*>(payload.Data) + MessageHeader::k_Size, outResume);
+        return true;
+    }
+
+    bool SessionMessage::DecodeGrant(Buffer payload, SessionToken& outToken, bool& outResumed, std::vector<uint64_t>& outLaneCounts)
+    {
+        if (!CheckHeader(payload, k_GrantID, k_GrantHeaderSize))
+            return false;
+
+        const std::byte* begin = static_cast<const std::byte*>(payload.Data);
+        const std::byte* in = ReadToken(begin + MessageHeader::k_Size, outToken);
+        outResumed = static_cast<uint8_t>(*in++) != 0;
+        return ReadLaneCounts(in, static_cast<size_t>(payload.Size) - static_cast<size_t>(in - begin), outLaneCounts);
+    }
+
+    bool SessionMessage::DecodeAck(Buffer payload, std::vector<uint64_t>& outLaneCounts)
+    {
+        if (!CheckHeader(payload, k_AckID, k_AckHeaderSize))
+            return false;
+
+        return ReadLaneCounts(static_cast<const std::byte*>(payload.Data) + MessageHeader::k_Size, static_cast<size_t>(payload.Size) - MessageHeader::k_Size, outLaneCounts);
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // ReplayBuffer
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    void ReplayBuffer::Clear()
+    {
+        m_Lanes.clear();
+        m_PendingCount = 0;
+        m_PendingBytes = 0;
+    }
+
+    void ReplayBuffer::Restart()
+    {
+        for (LaneState& state : m_Lanes)
+        {
+            state.Sent = state.Pending.size();
+            state.Acknowledged = 0;
+        }
+    }
+
+    void ReplayBuffer::Push(uint16_t lane, int flags, std::vector<std::byte> payload)
+    {
+        if (lane >= m_Lanes.size())
+            m_Lanes.resize(static_cast<size_t>(lane) + 1);
+
+        LaneState& state = m_Lanes[lane];
+        state.Sent++;
+        m_PendingCount++;
+        m_PendingBytes += payload.size();
+        state.Pending.push_back({ flags, std::move(payload) });
+    }
+
+    bool ReplayBuffer::Acknowledge(std::span<const uint64_t> laneCounts)
+    {
+        bool consistent = true;
+        for (size_t lane = 0; lane < laneCounts.size(); lane++)
+        {
+            if (lane >= m_Lanes.size())
+            {
+                consistent &= laneCounts[lane] == 0;
+                continue;
+            }
+
+            LaneState& state = m_Lanes[lane];
+            const uint64_t count = laneCounts[lane];
+            consistent &= count <= state.Sent;
+
+            // Acks may be overtaken by a later grant, so never go backwards
+            while (state.Acknowledged < count && !state.Pending.empty())
+            {
+                m_PendingCount--;
+                m_PendingBytes -= state.Pending.front().Payload.size();
+                state.Pending.pop_front();
+                state.Acknowledged++;
+            }
+        }
+        return consistent;
+    }
+
+} // namespace Utopia
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include "MessagePool.hpp"
+#include "MessageProtocol.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vector>
+
+namespace Utopia {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Session resumption
+    // A client that loses its connection reconnects on its own and presents the session token the
+    // server issued, and the server hands the new connection the dropped client's session instead of
+    // announcing a new client. Reliable messages the client sent that never arrived are sent again.
+    //
+    // The server counts the reliable messages it receives from each client per lane. A lane delivers
+    // reliable messages in order, so a count of n acknowledges exactly the first n the client sent on
+    // it; the client keeps the rest and replays them once the session is resumed.
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    // Server side. Clients must enable reconnection to match, since the handshake is not optional.
+    struct SessionConfig
+    {
+        bool Enabled = false;
+
+        // How long a dropped client's session waits for it to come back before the disconnected callback fires
+        std::chrono::milliseconds ResumeTimeout{ 30000 };
+        // How often clients are told which of their reliable messages arrived, so they can stop holding them
+        std::chrono::milliseconds AckInterval{ 100 };
+    };
+
+    // Client side. The backoff before retry n is min(MaxDelay, InitialDelay * Multiplier^n), less a random
+    // fraction of up to Jitter of itself, so clients dropped together do not come back in lockstep.
+    struct ReconnectConfig
+    {
+        // Also turns on the session handshake, so the server must enable SessionConfig as well
+        bool Enabled = false;
+
+        std::chrono::milliseconds InitialDelay{ 25 };
+        std::chrono::milliseconds MaxDelay{ 2000 };
+        double Multiplier = 2.0;
+        double Jitter = 0.5;
+
+        // Gives up, firing the disconnected callback, once the connection has been down this long
+        std::chrono::milliseconds GiveUpAfter{ 30000 };
+        // Silence after which an established connection counts as dropped; the library's default is 10 seconds
+        std::chrono::milliseconds DropTimeout{ 2000 };
+        // How long a new connection waits for the server's answer to the session hello. A server without
+        // SessionConfig never answers, so the connect fails rather than waiting forever.
+        std::chrono::milliseconds GrantTimeout{ 5000 };
+        // Unacknowledged reliable bytes kept for replay. Past this the session cannot be resumed faithfully,
+        // so the next reconnect joins as a new client instead.
+        size_t MaxReplayBytes = 4 * 1024 * 1024;
+
+        std::chrono::milliseconds GetRetryDelay(uint32_t attempt, double random) const;
+    };
+
+    struct SessionToken
+    {
+        uint64_t High = 0;
+        uint64_t Low = 0;
+
+        bool IsValid() const { return High != 0 || Low != 0; }
+        bool operator==(const SessionToken& other) const = default;
+
+        static SessionToken Generate();
+    };
+
+    struct SessionTokenHash
+    {
+        size_t operator()(const SessionToken& token) const { return static_cast<size_t>(token.High ^ (token.Low * 0x9E3779B97F4A7C15ull)); }
+    };
+
+    // Application close reasons mean the peer hung up on purpose, e.g. a kick or a Disconnect();
+    // anything else is the network's doing and worth coming back from
+    bool IsResumableEnd(const SteamNetConnectionInfo_t& info);
+
+    namespace SessionMessage {
+
+        // Client -> server, first on every connection. An invalid token starts a new session.
+        static constexpr MessageTypeID k_HelloID = MessageHeader::k_FirstReservedID + 4;
+        // Server -> client. Answers the hello with the session's token, whether it was resumed, and the
+        // per-lane counts of reliable messages received so far.
+        static constexpr MessageTypeID k_GrantID = MessageHeader::k_FirstReservedID + 5;
+        // Server -> client, the per-lane counts again whenever they have moved
+        static constexpr MessageTypeID k_AckID = MessageHeader::k_FirstReservedID + 6;
+
+        OutgoingMessage EncodeHello(const SessionToken& resume);
+        OutgoingMessage EncodeGrant(const SessionToken& token, bool resumed, std::span<const uint64_t> laneCounts);
+        OutgoingMessage EncodeAck(std::span<const uint64_t> laneCounts);
+
+        // Each returns false on a malformed payload
+        bool DecodeHello(Buffer payload, SessionToken& outResume);
+        bool DecodeGrant(Buffer payload, SessionToken& outToken, bool& outResumed, std::vector<uint64_t>& outLaneCounts);
+        bool DecodeAck(Buffer payload, std::vector<uint64_t>& outLaneCounts);
+
+    } // namespace SessionMessage
+
+    // Reliable messages sent in the current session that the server has not acknowledged, plus those held
+    // while there was no session to send them in, per lane in send order. Payloads are kept as they go on
+    // the wire, i.e. already framed for compression.
+    class ReplayBuffer
+    {
+    public:
+        void Clear();
+
+        void Push(uint16_t lane, int flags, std::vector<std::byte> payload);
+
+        // For a new session: what is still held counts as never sent, so it all goes out in the new session
+        void Restart();
+
+        // Drops what the server has received. Returns false if the counts claim more than was ever sent,
+        // meaning the two ends do not agree on the session.
+        bool Acknowledge(std::span<const uint64_t> laneCounts);
+
+        // Calls function(lane, flags, payload) for every message still held, lane by lane in send order
+        template<typename Function>
+        void ForEach(Function&& function) const
+        {
+            for (size_t lane = 0; lane < m_Lanes.size(); lane++)
+            {
+                for (const Entry& entry : m_Lanes[lane].Pending)
+                    function(static_cast<uint16_t>(lane), entry.Flags, Buffer(entry.Payload.data(), entry.Payload.size()));
+            }
+        }
+
+        size_t GetPendingCount() const { return m_PendingCount; }
+        size_t GetPendingBytes() const { return m_PendingBytes; }
+
+    private:
+        struct Entry
+        {
+            int Flags = 0;
+            std::vector<std::byte> Payload;
+        };
+
+        struct LaneState
+        {
+            // Every reliable message sent on the lane this session, and how many of those the server has
+            uint64_t Sent = 0;
+            uint64_t Acknowledged = 0;
+            std::deque<Entry> Pending;
+        };
+
+        std::vector<LaneState> m_Lanes;
+        size_t m_PendingCount = 0;
+        size_t m_PendingBytes = 0;
+    };
+
+} // namespace Utopia
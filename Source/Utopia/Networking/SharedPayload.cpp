@@ -0,0 +1,68 @@
+#include "SharedPayload.hpp"
+
+#include "MessagePool.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+
+#include <cassert>
+#include <cstring>
+#include <new>
+
+namespace Utopia {
+
+    SharedPayload* SharedPayload::Create(const void* data, uint32_t size)
+    {
+        SharedPayload* payload = Create(size);
+        if (size > 0)
+            std::memcpy(payload->GetMutableData(), data, size);
+        return payload;
+    }
+
+    SharedPayload* SharedPayload::Create(uint32_t size)
+    {
+        const uint32_t totalSize = static_cast<uint32_t>(sizeof(SharedPayload)) + size;
+
+        void* memory = MessagePool::Get().AcquireSlab(totalSize);
+        const bool pooled = memory != nullptr;
+        if (!pooled)
+            memory = ::operator new(totalSize);
+
+        return new (memory) SharedPayload(size, pooled);
+    }
+
+    SteamNetworkingMessage_t* SharedPayload::CreateMessage(HSteamNetConnection connection, int sendFlags, uint16_t lane)
+    {
+        SteamNetworkingMessage_t* message = SteamNetworkingUtils()->AllocateMessage(0);
+        assert(message && "AllocateMessage returned nullptr!");
+
+        AddRef();
+        message->m_conn = connection;
+        message->m_nFlags = sendFlags;
+        message->m_idxLane = lane;
+        message->m_pData = const_cast<void*>(GetData());
+        message->m_cbSize = static_cast<int>(m_Size);
+        message->m_pfnFreeData = &SharedPayload::FreeMessageData;
+        message->m_nUserData = reinterpret_cast<int64>(this);
+        return message;
+    }
+
+    void SharedPayload::Release() noexcept
+    {
+        if (m_RefCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            const bool pooled = m_Pooled;
+            this->~SharedPayload();
+
+            if (pooled)
+                MessagePool::ReleaseSlab(this);
+            else
+                ::operator delete(static_cast<void*>(this));
+        }
+    }
+
+    void SharedPayload::FreeMessageData(SteamNetworkingMessage_t* message)
+    {
+        reinterpret_cast<SharedPayload*>(message->m_nUserData)->Release();
+    }
+
+} // namespace Utopia
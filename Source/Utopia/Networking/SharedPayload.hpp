@@ -0,0 +1,44 @@
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <atomic>
+#include <cstdint>
+
+namespace Utopia {
+
+    // Immutable, reference-counted payload that any number of outgoing library messages can point at.
+    // The bytes are copied once on Create(), into a MessagePool slab when one fits; every message made
+    // from it shares that copy and drops its reference from the library's free callback, which may run
+    // on any thread.
+    class SharedPayload
+    {
+    public:
+        // Returns a payload holding one reference owned by the caller
+        [[nodiscard]] static SharedPayload* Create(const void* data, uint32_t size);
+        // Leaves the bytes uninitialized for the caller to fill through GetMutableData() before sharing it
+        [[nodiscard]] static SharedPayload* Create(uint32_t size);
+
+        // Allocates a library message that points at this payload and holds its own reference
+        [[nodiscard]] SteamNetworkingMessage_t* CreateMessage(HSteamNetConnection connection, int sendFlags, uint16_t lane = 0);
+
+        void AddRef() noexcept { m_RefCount.fetch_add(1, std::memory_order_relaxed); }
+        void Release() noexcept;
+
+        const void* GetData() const { return this + 1; }
+        void* GetMutableData() { return this + 1; }
+        uint32_t GetSize() const { return m_Size; }
+
+    private:
+        SharedPayload(uint32_t size, bool pooled) : m_Size(size), m_Pooled(pooled) {}
+
+        static void FreeMessageData(SteamNetworkingMessage_t* message);
+
+    private:
+        std::atomic<uint32_t> m_RefCount{ 1 };
+        uint32_t m_Size;
+        bool m_Pooled;
+        // Payload bytes follow the header in the same allocation
+    };
+
+} // namespace Utopia
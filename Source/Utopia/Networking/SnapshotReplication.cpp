@@ -0,0 +1,383 @@
+#include "SnapshotReplication.hpp"
+
+#include "Client.hpp"
+#include "Server.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Utopia {
+
+    namespace {
+
+        // Unchanged runs shorter than this are folded into the surrounding replaced run,
+        // since two varints cost more than the bytes they would skip
+        constexpr size_t k_MinKeptRun = 4;
+
+        void WriteVarint(std::vector<std::byte>& out, uint32_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.push_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<std::byte>(value));
+        }
+
+        bool ReadVarint(std::span<const std::byte> in, size_t& offset, uint32_t& outValue)
+        {
+            outValue = 0;
+            for (uint32_t shift = 0; shift < 35; shift += 7)
+            {
+                if (offset >= in.size())
+                    return false;
+
+                const uint32_t byte = static_cast<uint32_t>(in[offset++]);
+                outValue |= (byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+            return false;
+        }
+
+        void WriteUint16(std::byte* out, uint16_t value)
+        {
+            std::memcpy(out, &value, sizeof(value));
+        }
+
+        void WriteUint32(std::byte* out, uint32_t value)
+        {
+            std::memcpy(out, &value, sizeof(value));
+        }
+
+        uint32_t ReadUint32(const std::byte* in)
+        {
+            uint32_t value;
+            std::memcpy(&value, in, sizeof(value));
+            return value;
+        }
+
+        std::span<const std::byte> AsBytes(Buffer buffer)
+        {
+            return { static_cast<const std::byte*>(buffer.Data), static_cast<size_t>(buffer.Size) };
+        }
+
+    } // anonymous namespace
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Delta encoding
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    void EncodeSnapshotDelta(std::span<const std::byte> baseline, std::span<const std::byte> target, std::vector<std::byte>& outDelta)
+    {
+        outDelta.clear();
+
+        const size_t targetSize = target.size();
+        const size_t comparableSize = std::min(baseline.size(), targetSize);
+
+        size_t offset = 0;
+        while (offset < targetSize)
+        {
+            const size_t keptStart = offset;
+            while (offset < comparableSize && target[offset] == baseline[offset])
+                offset++;
+
+            // Whatever is left matches the baseline, which the decoder starts from
+            if (offset == targetSize)
+                break;
+
+            const size_t replacedStart = offset;
+            while (offset < targetSize)
+            {
+                if (offset >= comparableSize || target[offset] != baseline[offset])
+                {
+                    offset++;
+                    continue;
+                }
+
+                size_t keptRun = 0;
+                while (offset + keptRun < comparableSize && keptRun < k_MinKeptRun && target[offset + keptRun] == baseline[offset + keptRun])
+                    keptRun++;
+
+                if (keptRun >= k_MinKeptRun || offset + keptRun == targetSize)
+                    break;
+                offset += keptRun;
+            }
+
+            WriteVarint(outDelta, static_cast<uint32_t>(replacedStart - keptStart));
+            WriteVarint(outDelta, static_cast<uint32_t>(offset - replacedStart));
+            outDelta.insert(outDelta.end(), target.begin() + replacedStart, target.begin() + offset);
+        }
+    }
+
+    bool ApplySnapshotDelta(std::span<const std::byte> baseline, std::span<const std::byte> delta, uint32_t targetSize, std::vector<std::byte>& outTarget)
+    {
+        // Bytes past the baseline all come from the delta, so this much is the most a valid delta describes
+        if (targetSize > baseline.size() + delta.size())
+            return false;
+
+        const size_t comparableSize = std::min<size_t>(baseline.size(), targetSize);
+        outTarget.resize(targetSize);
+        if (comparableSize > 0)
+            std::memcpy(outTarget.data(), baseline.data(), comparableSize);
+        if (targetSize > comparableSize)
+            std::memset(outTarget.data() + comparableSize, 0, targetSize - comparableSize);
+
+        size_t inOffset = 0;
+        size_t outOffset = 0;
+        while (inOffset < delta.size())
+        {
+            uint32_t kept;
+            uint32_t replaced;
+            if (!ReadVarint(delta, inOffset, kept) || !ReadVarint(delta, inOffset, replaced))
+                return false;
+
+            // Kept bytes must exist in the baseline
+            if (outOffset > comparableSize || kept > comparableSize - outOffset)
+                return false;
+            outOffset += kept;
+
+            if (replaced > targetSize - outOffset || replaced > delta.size() - inOffset)
+                return false;
+            std::memcpy(outTarget.data() + outOffset, delta.data() + inOffset, replaced);
+            outOffset += replaced;
+            inOffset += replaced;
+        }
+
+        // Bytes past the baseline can only come from the delta
+        return targetSize <= comparableSize || outOffset == targetSize;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // SnapshotReplicator
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    SnapshotReplicator::SnapshotReplicator(Server& server, const SnapshotReplicationConfig& config)
+        : m_Server(server), m_Config(config)
+    {
+        m_Config.HistorySize = std::max<uint32_t>(m_Config.HistorySize, 2);
+        m_History.resize(m_Config.HistorySize);
+    }
+
+    const SnapshotReplicator::Snapshot* SnapshotReplicator::FindSnapshot(uint32_t sequence) const
+    {
+        const Snapshot& snapshot = m_History[sequence % m_History.size()];
+        return snapshot.Sequence == sequence ? &snapshot : nullptr;
+    }
+
+    uint32_t SnapshotReplicator::PublishSnapshot(Buffer state)
+    {
+        // 0 means "no baseline" on the wire
+        uint32_t sequence = m_LatestSequence.load(std::memory_order_relaxed) + 1;
+        if (sequence == 0)
+            sequence = 1;
+
+        Snapshot& snapshot = m_History[sequence % m_History.size()];
+        const std::span<const std::byte> stateBytes = AsBytes(state);
+        snapshot.Sequence = sequence;
+        snapshot.Data.assign(stateBytes.begin(), stateBytes.end());
+        m_LatestSequence.store(sequence, std::memory_order_release);
+
+        const ClientRegistry::Snapshot clients = m_Server.GetConnectedClients();
+
+        // Every publish has a new set of baselines
+        m_ClientsByBaseline.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stats.SnapshotsPublished++;
+
+            for (const ClientInfo& client : *clients)
+            {
+                const auto it = m_AckedSequences.find(client.ID);
+                uint32_t baseline = it != m_AckedSequences.end() ? it->second : 0;
+                if (baseline != 0 && !FindSnapshot(baseline))
+                    baseline = 0;
+                m_ClientsByBaseline[baseline].push_back(client.ID);
+            }
+
+            // Catch clients that left without RemoveClient()
+            if (m_AckedSequences.size() > clients->size())
+            {
+                std::erase_if(m_AckedSequences, [&clients](const auto& entry)
+                    {
+                        return std::none_of(clients->begin(), clients->end(), [&entry](const ClientInfo& client) { return client.ID == entry.first; });
+                    });
+            }
+        }
+
+        for (const auto& [baselineSequence, clientIDs] : m_ClientsByBaseline)
+        {
+            if (clientIDs.empty())
+                continue;
+
+            uint32_t baseline = baselineSequence;
+            std::span<const std::byte> body = stateBytes;
+            if (baseline != 0)
+            {
+                EncodeSnapshotDelta(FindSnapshot(baseline)->Data, stateBytes, m_DeltaScratch);
+                if (m_DeltaScratch.size() < stateBytes.size())
+                    body = m_DeltaScratch;
+                else
+                    baseline = 0;
+            }
+
+            m_MessageScratch.resize(SnapshotMessage::k_SnapshotHeaderSize + body.size());
+            std::byte* header = m_MessageScratch.data();
+            WriteUint16(header, SnapshotMessage::k_SnapshotID);
+            WriteUint32(header + MessageHeader::k_Size, sequence);
+            WriteUint32(header + MessageHeader::k_Size + 4, baseline);
+            WriteUint32(header + MessageHeader::k_Size + 8, static_cast<uint32_t>(stateBytes.size()));
+            if (!body.empty())
+                std::memcpy(header + SnapshotMessage::k_SnapshotHeaderSize, body.data(), body.size());
+
+            m_Server.SendBufferToClients(clientIDs, Buffer(m_MessageScratch.data(), m_MessageScratch.size()), m_Config.Flags, nullptr, m_Config.Lane);
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (baseline == 0)
+            {
+                m_Stats.FullSends += clientIDs.size();
+                m_Stats.FullBytes += clientIDs.size() * m_MessageScratch.size();
+            }
+            else
+            {
+                m_Stats.DeltaSends += clientIDs.size();
+                m_Stats.DeltaBytes += clientIDs.size() * m_MessageScratch.size();
+            }
+        }
+
+        return sequence;
+    }
+
+    bool SnapshotReplicator::ProcessMessage(const ClientInfo& client, Buffer payload)
+    {
+        MessageTypeID id;
+        if (!PeekMessageTypeID(payload, id) || id != SnapshotMessage::k_AckID)
+            return false;
+
+        if (payload.Size != SnapshotMessage::k_AckSize)
+        {
+            UT_WARN_TAG("SERVER", "Ignoring malformed snapshot ack from ClientID {}", static_cast<uint32_t>(client.ID));
+            return true;
+        }
+
+        const uint32_t sequence = ReadUint32(static_cast<const std::byte*>(payload.Data) + MessageHeader::k_Size);
+        if (sequence == 0 || sequence > m_LatestSequence.load(std::memory_order_acquire))
+            return true;
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stats.AcksReceived++;
+
+        // Acks travel unreliably and may arrive out of order
+        uint32_t& acked = m_AckedSequences[client.ID];
+        acked = std::max(acked, sequence);
+        return true;
+    }
+
+    void SnapshotReplicator::RemoveClient(ClientID clientID)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_AckedSequences.erase(clientID);
+    }
+
+    SnapshotReplicationStats SnapshotReplicator::GetStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_Stats;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // SnapshotReceiver
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    SnapshotReceiver::SnapshotReceiver(Client& client, const SnapshotReplicationConfig& config)
+        : m_Client(client), m_Config(config)
+    {
+        m_Config.HistorySize = std::max<uint32_t>(m_Config.HistorySize, 2);
+        m_History.resize(m_Config.HistorySize);
+    }
+
+    const SnapshotReceiver::Snapshot* SnapshotReceiver::FindSnapshot(uint32_t sequence) const
+    {
+        const Snapshot& snapshot = m_History[sequence % m_History.size()];
+        return snapshot.Sequence == sequence ? &snapshot : nullptr;
+    }
+
+    bool SnapshotReceiver::ProcessMessage(Buffer payload)
+    {
+        MessageTypeID id;
+        if (!PeekMessageTypeID(payload, id) || id != SnapshotMessage::k_SnapshotID)
+            return false;
+
+        if (payload.Size < SnapshotMessage::k_SnapshotHeaderSize)
+        {
+            UT_WARN_TAG("CLIENT", "Ignoring malformed snapshot");
+            return true;
+        }
+
+        const std::byte* header = static_cast<const std::byte*>(payload.Data);
+        const uint32_t sequence = ReadUint32(header + MessageHeader::k_Size);
+        const uint32_t baseline = ReadUint32(header + MessageHeader::k_Size + 4);
+        const uint32_t size = ReadUint32(header + MessageHeader::k_Size + 8);
+        const std::span<const std::byte> body(header + SnapshotMessage::k_SnapshotHeaderSize, static_cast<size_t>(payload.Size) - SnapshotMessage::k_SnapshotHeaderSize);
+
+        // Unreliable delivery: anything older than what we already have is stale
+        if (sequence == 0 || sequence <= m_LatestSequence)
+            return true;
+
+        if (size > m_Config.MaxSnapshotSize)
+        {
+            UT_WARN_TAG("CLIENT", "Ignoring snapshot {} of {} bytes, over the maximum of {}", sequence, size, m_Config.MaxSnapshotSize);
+            return true;
+        }
+
+        if (baseline == 0)
+        {
+            if (body.size() != size)
+            {
+                UT_WARN_TAG("CLIENT", "Ignoring malformed snapshot {}", sequence);
+                return true;
+            }
+            m_Scratch.assign(body.begin(), body.end());
+        }
+        else
+        {
+            // The server only deltas against snapshots we acknowledged, so a miss means our history moved on
+            const Snapshot* baselineSnapshot = FindSnapshot(baseline);
+            if (!baselineSnapshot)
+                return true;
+
+            if (!ApplySnapshotDelta(baselineSnapshot->Data, body, size, m_Scratch))
+            {
+                UT_WARN_TAG("CLIENT", "Ignoring malformed delta for snapshot {} against {}", sequence, baseline);
+                return true;
+            }
+        }
+
+        // Built in scratch first, since the slot may hold the baseline
+        Snapshot& snapshot = m_History[sequence % m_History.size()];
+        snapshot.Sequence = sequence;
+        snapshot.Data.swap(m_Scratch);
+        m_LatestSequence = sequence;
+
+        std::byte ack[SnapshotMessage::k_AckSize];
+        WriteUint16(ack, SnapshotMessage::k_AckID);
+        WriteUint32(ack + MessageHeader::k_Size, sequence);
+        m_Client.SendBuffer(Buffer(ack, sizeof(ack)), m_Config.Flags, m_Config.Lane);
+
+        if (m_SnapshotCallback)
+            m_SnapshotCallback(sequence, Buffer(snapshot.Data.data(), snapshot.Data.size()));
+
+        return true;
+    }
+
+    void SnapshotReceiver::Reset()
+    {
+        for (Snapshot& snapshot : m_History)
+        {
+            snapshot.Sequence = 0;
+            snapshot.Data.clear();
+        }
+        m_LatestSequence = 0;
+    }
+
+} // namespace Utopia
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include "ClientRegistry.hpp"
+#include "MessageProtocol.hpp"
+#include "SendFlags.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    class Client;
+    class Server;
+
+    struct SnapshotReplicationConfig
+    {
+        // Snapshots kept on both ends. A client whose last ack is older gets a full snapshot instead of a delta.
+        uint32_t HistorySize = 32;
+
+        SendFlags Flags = SendFlags::UnreliableNoNagle;
+        uint16_t Lane = 0;
+
+        // Receiver only. Larger snapshots are dropped before anything is allocated for them; a full snapshot
+        // travels as one message, so none can legitimately exceed the library's message size.
+        uint32_t MaxSnapshotSize = k_cbMaxSteamNetworkingSocketsMessageSizeSend;
+    };
+
+    struct SnapshotReplicationStats
+    {
+        uint64_t SnapshotsPublished = 0;
+        uint64_t FullSends = 0;
+        uint64_t DeltaSends = 0;
+        uint64_t FullBytes = 0;
+        uint64_t DeltaBytes = 0;
+        uint64_t AcksReceived = 0;
+    };
+
+    // Byte-level delta between two serialized snapshots: alternating runs of bytes kept from the
+    // baseline and bytes replaced, each run length a varint. Bytes past the end of the baseline are
+    // always replaced, so the target may grow or shrink.
+    void EncodeSnapshotDelta(std::span<const std::byte> baseline, std::span<const std::byte> target, std::vector<std::byte>& outDelta);
+    // outTarget is resized to targetSize. Returns false on a malformed delta, including one whose targetSize
+    // is more than the baseline and the delta could fill; bound targetSize further before calling.
+    bool ApplySnapshotDelta(std::span<const std::byte> baseline, std::span<const std::byte> delta, uint32_t targetSize, std::vector<std::byte>& outTarget);
+
+    namespace SnapshotMessage {
+
+        static constexpr MessageTypeID k_SnapshotID = MessageHeader::k_FirstReservedID;
+        static constexpr MessageTypeID k_AckID = MessageHeader::k_FirstReservedID + 1;
+
+        // Type, sequence, baseline sequence (0 for a full snapshot) and the snapshot's full size
+        static constexpr uint32_t k_SnapshotHeaderSize = MessageHeader::k_Size + 12;
+        static constexpr uint32_t k_AckSize = MessageHeader::k_Size + 4;
+
+    } // namespace SnapshotMessage
+
+    // Server half of snapshot replication. Publish the serialized world once per tick; every client
+    // gets an unreliable delta against the newest snapshot it has acknowledged, or the full snapshot
+    // when it has not acknowledged one that is still in the history. Clients that share a baseline
+    // share one encoded message.
+    //
+    // The server has one receive callback, so forward to this from yours:
+    //   server.SetDataReceivedCallback([&](const ClientInfo& client, const Buffer buffer)
+    //       {
+    //           if (replicator.ProcessMessage(client, buffer))
+    //               return;
+    //           ...
+    //       });
+    //   server.SetClientDisconnectedCallback([&](const ClientInfo& client) { replicator.RemoveClient(client.ID); });
+    class SnapshotReplicator
+    {
+    public:
+        explicit SnapshotReplicator(Server& server, const SnapshotReplicationConfig& config = {});
+
+        SnapshotReplicator(const SnapshotReplicator&) = delete;
+        SnapshotReplicator& operator=(const SnapshotReplicator&) = delete;
+
+        // Stores the snapshot and sends it to every connected client. Call from one thread at a time.
+        // Returns the snapshot's sequence number.
+        uint32_t PublishSnapshot(Buffer state);
+
+        // Consumes acks; returns false for anything that is not a replication message. Safe from any worker.
+        bool ProcessMessage(const ClientInfo& client, Buffer payload);
+        void RemoveClient(ClientID clientID);
+
+        SnapshotReplicationStats GetStats() const;
+
+    private:
+        struct Snapshot
+        {
+            uint32_t Sequence = 0;
+            std::vector<std::byte> Data;
+        };
+
+        // Returns nullptr if the sequence is no longer in the history
+        const Snapshot* FindSnapshot(uint32_t sequence) const;
+
+    private:
+        Server& m_Server;
+        SnapshotReplicationConfig m_Config;
+
+        // Publisher thread only
+        std::vector<Snapshot> m_History;
+        std::unordered_map<uint32_t, std::vector<ClientID>> m_ClientsByBaseline;
+        std::vector<std::byte> m_DeltaScratch;
+        std::vector<std::byte> m_MessageScratch;
+
+        // Written by the publisher; read by workers to reject acks for snapshots never sent
+        std::atomic<uint32_t> m_LatestSequence{ 0 };
+
+        mutable std::mutex m_Mutex;
+        // Newest acknowledged sequence per client; absent until the first ack
+        std::unordered_map<ClientID, uint32_t> m_AckedSequences;
+        SnapshotReplicationStats m_Stats;
+    };
+
+    // Client half of snapshot replication. Rebuilds each snapshot from its baseline, acknowledges it,
+    // and hands the full state to the callback. Older or duplicate snapshots are dropped.
+    //   client.SetDataReceivedCallback([&](const Buffer buffer)
+    //       {
+    //           if (receiver.ProcessMessage(buffer))
+    //               return;
+    //           ...
+    //       });
+    class SnapshotReceiver
+    {
+    public:
+        // The state is only valid during the callback
+        using SnapshotCallback = std::function<void(uint32_t sequence, Buffer state)>;
+
+    public:
+        explicit SnapshotReceiver(Client& client, const SnapshotReplicationConfig& config = {});
+
+        SnapshotReceiver(const SnapshotReceiver&) = delete;
+        SnapshotReceiver& operator=(const SnapshotReceiver&) = delete;
+
+        void SetSnapshotCallback(const SnapshotCallback& function) { m_SnapshotCallback = function; }
+
+        // Call from the client's receive callback; returns false for anything that is not a snapshot
+        bool ProcessMessage(Buffer payload);
+
+        // Forget every snapshot, e.g. after reconnecting; the next one will be a full snapshot
+        void Reset();
+
+        uint32_t GetLatestSequence() const { return m_LatestSequence; }
+
+    private:
+        struct Snapshot
+        {
+            uint32_t Sequence = 0;
+            std::vector<std::byte> Data;
+        };
+
+        const Snapshot* FindSnapshot(uint32_t sequence) const;
+
+    private:
+        Client& m_Client;
+        SnapshotReplicationConfig m_Config;
+        SnapshotCallback m_SnapshotCallback;
+
+        std::vector<Snapshot> m_History;
+        uint32_t m_LatestSequence = 0;
+        std::vector<std::byte> m_Scratch;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "Executor.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+namespace Utopia {
+
+    template<typename T = void>
+    class Task;
+
+    namespace Detail {
+
+        struct TaskPromiseBase
+        {
+            // Resumes whoever awaited the task, straight from the final suspend point
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+
+                template<typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+                {
+                    const std::coroutine_handle<> continuation = handle.promise().Continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept {}
+            };
+
+            std::suspend_always initial_suspend() const noexcept { return {}; }
+            FinalAwaiter final_suspend() const noexcept { return {}; }
+            void unhandled_exception() noexcept { Exception = std::current_exception(); }
+
+            void RethrowIfFailed() const
+            {
+                if (Exception)
+                    std::rethrow_exception(Exception);
+            }
+
+            std::coroutine_handle<> Continuation;
+            std::exception_ptr Exception;
+        };
+
+        template<typename T>
+        struct TaskPromise : TaskPromiseBase
+        {
+            Task<T> get_return_object() noexcept;
+
+            template<typename U>
+            void return_value(U&& value) { Value.emplace(std::forward<U>(value)); }
+
+            T TakeResult()
+            {
+                RethrowIfFailed();
+                return std::move(*Value);
+            }
+
+            std::optional<T> Value;
+        };
+
+        template<>
+        struct TaskPromise<void> : TaskPromiseBase
+        {
+            Task<void> get_return_object() noexcept;
+
+            void return_void() const noexcept {}
+
+            void TakeResult() const { RethrowIfFailed(); }
+        };
+
+        // Owns itself: starts right away and frees its frame when it finishes
+        struct DetachedTask
+        {
+            struct promise_type
+            {
+                DetachedTask get_return_object() const noexcept { return {}; }
+                std::suspend_never initial_suspend() const noexcept { return {}; }
+                std::suspend_never final_suspend() const noexcept { return {}; }
+                void return_void() const noexcept {}
+                // Nobody is left to hand the exception to
+                void unhandled_exception() const noexcept { std::terminate(); }
+            };
+        };
+
+    } // namespace Detail
+
+    // Lazily started coroutine that produces a T. Nothing runs until the task is awaited (or spawned),
+    // and the awaiting coroutine continues on whichever thread the task finishes on:
+    //   Task<int> CountPlayers(AsyncClient& client);
+    //   Task<> RunBot(AsyncClient& client)
+    //   {
+    //       if (!co_await client.ConnectAsync("127.0.0.1:8192"))
+    //           co_return;
+    //       const int players = co_await CountPlayers(client);
+    //   }
+    //   Spawn(executor, RunBot(client));
+    template<typename T>
+    class [[nodiscard]] Task
+    {
+    public:
+        using promise_type = Detail::TaskPromise<T>;
+
+    public:
+        Task() = default;
+        explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+            : m_Handle(handle) {}
+
+        ~Task() noexcept
+        {
+            if (m_Handle)
+                m_Handle.destroy();
+        }
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        Task(Task&& other) noexcept
+            : m_Handle(std::exchange(other.m_Handle, nullptr)) {}
+
+        Task& operator=(Task&& other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_Handle)
+                    m_Handle.destroy();
+                m_Handle = std::exchange(other.m_Handle, nullptr);
+            }
+            return *this;
+        }
+
+        bool IsValid() const { return static_cast<bool>(m_Handle); }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                std::coroutine_handle<promise_type> Handle;
+
+                // An empty task, e.g. one moved from, is ready at once and throws from await_resume
+                bool await_ready() const noexcept { return !Handle || Handle.done(); }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+                {
+                    Handle.promise().Continuation = continuation;
+                    return Handle;
+                }
+
+                T await_resume()
+                {
+                    if (!Handle)
+                        throw std::logic_error("Awaited an empty Task");
+                    return Handle.promise().TakeResult();
+                }
+            };
+            return Awaiter{ m_Handle };
+        }
+
+    private:
+        std::coroutine_handle<promise_type> m_Handle;
+    };
+
+    namespace Detail {
+
+        template<typename T>
+        Task<T> TaskPromise<T>::get_return_object() noexcept
+        {
+            return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> TaskPromise<void>::get_return_object() noexcept
+        {
+            return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+        }
+
+        inline DetachedTask RunDetached(Task<void> task)
+        {
+            co_await std::move(task);
+        }
+
+    } // namespace Detail
+
+    // Starts task on executor without anyone awaiting it; the task frees itself when it finishes.
+    // An exception escaping a spawned task terminates the program.
+    inline void Spawn(Executor& executor, Task<void> task)
+    {
+        // Work must be copyable, so the move-only task travels in a shared_ptr
+        executor.Post([task = std::make_shared<Task<void>>(std::move(task))]()
+            {
+                Detail::RunDetached(std::move(*task));
+            });
+    }
+
+} // namespace Utopia
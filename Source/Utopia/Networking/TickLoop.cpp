@@ -0,0 +1,85 @@
+#include "TickLoop.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <thread>
+
+namespace Utopia {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // TickInbox
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    void TickInbox::Append(std::vector<TickEvent>& events)
+    {
+        if (events.empty())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            if (m_Back.empty())
+            {
+                // Trade buffers instead of moving element by element
+                std::swap(m_Back, events);
+            }
+            else
+            {
+                m_Back.insert(m_Back.end(), std::make_move_iterator(events.begin()), std::make_move_iterator(events.end()));
+            }
+        }
+        events.clear();
+    }
+
+    void TickInbox::Append(TickEvent event)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Back.push_back(std::move(event));
+    }
+
+    std::span<TickEvent> TickInbox::Swap()
+    {
+        // The previous tick's messages go back to the library outside the lock
+        m_Front.clear();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        std::swap(m_Front, m_Back);
+        return m_Front;
+    }
+
+    void TickInbox::Clear()
+    {
+        m_Front.clear();
+
+        std::vector<TickEvent> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            std::swap(pending, m_Back);
+        }
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // FixedRateTicker
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    FixedRateTicker::FixedRateTicker(std::chrono::nanoseconds interval)
+        : m_Interval(std::max(interval, std::chrono::nanoseconds(1))), m_NextTick(std::chrono::steady_clock::now())
+    {
+    }
+
+    uint64_t FixedRateTicker::WaitForNextTick()
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < m_NextTick)
+        {
+            std::this_thread::sleep_until(m_NextTick);
+        }
+        else
+        {
+            const uint64_t behind = static_cast<uint64_t>((now - m_NextTick) / m_Interval);
+            m_MissedTicks += behind;
+            m_NextTick += m_Interval * behind;
+        }
+
+        m_NextTick += m_Interval;
+        return m_Tick++;
+    }
+
+} // namespace Utopia
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ClientRegistry.hpp"
+#include "MessageHandle.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace Utopia {
+
+    enum class TickEventType
+    {
+        Connected = 0,
+        Disconnected,
+        Data,
+        // Client only, with reconnection enabled: the connection dropped and is being re-established
+        Interrupted,
+        // A dropped session was picked up by a new connection, see Server::SetClientResumedCallback
+        Resumed
+    };
+
+    struct TickEvent
+    {
+        TickEventType Type = TickEventType::Data;
+        // The client on a Server; the connection to the server on a Client
+        ClientID Client = k_HSteamNetConnection_Invalid;
+        // Data events only. Owns the received message, so it can be kept past the tick without a copy.
+        MessageHandle Message;
+        // Resumed events on a Server only. The ClientID the session had before it dropped.
+        ClientID PreviousClient = k_HSteamNetConnection_Invalid;
+    };
+
+    // Double-buffered hand-off from the network threads to the game thread. Network threads append a
+    // batch at a time under a short lock; the game thread swaps the buffers once per tick and reads its
+    // side without any lock held.
+    class TickInbox
+    {
+    public:
+        // Network threads. Moves the events out, leaving the vector empty for reuse.
+        void Append(std::vector<TickEvent>& events);
+        void Append(TickEvent event);
+
+        // Game thread. Everything appended since the previous Swap(), in append order. Valid until the
+        // next Swap() or Clear(), which also release the messages still held by the previous tick's events.
+        std::span<TickEvent> Swap();
+        void Clear();
+
+    private:
+        std::mutex m_Mutex;
+        std::vector<TickEvent> m_Back;
+        std::vector<TickEvent> m_Front;
+    };
+
+    // Paces a game loop at a fixed rate. After an overrun the schedule moves on rather than bursting
+    // through the missed ticks to catch up.
+    class FixedRateTicker
+    {
+    public:
+        explicit FixedRateTicker(std::chrono::nanoseconds interval);
+
+        // Sleeps until the next tick is due and returns its number; the first tick is due immediately
+        uint64_t WaitForNextTick();
+
+        std::chrono::nanoseconds GetInterval() const { return m_Interval; }
+        // Ticks skipped because a previous one overran
+        uint64_t GetMissedTicks() const { return m_MissedTicks; }
+
+    private:
+        std::chrono::nanoseconds m_Interval;
+        std::chrono::steady_clock::time_point m_NextTick;
+        uint64_t m_Tick = 0;
+        uint64_t m_MissedTicks = 0;
+    };
+
+} // namespace Utopia
@@ -0,0 +1,247 @@
+#include "TrafficCapture.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace Utopia {
+
+    namespace {
+
+        // Type byte plus varints for the time delta, client ID, lane and size
+        constexpr size_t k_MaxRecordOverhead = 1 + 10 + 5 + 3 + 5;
+
+        size_t WriteVarint(std::byte* out, uint64_t value)
+        {
+            size_t size = 0;
+            while (value >= 0x80)
+            {
+                out[size++] = static_cast<std::byte>((value & 0x7F) | 0x80);
+                value >>= 7;
+            }
+            out[size++] = static_cast<std::byte>(value);
+            return size;
+        }
+
+        bool ReadVarint(const std::byte* in, size_t end, size_t& offset, uint64_t& outValue)
+        {
+            outValue = 0;
+            for (uint32_t shift = 0; shift < 64; shift += 7)
+            {
+                if (offset >= end)
+                    return false;
+
+                const uint64_t byte = static_cast<uint64_t>(in[offset++]);
+                outValue |= (byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return true;
+            }
+            return false;
+        }
+
+    } // anonymous namespace
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // TrafficCapture
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    std::shared_ptr<TrafficCapture> TrafficCapture::Create(const std::string& path, std::string& outError, size_t reserveBytes)
+    {
+        std::shared_ptr<TrafficCapture> capture(new TrafficCapture());
+        if (!capture->m_File.Create(path, sizeof(CaptureFileHeader) + std::max<size_t>(reserveBytes, 4096), outError))
+            return nullptr;
+
+        capture->m_StartTime = std::chrono::steady_clock::now();
+
+        CaptureFileHeader header;
+        header.StartTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+        std::memcpy(capture->m_File.GetData(), &header, sizeof(header));
+        return capture;
+    }
+
+    TrafficCapture::~TrafficCapture()
+    {
+        Close();
+    }
+
+    void TrafficCapture::RecordConnect(const ClientInfo& client)
+    {
+        const size_t descriptionLength = ::strnlen(client.ConnectionDesc, sizeof(client.ConnectionDesc));
+        Append(CaptureRecordType::Connect, client.ID, 0, Buffer(client.ConnectionDesc, descriptionLength));
+    }
+
+    void TrafficCapture::RecordDisconnect(ClientID client)
+    {
+        Append(CaptureRecordType::Disconnect, client, 0, Buffer());
+    }
+
+    void TrafficCapture::RecordData(ClientID client, uint16_t lane, Buffer payload)
+    {
+        Append(CaptureRecordType::Data, client, lane, payload);
+    }
+
+    void TrafficCapture::Close()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (m_File.IsOpen())
+            m_File.Close(m_WriteOffset);
+    }
+
+    bool TrafficCapture::IsOpen() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        return m_File.IsOpen();
+    }
+
+    void TrafficCapture::Append(CaptureRecordType type, ClientID client, uint16_t lane, Buffer payload)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (!m_File.IsOpen() || !Reserve(k_MaxRecordOverhead + payload.Size))
+            return;
+
+        // Taken under the lock, so record times never go backwards
+        const auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_StartTime);
+
+        std::byte* out = m_File.GetData() + m_WriteOffset;
+        size_t size = 0;
+        out[size++] = static_cast<std::byte>(type);
+        size += WriteVarint(out + size, static_cast<uint64_t>((time - m_LastRecordTime).count()));
+        size += WriteVarint(out + size, client);
+        size += WriteVarint(out + size, lane);
+        size += WriteVarint(out + size, payload.Size);
+        if (payload.Size > 0)
+        {
+            std::memcpy(out + size, payload.Data, payload.Size);
+            size += payload.Size;
+        }
+
+        m_LastRecordTime = time;
+        m_WriteOffset += size;
+
+        const uint64_t dataSize = m_WriteOffset - sizeof(CaptureFileHeader);
+        std::memcpy(m_File.GetData() + offsetof(CaptureFileHeader, DataSize), &dataSize, sizeof(dataSize));
+
+        m_DataSize.store(dataSize, std::memory_order_relaxed);
+        m_RecordCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool TrafficCapture::Reserve(size_t bytes)
+    {
+        const size_t required = m_WriteOffset + bytes;
+        if (required <= m_File.GetSize())
+            return true;
+
+        const size_t growth = std::min(m_File.GetSize(), k_MaxGrowth);
+        std::string error;
+        if (m_File.Resize(std::max(m_File.GetSize() + growth, required), error))
+            return true;
+
+        // A capture that cannot grow stops rather than stalling the network threads on retries
+        UT_ERROR_TAG("SERVER", "Traffic capture stopped: {}", error);
+        if (m_File.IsOpen())
+            m_File.Close(m_WriteOffset);
+        return false;
+    }
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // TrafficCaptureReader
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    bool TrafficCaptureReader::Open(const std::string& path, std::string& outError)
+    {
+        Close();
+
+        if (!m_File.OpenRead(path, outError))
+            return false;
+
+        if (m_File.GetSize() < sizeof(CaptureFileHeader))
+        {
+            outError = path + " is too small to be a traffic capture";
+            Close();
+            return false;
+        }
+
+        std::memcpy(&m_Header, m_File.GetData(), sizeof(m_Header));
+        if (m_Header.Magic != CaptureFileHeader::k_Magic || m_Header.HeaderSize < sizeof(CaptureFileHeader) || m_Header.HeaderSize > m_File.GetSize())
+        {
+            outError = path + " is not a traffic capture";
+            Close();
+            return false;
+        }
+        if (m_Header.Version > CaptureFileHeader::k_Version)
+        {
+            outError = path + " was written by a newer capture format";
+            Close();
+            return false;
+        }
+
+        // The header is only as current as the last record, and the file may have been cut short
+        m_End = m_Header.HeaderSize + static_cast<size_t>(std::min<uint64_t>(m_Header.DataSize, m_File.GetSize() - m_Header.HeaderSize));
+        Rewind();
+        return true;
+    }
+
+    void TrafficCaptureReader::Close()
+    {
+        m_File.Close();
+        m_Header = {};
+        m_End = 0;
+        m_ReadOffset = 0;
+        m_Time = std::chrono::microseconds(0);
+        m_Truncated = false;
+    }
+
+    bool TrafficCaptureReader::Next(CaptureRecord& outRecord)
+    {
+        if (m_ReadOffset >= m_End)
+            return false;
+
+        const std::byte* data = m_File.GetData();
+        size_t offset = m_ReadOffset;
+
+        const uint8_t type = static_cast<uint8_t>(data[offset++]);
+        uint64_t timeDelta = 0;
+        uint64_t client = 0;
+        uint64_t lane = 0;
+        uint64_t size = 0;
+        const bool valid = type >= static_cast<uint8_t>(CaptureRecordType::Connect)
+            && type <= static_cast<uint8_t>(CaptureRecordType::Data)
+            && ReadVarint(data, m_End, offset, timeDelta)
+            && ReadVarint(data, m_End, offset, client)
+            && ReadVarint(data, m_End, offset, lane)
+            && ReadVarint(data, m_End, offset, size)
+            && size <= m_End - offset;
+        if (!valid)
+        {
+            m_Truncated = true;
+            m_ReadOffset = m_End;
+            return false;
+        }
+
+        m_Time += std::chrono::microseconds(timeDelta);
+
+        outRecord.Type = static_cast<CaptureRecordType>(type);
+        outRecord.Time = m_Time;
+        outRecord.Client = static_cast<ClientID>(client);
+        outRecord.Lane = static_cast<uint16_t>(lane);
+        outRecord.Payload = Buffer(data + offset, size);
+
+        m_ReadOffset = offset + size;
+        return true;
+    }
+
+    void TrafficCaptureReader::Rewind()
+    {
+        m_ReadOffset = m_File.IsOpen() ? m_Header.HeaderSize : 0;
+        m_Time = std::chrono::microseconds(0);
+        m_Truncated = false;
+    }
+
+    std::chrono::system_clock::time_point TrafficCaptureReader::GetStartTime() const
+    {
+        return std::chrono::system_clock::time_point(std::chrono::microseconds(m_Header.StartTimeUs));
+    }
+
+} // namespace Utopia
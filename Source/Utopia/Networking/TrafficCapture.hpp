@@ -0,0 +1,132 @@
+#pragma once
+
+#include "Utopia/Core/Buffer.hpp"
+
+#include "ClientRegistry.hpp"
+#include "MappedFile.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Utopia {
+
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+    // Capture file format
+    // A CaptureFileHeader followed by records back to back, each
+    //   u8 type | varint microseconds since the previous record | varint client ID | varint lane |
+    //   varint payload size | payload
+    // Connect records carry the connection description as their payload, disconnects carry none.
+    // Payloads are stored as the server's callbacks saw them, i.e. already decompressed.
+    //////////////////////////////////////////////////////////////////////////////////////////////////
+
+    enum class CaptureRecordType : uint8_t
+    {
+        Connect = 1,
+        Disconnect,
+        Data
+    };
+
+    struct CaptureFileHeader
+    {
+        static constexpr uint32_t k_Magic = 0x50414355; // "UCAP"
+        static constexpr uint16_t k_Version = 1;
+
+        uint32_t Magic = k_Magic;
+        uint16_t Version = k_Version;
+        uint16_t HeaderSize = sizeof(CaptureFileHeader);
+        // Bytes of records written so far, updated after every record so a crashed capture stays readable
+        uint64_t DataSize = 0;
+        // Wall clock at the start of the capture, in microseconds since the Unix epoch
+        int64_t StartTimeUs = 0;
+    };
+    static_assert(sizeof(CaptureFileHeader) == 24);
+
+    struct CaptureRecord
+    {
+        CaptureRecordType Type = CaptureRecordType::Data;
+        // Since the capture started
+        std::chrono::microseconds Time{ 0 };
+        ClientID Client = 0;
+        uint16_t Lane = 0;
+        // Points into the mapped capture, valid while the reader is open
+        Buffer Payload;
+    };
+
+    // Append-only writer of a memory-mapped capture file. Records are framed straight into the mapping
+    // under a lock, so recording from several network workers costs a copy and no system calls, except
+    // when the file has to grow. Safe from any thread.
+    class TrafficCapture
+    {
+    public:
+        static constexpr size_t k_DefaultReserve = 16 * 1024 * 1024;
+        // The file at least doubles until growing by this much, then grows by this much at a time
+        static constexpr size_t k_MaxGrowth = 256 * 1024 * 1024;
+
+        // Truncates any existing file at path. Returns nullptr with the reason in outError on failure.
+        static std::shared_ptr<TrafficCapture> Create(const std::string& path, std::string& outError, size_t reserveBytes = k_DefaultReserve);
+
+        ~TrafficCapture();
+
+        TrafficCapture(const TrafficCapture&) = delete;
+        TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+        void RecordConnect(const ClientInfo& client);
+        void RecordDisconnect(ClientID client);
+        void RecordData(ClientID client, uint16_t lane, Buffer payload);
+
+        // Trims the preallocated tail and closes the file; anything recorded afterwards is dropped
+        void Close();
+        bool IsOpen() const;
+
+        uint64_t GetRecordCount() const { return m_RecordCount.load(std::memory_order_relaxed); }
+        // Framed record bytes, excluding the file header
+        uint64_t GetDataSize() const { return m_DataSize.load(std::memory_order_relaxed); }
+
+    private:
+        TrafficCapture() = default;
+
+        void Append(CaptureRecordType type, ClientID client, uint16_t lane, Buffer payload);
+        // Requires m_Mutex
+        bool Reserve(size_t bytes);
+
+    private:
+        mutable std::mutex m_Mutex;
+        MappedFile m_File;
+        std::chrono::steady_clock::time_point m_StartTime;
+        std::chrono::microseconds m_LastRecordTime{ 0 };
+        size_t m_WriteOffset = sizeof(CaptureFileHeader);
+
+        std::atomic<uint64_t> m_RecordCount{ 0 };
+        std::atomic<uint64_t> m_DataSize{ 0 };
+    };
+
+    // Reads a capture front to back. Payloads point straight into the mapping, so nothing is copied.
+    class TrafficCaptureReader
+    {
+    public:
+        bool Open(const std::string& path, std::string& outError);
+        void Close();
+        bool IsOpen() const { return m_File.IsOpen(); }
+
+        // False at the end of the capture, or at a malformed record, see IsTruncated()
+        bool Next(CaptureRecord& outRecord);
+        void Rewind();
+
+        // True if reading stopped at a record cut short, e.g. by a crash while capturing
+        bool IsTruncated() const { return m_Truncated; }
+        std::chrono::system_clock::time_point GetStartTime() const;
+
+    private:
+        MappedFile m_File;
+        CaptureFileHeader m_Header;
+        size_t m_End = 0;
+        size_t m_ReadOffset = 0;
+        std::chrono::microseconds m_Time{ 0 };
+        bool m_Truncated = false;
+    };
+
+} // namespace Utopia
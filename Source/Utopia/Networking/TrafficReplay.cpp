@@ -0,0 +1,199 @@
+#include "TrafficReplay.hpp"
+
+#include "MessageHandle.hpp"
+#include "MessagePool.hpp"
+#include "Server.hpp"
+
+#include "Utopia/Core/Log.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Utopia {
+
+    bool TrafficReplay::Open(const std::string& path, std::string& outError)
+    {
+        return m_Reader.Open(path, outError);
+    }
+
+    TrafficReplayStats TrafficReplay::Run(Server& server, const TrafficReplayConfig& config)
+    {
+        TrafficReplayStats stats;
+        if (!m_Reader.IsOpen())
+        {
+            stats.Error = "No capture is open";
+            return stats;
+        }
+        if (server.IsRunning())
+        {
+            stats.Error = "Cannot replay into a running server";
+            return stats;
+        }
+
+        m_Reader.Rewind();
+        m_Stopping.store(false);
+        server.m_Replaying.store(true);
+
+        // Node-based, so the ClientInfo pointers handed to callbacks stay put as clients come and go
+        std::unordered_map<ClientID, ClientInfo> clients;
+        uint32_t nextSlot = 0;
+
+        std::vector<ReceivedMessage> batch;
+        const size_t batchSize = static_cast<size_t>(server.GetReceiveBatchSize());
+        batch.reserve(batchSize);
+
+        // Handles only take over messages when no batch callback wants them, as in a live poll
+        const bool useHandles = !server.m_DataBatchReceivedCallback && server.m_MessageReceivedCallback;
+
+        auto timeCallback = [&stats](auto&& callback)
+            {
+                const auto callbackStart = std::chrono::steady_clock::now();
+                callback();
+                stats.CallbackTime += std::chrono::steady_clock::now() - callbackStart;
+            };
+
+        auto flushBatch = [&]()
+            {
+                if (batch.empty())
+                    return;
+
+                timeCallback([&]()
+                    {
+                        if (server.m_DataBatchReceivedCallback)
+                        {
+                            server.m_DataBatchReceivedCallback(std::span<const ReceivedMessage>(batch));
+                        }
+                        else if (server.m_DataReceivedCallback)
+                        {
+                            for (const ReceivedMessage& message : batch)
+                                server.m_DataReceivedCallback(*message.Client, message.Payload);
+                        }
+                    });
+                batch.clear();
+            };
+
+        auto connect = [&](ClientID clientID, Buffer description) -> ClientInfo&
+            {
+                ClientInfo& client = clients[clientID];
+                client.ID = clientID;
+                client.Slot = nextSlot++;
+
+                const size_t length = std::min<size_t>(description.Size, sizeof(client.ConnectionDesc) - 1);
+                if (length > 0)
+                    std::memcpy(client.ConnectionDesc, description.Data, length);
+                client.ConnectionDesc[length] = '\0';
+
+                stats.Connects++;
+                if (server.m_ClientConnectedCallback)
+                    timeCallback([&]() { server.m_ClientConnectedCallback(client); });
+                return client;
+            };
+
+        auto disconnect = [&](const ClientInfo& client)
+            {
+                stats.Disconnects++;
+                if (server.m_ClientDisconnectedCallback)
+                    timeCallback([&]() { server.m_ClientDisconnectedCallback(client); });
+            };
+
+        const auto start = std::chrono::steady_clock::now();
+
+        CaptureRecord record;
+        while (!m_Stopping.load(std::memory_order_relaxed) && m_Reader.Next(record))
+        {
+            if (config.Speed > 0.0)
+            {
+                const auto due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double, std::micro>(static_cast<double>(record.Time.count()) / config.Speed)
+                );
+                if (due > std::chrono::steady_clock::now())
+                {
+                    // Whatever arrived before the gap is delivered before waiting it out
+                    flushBatch();
+                    std::this_thread::sleep_until(due);
+                }
+            }
+
+            auto it = clients.find(record.Client);
+            switch (record.Type)
+            {
+            case CaptureRecordType::Connect:
+            {
+                // Clients already connected when the capture began may be announced twice
+                if (it == clients.end())
+                {
+                    flushBatch();
+                    connect(record.Client, record.Payload);
+                }
+                break;
+            }
+            case CaptureRecordType::Disconnect:
+            {
+                if (it != clients.end())
+                {
+                    flushBatch();
+                    disconnect(it->second);
+                    clients.erase(it);
+                }
+                break;
+            }
+            case CaptureRecordType::Data:
+            {
+                // Data can beat the connect record of a client that predates the capture
+                ClientInfo* client = it != clients.end() ? &it->second : nullptr;
+                if (!client)
+                {
+                    flushBatch();
+                    client = &connect(record.Client, Buffer());
+                }
+
+                stats.Messages++;
+                stats.Bytes += record.Payload.Size;
+
+                if (useHandles)
+                {
+                    SteamNetworkingMessage_t* message = MessagePool::Get().AllocateMessage(static_cast<uint32_t>(record.Payload.Size));
+                    if (!message)
+                        break;
+
+                    if (record.Payload.Size > 0)
+                        std::memcpy(message->m_pData, record.Payload.Data, record.Payload.Size);
+                    message->m_conn = record.Client;
+                    // Matches the user data of a client on worker 0
+                    message->m_nConnUserData = client->Slot;
+                    message->m_idxLane = record.Lane;
+
+                    timeCallback([&]() { server.m_MessageReceivedCallback(*client, MessageHandle(message)); });
+                }
+                else
+                {
+                    batch.push_back({ client, record.Payload });
+                    if (batch.size() >= batchSize)
+                        flushBatch();
+                }
+                break;
+            }
+            }
+        }
+
+        flushBatch();
+
+        if (config.DisconnectRemaining)
+        {
+            for (const auto& [clientID, client] : clients)
+                disconnect(client);
+        }
+
+        stats.Elapsed = std::chrono::steady_clock::now() - start;
+        stats.Truncated = m_Reader.IsTruncated();
+        if (stats.Truncated)
+            UT_WARN_TAG("SERVER", "Traffic capture ends in a truncated record; replayed what came before it");
+
+        server.m_Replaying.store(false);
+        return stats;
+    }
+
+} // namespace Utopia
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "TrafficCapture.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Utopia {
+
+    class Server;
+
+    struct TrafficReplayConfig
+    {
+        // 1 replays in real time and 2 twice as fast; zero or less replays as fast as the callbacks allow
+        double Speed = 1.0;
+        // Disconnects every client still connected when the capture ends, as stopping the server would
+        bool DisconnectRemaining = true;
+    };
+
+    struct TrafficReplayStats
+    {
+        uint64_t Connects = 0;
+        uint64_t Disconnects = 0;
+        uint64_t Messages = 0;
+        uint64_t Bytes = 0;
+
+        // Wall time of the whole replay, and the part of it spent inside the server's callbacks
+        std::chrono::nanoseconds Elapsed{ 0 };
+        std::chrono::nanoseconds CallbackTime{ 0 };
+
+        // The capture ended in a record cut short, e.g. by a crash while capturing
+        bool Truncated = false;
+        // Set when the replay could not start
+        std::string Error;
+    };
+
+    // Feeds a capture recorded with Server::SetTrafficCapture into a server's callbacks on the calling
+    // thread, without sockets. Callbacks take the same precedence as live traffic: data arrives batched
+    // through the DataBatchReceivedCallback if set, then as MessageHandles, then per buffer. Replayed
+    // clients keep their captured IDs; anything the callbacks send to them is dropped.
+    class TrafficReplay
+    {
+    public:
+        bool Open(const std::string& path, std::string& outError);
+
+        // Blocks until the capture ends or Stop() is called. The server must not be running, so live
+        // callbacks cannot interleave with replayed ones. Can be run again from the start.
+        TrafficReplayStats Run(Server& server, const TrafficReplayConfig& config = {});
+
+        // Safe from any thread
+        void Stop() { m_Stopping.store(true); }
+
+    private:
+        TrafficCaptureReader m_Reader;
+        std::atomic_bool m_Stopping{ false };
+    };
+
+} // namespace Utopia